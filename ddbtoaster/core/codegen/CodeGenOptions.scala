@@ -11,5 +11,10 @@ class CodeGenOptions(
   val timeoutMilli: Long, 
   val isReleaseMode: Boolean,
   val printTiminingInfo: Boolean, 
-  val printProgress: Long = 0L
+  val printProgress: Long = 0L,
+  val swissIndexMaps: Set[String] = Set(),
+  val tinyMaps: Set[String] = Set(),
+  val flatMaps: Set[String] = Set(),
+  val denseIndexMaps: Set[String] = Set(),
+  val batchPrefetch: Boolean = false
 )
\ No newline at end of file
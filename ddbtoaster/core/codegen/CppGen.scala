@@ -39,6 +39,50 @@ trait ICppGen extends CodeGen {
   private var isExpressiveTLQSEnabled = false
 
   private var isBatchModeActive = false
+
+  /**
+   * Maps that can store their entries inline in a FlatHashMap, if they end up without 
+   * secondary indices: maps with at most FLAT_ENTRY_MAX_FIELDS fixed-size fields 
+   * that are not query results (these are snapshotted and serialized as MultiHashMaps)
+   * and that no statement both reads and updates (entries move on insertion).
+   */
+  private var flatMapCandidates = Set[String]()
+
+  // Maps that some statement both reads and updates
+  private var selfUpdatedMaps = Set[String]()
+
+  /**
+   * With --batch-prefetch, lookups in the body of a foreach over a delta map of
+   * a batch trigger are prefetched BATCH_PREFETCH_DISTANCE entries ahead, if their
+   * keys are known before the body runs: fields of the delta entry (read through
+   * the lookahead entry) or variables bound outside the loop. 'known' maps these variables to
+   * the expressions available to the prefetch; scopes nest like the loops.
+   */
+  private case class BatchPrefetchScope(known: Map[String, String], prefetches: ArrayBuffer[String] = ArrayBuffer())
+
+  private var batchPrefetchScopes = List[BatchPrefetchScope]()
+
+  private def registerBatchPrefetch(mapName: String, keys: List[String], prefetch: String => String) = 
+    batchPrefetchScopes.headOption.foreach { scope =>
+      if (!deltaRelationNames.contains(mapName) && keys.forall(scope.known.contains)) {
+        scope.prefetches += prefetch(keys.map(scope.known).mkString(", "))
+      }
+    }
+
+  private val FLAT_ENTRY_MAX_FIELDS = 8
+
+  // Maps selected with --flat-map, among the candidates
+  private def isFlatMap(m: String): Boolean = 
+    (cgOpts.flatMaps.contains(m) || cgOpts.flatMaps.contains("*")) &&
+    flatMapCandidates.contains(m) && secondaryIndices(m).isEmpty
+
+  // Maps selected with --tiny-map keep up to TINY_MAP_CAPACITY entries inline 
+  // (TinyMap) and move to their usual map type once they outgrow them. There
+  // are no cardinality estimates to choose these maps by. Maps updated while 
+  // being read are excluded, as entries move when the map grows.
+  private def isTinyMap(m: String): Boolean = 
+    EXPERIMENTAL_HASHMAP && (cgOpts.tinyMaps.contains(m) || cgOpts.tinyMaps.contains("*")) &&
+    secondaryIndices(m).isEmpty && !selfUpdatedMaps.contains(m)
   
   private def getIndexId(m: String, is: List[Int]): String = 
     (if (is.isEmpty) (0 until mapDefs(m).keys.size).toList else is).mkString //slice(m,is)
@@ -74,6 +118,29 @@ trait ICppGen extends CodeGen {
     }
   }
   
+  private def isSwissIndexed(mapName: String): Boolean = 
+    cgOpts.swissIndexMaps.contains(mapName) || cgOpts.swissIndexMaps.contains("*")
+
+  // Maps selected with --dense-index and keyed by a single integer get a 
+  // direct-addressed primary index. No statistics on the key domain reach the 
+  // code generator, so the user tells which keys are dense; the index itself 
+  // moves to hashing if they turn out to be sparse.
+  private def isDenseIndexed(m: MapDef): Boolean = 
+    EXPERIMENTAL_HASHMAP && (cgOpts.denseIndexMaps.contains(m.name) || cgOpts.denseIndexMaps.contains("*")) &&
+    !isFlatMap(m.name) && !isSwissIndexed(m.name) && 
+    m.keys.size == 1 && m.keys.head._2 == TypeLong
+
+  // Primary index of a map: open-addressing (SwissPrimaryHashIndex) for the maps 
+  // selected with --swiss-index, direct-addressed (DenseArrayIndex) for 'dense' 
+  // maps (see isDenseIndexed), chained (PrimaryHashIndex) otherwise
+  private def primaryIndexType(mapName: String, entryType: String, idxFn: String, dense: Boolean = false): String = {
+    val tp = 
+      if (isSwissIndexed(mapName)) "SwissPrimaryHashIndex<" 
+      else if (dense) "DenseArrayIndex<"
+      else "PrimaryHashIndex<"
+    tp + entryType + ", " + idxFn + ">"
+  }
+
   // ---------- Methods manipulating with temporary maps
 
   // tmp mapName => (List of key types and value type)
@@ -93,7 +160,7 @@ trait ICppGen extends CodeGen {
     val s = tempMapDefinitions.map { case (n, (ksTp, vTp)) =>
       if (EXPERIMENTAL_HASHMAP)
           "MultiHashMap<" + tempEntryTypeName(ksTp, vTp) + ", " + typeToString(vTp) + 
-            ", PrimaryHashIndex<" + tempEntryTypeName(ksTp, vTp) + "> > " + n + ";"
+            ", " + primaryIndexType(n, tempEntryTypeName(ksTp, vTp), tempEntryTypeName(ksTp, vTp)) + " > " + n + ";"
       else 
           "MultiHashMap<" + tempEntryTypeName(ksTp, vTp) + ", " + typeToString(vTp) + 
             ", HashIndex<" + tempEntryTypeName(ksTp, vTp) + ", " + typeToString(vTp) + "> > " + n + ";"
@@ -116,9 +183,13 @@ trait ICppGen extends CodeGen {
       val sHashFnBody = ksTpIdx.take(EXPERIMENTAL_MAX_INDEX_VARS)
                                .map { case (_, i) => "hash_combine(h, e._" + (i + 1) + ");" }.mkString("\n")
 
+      // only the old runtime links entries through nxt/prv
+      val sLinks = stringIf(!EXPERIMENTAL_HASHMAP, s" ${name}* nxt; ${name}* prv;")
+      val sInitializers = stringIf(!EXPERIMENTAL_HASHMAP, " : nxt(nullptr), prv(nullptr)")
+
       s"""|struct ${name} {
-          |  ${sKeyDefs} ${sValueDef}; ${name}* nxt; ${name}* prv;
-          |  explicit ${name}() : nxt(nullptr), prv(nullptr) { }
+          |  ${sKeyDefs} ${sValueDef};${sLinks}
+          |  explicit ${name}()${sInitializers} { }
           |  FORCE_INLINE ${name}& modify(${sModFnParams}) { ${sModFnBody} return *this; }
           |  static bool equals(const ${name} &x, const ${name} &y) {
           |    return (${sEqualFnBody});
@@ -389,19 +460,21 @@ trait ICppGen extends CodeGen {
              |""".stripMargin
       }
       else {
-        val castArgs = fields.zipWithIndex.map { case ((_, tp), i) => 
-            "*(reinterpret_cast<" + typeToString(tp) + "*>((*ea)[" + i + "].get()))"
-          }.mkString(", ")
+        val (readColumns, columnArgs) = emitReadBatchColumns("rb", fields, "    ")
 
         emitUnwrapFunction(EventInsert(s.schema), sources) +
         // 
         stringIf(isBatchModeActive, 
           s"""|void unwrap_batch_update_${name}(const event_args_t& eaList) {
-              |  size_t sz = eaList.size();
-              |  for (size_t i = 0; i < sz; i++) {
-              |    event_args_t* ea = reinterpret_cast<event_args_t*>(eaList[i].get());
-              |    ${name}_entry e(${castArgs}, 1L);
-              |    ${emitInsertToMapFunc(name, "e")}
+              |  const event_batch_t& batch = *reinterpret_cast<const event_batch_t*>(eaList);
+              |  relation_id_t id = program_base->get_relation_id("${name}");
+              |  for (size_t r = 0; r < batch.size(); r++) {
+              |    const column_batch_t& rb = batch[r];
+              |    if (rb.id != id) continue;
+              |${readColumns}    for (size_t i = 0; i < rb.size; i++) {
+              |      ${name}_entry e(${columnArgs}, 1L);
+              |      ${emitInsertToMapFunc(name, "e")}
+              |    }
               |  }
               |}
               |""".stripMargin)
@@ -424,6 +497,27 @@ trait ICppGen extends CodeGen {
         |""".stripMargin
   }
 
+  // Reads the fields of a flat event tuple (see tuple.hpp) into local
+  // variables, in schema order. Returns the declarations and the variables.
+  protected def emitReadTupleFields(tuple: String, fields: List[(String, Type)], indent: String) = {
+    val names = fields.indices.map("ea_" + _)
+    val decls = indent + "tuple_reader reader(" + tuple + ");\n" +
+      fields.zip(names).map { case ((_, t), n) =>
+        indent + "const " + typeToString(t) + "& " + n + " = reader.get<" + typeToString(t) + ">();\n"
+      }.mkString
+    (decls, names.mkString(", "))
+  }
+
+  // Reads the columns of a column_batch_t (see tuple.hpp) into local arrays,
+  // in schema order. Returns the declarations and the fields of tuple 'i'.
+  protected def emitReadBatchColumns(batch: String, fields: List[(String, Type)], indent: String) = {
+    val names = fields.indices.map("col_" + _)
+    val decls = fields.zip(names).zipWithIndex.map { case (((_, t), n), i) =>
+        indent + "const " + typeToString(t) + "* " + n + " = " + batch + ".column<" + typeToString(t) + ">(" + i + ");\n"
+      }.mkString
+    (decls, names.map(_ + "[i]").mkString(", "))
+  }
+
   protected def emitUnwrapFunction(evt: EventTrigger, sources: List[Source]) = stringIf(!CppGen.EXPERIMENTAL_RUNTIME_LIBRARY, {
     val (op, name, fields) = evt match {
       case EventBatchUpdate(Schema(n, cs)) => ("batch_update", n, cs)
@@ -431,30 +525,27 @@ trait ICppGen extends CodeGen {
       case EventDelete(Schema(n, cs)) => ("delete", n, cs)
       case _ => sys.error("Unsupported trigger event " + evt)
     }
-    val constructorArgs = fields.zipWithIndex.map { case ((_, t), i) => 
-      "*(reinterpret_cast<" + typeToString(t) + "*>(ea[" + i + "].get()))"
-    }.mkString(", ")
+    val (readFields, fieldArgs) = emitReadTupleFields("ea", fields, "  ")
 
     evt match {
       case EventBatchUpdate(_) =>
         var code =    "void unwrap_" + op + "_" + name + "(const event_args_t& eaList) {\n"
-        code = code + "  size_t sz = eaList.size();\n"
+        code = code + "  const event_batch_t& batch = *reinterpret_cast<const event_batch_t*>(eaList);\n"
         for (s <- sources.filter(_.isStream)) {
           code = code + "  " + delta(s.schema.name) + ".clear();\n"
         }       
-        code = code +   "  for (size_t i = 0; i < sz; i++) {\n"
-        code = code +   "    event_args_t* ea = reinterpret_cast<event_args_t*>(eaList[i].get());\n"
-        code = code +   "    relation_id_t relation = *(reinterpret_cast<relation_id_t*>((*ea).back().get()));\n"
+        code = code +   "  for (size_t r = 0; r < batch.size(); r++) {\n"
+        code = code +   "    const column_batch_t& rb = batch[r];\n"
+        code = code +   "    const long* mult = rb.multiplicities();\n"
         
         for (s <- sources.filter(_.isStream)) {
-          val schema = s.schema
-          val constructorArgs = s.schema.fields.zipWithIndex.map { case ((_, t), i) =>
-              "*(reinterpret_cast<" + typeToString(t) + "*>((*ea)[" + i + "].get()))"
-            }.mkString(", ")
-          code = code + "    if (relation == program_base->get_relation_id(\"" + s.schema.name + "\"" + ")) { \n"
-          code = code + "      event_args_t* ea = reinterpret_cast<event_args_t*>(eaList[i].get());\n"
-          code = code + "      " + delta(s.schema.name) + "_entry e(" + constructorArgs + ", *(reinterpret_cast<" + typeToString(TypeLong) + "*>((*ea)[" + s.schema.fields.size + "].get())));\n"
-          code = code + "      " + delta(s.schema.name) + ".addOrDelOnZero(e, *(reinterpret_cast<" + typeToString(TypeLong) + "*>((*ea)[" + s.schema.fields.size + "].get())));\n"
+          val (readStreamColumns, streamColumnArgs) = emitReadBatchColumns("rb", s.schema.fields, "      ")
+          code = code + "    if (rb.id == program_base->get_relation_id(\"" + s.schema.name + "\"" + ")) { \n"
+          code = code + readStreamColumns
+          code = code + "      for (size_t i = 0; i < rb.size; i++) {\n"
+          code = code + "        " + delta(s.schema.name) + "_entry e(" + streamColumnArgs + ", mult[i]);\n"
+          code = code + "        " + delta(s.schema.name) + ".addOrDelOnZero(e, mult[i]);\n"
+          code = code + "      }\n"
           code = code + "    }\n"
         }
         code = code +   "  }\n"
@@ -467,22 +558,22 @@ trait ICppGen extends CodeGen {
         val insertOp = stringIf(CppGen.EXPERIMENTAL_HASHMAP, "insert", "insert_nocheck")
         code +
         s"""|void unwrap_insert_${name}(const event_args_t& ea) {
-            |  ${deltaRel}.clear(); 
-            |  ${deltaRel}_entry e(${constructorArgs}, 1L);
+            |${readFields}  ${deltaRel}.clear(); 
+            |  ${deltaRel}_entry e(${fieldArgs}, 1L);
             |  ${deltaRel}.${insertOp}(e);
             |  on_batch_update_${name}(${deltaRel});
             |}
             |
             |void unwrap_delete_${name}(const event_args_t& ea) {
-            |  ${deltaRel}.clear(); 
-            |  ${deltaRel}_entry e(${constructorArgs}, -1L);
+            |${readFields}  ${deltaRel}.clear(); 
+            |  ${deltaRel}_entry e(${fieldArgs}, -1L);
             |  ${deltaRel}.${insertOp}(e);
             |  on_batch_update_${name}(${deltaRel});
             |}
             |""".stripMargin
       case _ =>
         s"""|void unwrap_${op}_${name}(const event_args_t& ea) {
-            |  on_${op}_${name}(${constructorArgs});
+            |${readFields}  on_${op}_${name}(${fieldArgs});
             |}
             |""".stripMargin
     }
@@ -531,7 +622,7 @@ trait ICppGen extends CodeGen {
         stringIf(s.nonEmpty, "\n" + s + "\n")
       }
 
-      emitEntryType(mapEntryType, m.keys, (VALUE_NAME, m.tp))(sModifyFn)
+      emitEntryType(mapEntryType, m.keys, (VALUE_NAME, m.tp), !EXPERIMENTAL_HASHMAP && !isFlatMap(mapName))(sModifyFn)
     }
 
     val sIndexOpsType = indices.map { case (is, unique) =>
@@ -546,6 +637,13 @@ trait ICppGen extends CodeGen {
         cmpFunc(tp, OpEq, "x." + n, "y." + n, false)
       }.mkString(" && ")
 
+      val sKeyFn = stringIf(unique && isDenseIndexed(m), 
+        s"""|
+            |  
+            |  FORCE_INLINE static long key(const ${mapEntryType}& e) {
+            |    return e.${fields(is.head)._1};
+            |  }""".stripMargin)
+
       s"""|struct ${name} {
           |  FORCE_INLINE static size_t hash(const ${mapEntryType}& e) {
           |    size_t h = 0;
@@ -555,22 +653,31 @@ trait ICppGen extends CodeGen {
           |  
           |  FORCE_INLINE static bool equals(const ${mapEntryType}& x, const ${mapEntryType}& y) {
           |    return ${sCmpExpr};
-          |  }
+          |  }${sKeyFn}
           |};
           |""".stripMargin
     }.mkString("\n")
 
+    // a TinyMap moves its entries into a map of the usual type, named <map>_map_large
+    val sPrimaryIdxFn = mapType + "key" + getIndexId(mapName, indices.head._1) + "_idxfn"
+    val sTinyTypedef = stringIf(isTinyMap(mapName), 
+      s"typedef TinyMap<${mapEntryType}, ${mapValueType}, ${sPrimaryIdxFn}, ${mapType}_large> ${mapType};\n")
+    val sMapTypeName = if (isTinyMap(mapName)) mapType + "_large" else mapType
+
     val sMapTypedefs = {
-      if (EXPERIMENTAL_HASHMAP) {
+      if (isFlatMap(mapName)) {
+        s"typedef FlatHashMap<${mapEntryType}, ${mapValueType}, ${sPrimaryIdxFn}> ${sMapTypeName};\n" + sTinyTypedef
+      }
+      else if (EXPERIMENTAL_HASHMAP) {
         val sIndices = indices.map { case (is, unique) =>
-            if (unique) "PrimaryHashIndex<" + mapEntryType + ", " + mapType + "key" + getIndexId(mapName, is) + "_idxfn>"
+            if (unique) primaryIndexType(mapName, mapEntryType, mapType + "key" + getIndexId(mapName, is) + "_idxfn", isDenseIndexed(m))
             else "SecondaryHashIndex<" + mapEntryType + ", " + mapType + "key" + getIndexId(mapName, is) + "_idxfn>"
           }.mkString(",\n")
         
         s"""|typedef MultiHashMap<${mapEntryType}, ${mapValueType}, 
             |${ind(sIndices)}
-            |> ${mapType};
-            |""".stripMargin
+            |> ${sMapTypeName};
+            |${sTinyTypedef}""".stripMargin
       }
       else {
         val sIndices = indices.map { case (is, unique) => 
@@ -594,12 +701,15 @@ trait ICppGen extends CodeGen {
         |""".stripMargin
   }
 
-  private def emitEntryType(name: String, keys: List[(String, Type)], value: (String, Type)): (String => String) = {
+  // Only the maps of the old runtime link their entries (linked = true). Entries 
+  // of a MultiHashMap sit in a slot array and those of a FlatHashMap in its 
+  // table; they have no nxt/prv pointers and use the implicit copy constructor.
+  private def emitEntryType(name: String, keys: List[(String, Type)], value: (String, Type), linked: Boolean = true): (String => String) = {
     val fields = keys ++ List(value)
 
     val sFieldDefinitions = fields.map { case (n, t) => 
         typeToString(t) + " " + n + "; " 
-      }.mkString + name + "* nxt; " + name + "* prv;"
+      }.mkString + stringIf(linked, name + "* nxt; " + name + "* prv;")
           
     val sConstructorParams = fields.zipWithIndex.map { case ((_, tp), i) => 
         "const " + refTypeToString(tp) + " c" + i 
@@ -613,6 +723,10 @@ trait ICppGen extends CodeGen {
         n + "(other." + n + "), "
       }.mkString + "nxt(nullptr), prv(nullptr)"
 
+    val sDefaultInitializers = stringIf(linked, " : nxt(nullptr), prv(nullptr)")
+
+    val sCopyConstructor = stringIf(linked, name + "(const " + name + "& other) : " + sInitializers + " { }")
+
     val sStringInit = 
       keys.zipWithIndex.map { case ((n, tp), i) => tp match {
           case TypeLong | TypeDate => n + " = std::stol(f[" + i + "]);"
@@ -620,7 +734,7 @@ trait ICppGen extends CodeGen {
           case TypeString => n + " = f[" + i + "];"
           case _ => sys.error("Unsupported type in fromString")
         }
-      }.mkString(" ") + s" ${VALUE_NAME} = v; nxt = nullptr; prv = nullptr;" 
+      }.mkString(" ") + s" ${VALUE_NAME} = v;" + stringIf(linked, " nxt = nullptr; prv = nullptr;")
 
     val sSerialization = fields.map { case (n, _) =>
         s"""|ar << ELEM_SEPARATOR;
@@ -632,9 +746,9 @@ trait ICppGen extends CodeGen {
       s"""|struct ${name} {
           |  ${sFieldDefinitions}
           |
-          |  explicit ${name}() : nxt(nullptr), prv(nullptr) { }
+          |  explicit ${name}()${sDefaultInitializers} { }
           |  explicit ${name}(${sConstructorParams}) { ${sConstructorBody} }
-          |  ${name}(const ${name}& other) : ${sInitializers} { }
+          |  ${sCopyConstructor}
           |  // TODO: enable constructor
           |  //${name}(const std::vector<std::string>& f, const ${refTypeToString(value._2)} v) {
           |  //    /* if (f.size() < ${keys.size}) return; */
@@ -699,6 +813,28 @@ trait ICppGen extends CodeGen {
       stringIf(s.nonEmpty, "/* Functions returning / computing the results of top level queries */\n" + s)
     }
 
+    val sChangesFn = stringIf(!isExpressiveTLQSEnabled, {
+      val (mapQueries, scalarQueries) = s0.queries.partition(_.expr.ovars.size > 0)
+      val sLog = mapQueries.map { q => s"${q.name}.log_changes(epoch);\n" }.mkString
+      val sTracked = (mapQueries.map { q => s"${q.name}.has_changes_since(since)" } match {
+          case Nil => List("true")
+          case l => l
+        }).mkString(" && ")
+      val sCollect = mapQueries.map { q => s"${q.name}.get_changes_since(tracked ? since : 0, d.${q.name});\n" }.mkString
+      val sCopy = scalarQueries.map { q => s"d.${q.name} = ${q.name};\n" }.mkString
+
+      s"""|/* Copies into 'd' the entries of the top-level views that changed after
+          |   epoch 'since' and closes epoch 'epoch'. Returns false if these changes
+          |   are not tracked, in which case 'd' receives all entries. */
+          |bool changes_since(tlq_t& d, unsigned long since, unsigned long epoch) {
+          |${ind(sLog)}
+          |  bool tracked = ${sTracked};
+          |${ind(sCollect + sCopy)}
+          |  return tracked;
+          |}
+          |""".stripMargin
+    })
+
     val sTLQDefinitions = emitTLQDefinitions(s0.queries) 
 
     val sDataDefinitions = 
@@ -717,6 +853,8 @@ trait ICppGen extends CodeGen {
         |
         |${ind(sTLQGetters)}
         |
+        |${ind(sChangesFn)}
+        |
         |protected:
         |${ind(sTLQDefinitions)}
         |${ind(sDataDefinitions)}
@@ -768,13 +906,13 @@ trait ICppGen extends CodeGen {
       val sRegisterStreamTriggers = {
         val s = s0.triggers.filter(_.event != EventReady).map { _.event match {
           case EventBatchUpdate(Schema(n, _)) =>
-            s"""|pb.add_trigger("${n}", batch_update, std::bind(&data_t::unwrap_batch_update_${n}, this, std::placeholders::_1));
-                |pb.add_trigger("${n}", insert_tuple, std::bind(&data_t::unwrap_insert_${n}, this, std::placeholders::_1));
-                |pb.add_trigger("${n}", delete_tuple, std::bind(&data_t::unwrap_delete_${n}, this, std::placeholders::_1));""".stripMargin
+            s"""|pb.add_trigger("${n}", batch_update, &ProgramBase::call_member<data_t, &data_t::unwrap_batch_update_${n}>, this);
+                |pb.add_trigger("${n}", insert_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_insert_${n}>, this);
+                |pb.add_trigger("${n}", delete_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_delete_${n}>, this);""".stripMargin
           case EventInsert(Schema(n, _)) => 
-            s"""pb.add_trigger("${n}", insert_tuple, std::bind(&data_t::unwrap_insert_${n}, this, std::placeholders::_1));"""
+            s"""pb.add_trigger("${n}", insert_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_insert_${n}>, this);"""
           case EventDelete(Schema(n, _)) => 
-            s"""pb.add_trigger("${n}", delete_tuple, std::bind(&data_t::unwrap_delete_${n}, this, std::placeholders::_1));"""
+            s"""pb.add_trigger("${n}", delete_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_delete_${n}>, this);"""
           case _ => ""
         }}.mkString("\n")
 
@@ -784,9 +922,9 @@ trait ICppGen extends CodeGen {
       val sRegisterTableTriggers = {          
         val s = s0.sources.filter(!_.isStream).map { s => 
             stringIf(isBatchModeActive,
-              s"""pb.add_trigger("${s.schema.name}", batch_update, std::bind(&data_t::unwrap_batch_update_${s.schema.name}, this, std::placeholders::_1));\n"""
+              s"""pb.add_trigger("${s.schema.name}", batch_update, &ProgramBase::call_member<data_t, &data_t::unwrap_batch_update_${s.schema.name}>, this);\n"""
             ) + 
-            s"""pb.add_trigger("${s.schema.name}", insert_tuple, std::bind(&data_t::unwrap_insert_${s.schema.name}, this, std::placeholders::_1));"""
+            s"""pb.add_trigger("${s.schema.name}", insert_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_insert_${s.schema.name}>, this);"""
           }.mkString("\n")
 
         stringIf(s.nonEmpty, "// Register table triggers\n" + s) 
@@ -841,6 +979,16 @@ trait ICppGen extends CodeGen {
     })
 
   private def emitMainClass(s0: System) = stringIf(!EXPERIMENTAL_RUNTIME_LIBRARY, {
+    val sTakeChanges = stringIf(!isExpressiveTLQSEnabled, 
+      """|
+         |/* Collects the entries of the top-level views that changed after epoch 'since'. */
+         |snapshot_t take_changes(unsigned long since, unsigned long epoch, bool& full) {
+         |    tlq_t* d = new tlq_t();
+         |    full = !data.changes_since(*d, since, epoch);
+         |    return snapshot_t( d );
+         |}
+         |""".stripMargin)
+
     s"""|/* Type definition providing a way to execute the sql program */
         |class Program : public ProgramBase {
         |  public:
@@ -875,7 +1023,7 @@ trait ICppGen extends CodeGen {
         |${ind(emitTakeSnapshotBody, 4)}
         |        return snapshot_t( d );
         |    }
-        |
+        |${ind(sTakeChanges, 2)}
         |  protected:
         |    data_t data;
         |};
@@ -1114,14 +1262,28 @@ trait ICppGen extends CodeGen {
         val localEntry = fresh("se")
         localEntries += ((localEntry, mapEntryType))
         val argList = (ks map (x => rn(x._1))).mkString(", ")
+        if (!isTemp) {
+          registerBatchPrefetch(mapName, ks.map(x => rn(x._1)), args => s"${mapName}.prefetch(${localEntry}.modify(${args}));")
+        }
         co(s"${mapName}.getValueOrDefault(${localEntry}.modify(${argList}))") // all keys are bound
       } 
       else {
         val (v0, e0) = (fresh("v"), fresh("e"))
+        val outerVars = ctx.save.values.map(x => (x._2, x._2)).toMap
 
         ctx.add(ks.filter(x => !ctx.contains(x._1)).map(x => (x._1, (x._2, x._1))).toMap)
 
         if (!isTemp) { // slice or foreach
+          val ahead = e0 + "_ahead"
+          val batchScope = 
+            if (cgOpts.batchPrefetch && EXPERIMENTAL_HASHMAP && !EXPERIMENTAL_RUNTIME_LIBRARY && 
+                ko.size == 0 && deltaRelationNames.contains(mapName)) {
+              val entryVars = ki.map { case ((k, _), i) => (rn(k), ahead + "->" + mapDefs(mapName).keys(i)._1) }
+              Some(BatchPrefetchScope(outerVars ++ entryVars))
+            }
+            else None
+          batchScope.foreach { sc => batchPrefetchScopes = sc :: batchPrefetchScopes }
+
           val body = 
             ki.map { case ((k, ktp), i) => 
               typeToString(ktp) + " " + rn(k) + " = " + e0 + "->" + mapDefs(mapName).keys(i)._1 + ";\n"
@@ -1129,6 +1291,8 @@ trait ICppGen extends CodeGen {
             typeToString(tp) + " " + v0 + " = " + e0 + "->" + VALUE_NAME + ";\n" +
             co(v0)
 
+          batchScope.foreach { _ => batchPrefetchScopes = batchPrefetchScopes.tail }
+
           if (ko.size > 0) { //slice
             if (EXPERIMENTAL_RUNTIME_LIBRARY && deltaRelationNames.contains(mapName)) {
               sys.error("Delta relation requires secondary indices. Turn off experimental runtime library.")
@@ -1142,6 +1306,8 @@ trait ICppGen extends CodeGen {
             val n0 = fresh("n")
 
             if (EXPERIMENTAL_HASHMAP) {
+              registerBatchPrefetch(mapName, ko.map(x => rn(x._1._1)), args => 
+                s"${mapName}.prefetchSlice(${localEntry}.modify${getIndexId(mapName,is)}(${args}), ${idxIndex - 1});")
               s"""|{ //slice
                   |  const SecondaryIdxNode<${mapEntryType}>* ${n0}_head = static_cast<const SecondaryIdxNode<${mapEntryType}>*>(${mapName}.slice(${localEntry}.modify${getIndexId(mapName,is)}(${sKeys}), ${idxIndex - 1}));
                   |  const SecondaryIdxNode<${mapEntryType}>* ${n0} = ${n0}_head;
@@ -1180,14 +1346,42 @@ trait ICppGen extends CodeGen {
                   |""".stripMargin                
             }
             else {
-              s"""|{ //foreach
-                  |  ${mapEntryType}* ${e0} = ${mapName}.head;
-                  |  while (${e0}) {
-                  |${ind(body, 2)}
-                  |    ${e0} = ${e0}->nxt;
-                  |  }
-                  |}
-                  |""".stripMargin
+              // first() also works on snapshots that keep their entries in a shared image;
+              // entries of the old runtime are linked through nxt
+              val (sFirst, sNext) = 
+                if (EXPERIMENTAL_HASHMAP) (mapName + ".first()", mapName + ".next(" + e0 + ")") 
+                else (mapName + ".head", e0 + "->nxt")
+              val prefetches = batchScope.map(_.prefetches.distinct.mkString("\n")).getOrElse("")
+              if (prefetches.nonEmpty) {
+                val i0 = fresh("i")
+                s"""|{ //foreach, prefetching the lookups of the entry BATCH_PREFETCH_DISTANCE ahead
+                    |  ${mapEntryType}* ${e0} = ${sFirst};
+                    |  ${mapEntryType}* ${ahead} = ${e0};
+                    |  for (size_t ${i0} = 0; ${ahead} && ${i0} < BATCH_PREFETCH_DISTANCE; ${i0}++) {
+                    |${ind(prefetches, 2)}
+                    |    ${ahead} = ${mapName}.next(${ahead});
+                    |  }
+                    |  while (${e0}) {
+                    |    if (${ahead}) {
+                    |${ind(prefetches, 3)}
+                    |      ${ahead} = ${mapName}.next(${ahead});
+                    |    }
+                    |${ind(body, 2)}
+                    |    ${e0} = ${sNext};
+                    |  }
+                    |}
+                    |""".stripMargin
+              }
+              else {
+                s"""|{ //foreach
+                    |  ${mapEntryType}* ${e0} = ${sFirst};
+                    |  while (${e0}) {
+                    |${ind(body, 2)}
+                    |    ${e0} = ${sNext};
+                    |  }
+                    |}
+                    |""".stripMargin
+              }
             }
           }
         } 
@@ -1197,15 +1391,19 @@ trait ICppGen extends CodeGen {
               s"${typeToString(tp)} ${rn(k)} = ${e0}->_${(i + 1)};"
             }.mkString("\n") 
 
+          val (sFirst, sNext) = 
+            if (EXPERIMENTAL_HASHMAP) (mapName + ".first()", mapName + ".next(" + e0 + ")") 
+            else (mapName + ".head", e0 + "->nxt")
+
           s"""|{ // temp foreach
-              |  ${tempEntryTypeName(ks.map(_._2), tp)}* ${e0} = ${mapName}.head;
+              |  ${tempEntryTypeName(ks.map(_._2), tp)}* ${e0} = ${sFirst};
               |  while(${e0}) {
               |${ind(localVars, 2)} 
               |    ${typeToString(tp)} ${v0} = ${e0}->${VALUE_NAME}; 
               |
               |${ind(co(v0), 2)}
               |
-              |    ${e0} = ${e0}->nxt;
+              |    ${e0} = ${sNext};
               |  }
               |}
               |""".stripMargin
@@ -1371,6 +1569,20 @@ trait ICppGen extends CodeGen {
       }
     }
 
+    selfUpdatedMaps = s0.triggers.flatMap(_.stmts).flatMap { s => 
+      (s.expr :: s.initExpr.toList).flatMap(_.collect { 
+        case MapRef(n, _, _, _) if n == s.target.name => List(n) 
+      })
+    }.toSet
+
+    flatMapCandidates = if (!EXPERIMENTAL_HASHMAP) Set() else {
+      s0.maps.filter { m => 
+        m.keys.nonEmpty && m.keys.size + 1 <= FLAT_ENTRY_MAX_FIELDS &&
+        (m.tp :: m.keys.map(_._2)).forall(_ != TypeString) &&
+        !s0.queries.exists(_.name == m.name) && !selfUpdatedMaps.contains(m.name)
+      }.map(_.name).toSet
+    }
+
     prepareCodegen(s0)
  
     val sIVMStructure = emitIVMStructure(s0)
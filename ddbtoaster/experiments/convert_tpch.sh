@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Converts the CSV files of a TPC-H dataset into the columnar files loaded
+# by queries compiled with -DCOLUMNAR_INPUT, e.g.:
+#   ./convert_tpch.sh standard
+#   g++ ... src/main.cpp ... -DCOLUMNAR_INPUT -include src/tpch/tpch_template.hpp
+
+dataset=${1:-standard}
+
+mkdir -p bin
+g++ -Wall -std=c++11 -pedantic -O3 -pthread src/tpch/tpch_convert.cpp -I src/lib -I src/tpch -o bin/tpch_convert || exit 1
+
+for table in lineitem orders customer partsupp part supplier nation region
+do
+    file=datasets/tpch/${dataset}/${table}
+    if [ -f ${file}.csv ]; then
+        bin/tpch_convert ${table} ${file}.csv ${file}.col || exit 1
+    fi
+done
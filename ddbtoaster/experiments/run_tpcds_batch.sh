@@ -8,7 +8,7 @@ do
         echo "#############################"
 
         echo "Compiling TPC-DS query${i}..."
-        g++ -Wall -Wno-unused-variable -std=c++11 -pedantic -O3  src/main.cpp -I src/lib -I src/tpcds -include src/tpcds/query${i}.hpp -o bin/tpcds_query${i} -DBATCH_MODE -DBATCH_SIZE=$bs -DNUMBER_OF_RUNS=3 -include src/tpch/tpch.hpp -include src/tpch/tpch_template.hpp
+        g++ -Wall -Wno-unused-variable -std=c++11 -pedantic -O3 -pthread  src/main.cpp -I src/lib -I src/tpcds -include src/tpcds/query${i}.hpp -o bin/tpcds_query${i} -DBATCH_MODE -DBATCH_SIZE=$bs -DNUMBER_OF_RUNS=3 -include src/tpch/tpch.hpp -include src/tpch/tpch_template.hpp
 
         echo "Running TPC-DS query${i} with batch size ${bs}..."
         bin/tpcds_query${i}
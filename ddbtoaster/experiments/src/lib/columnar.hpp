@@ -0,0 +1,365 @@
+#ifndef DBTOASTER_COLUMNAR_HPP
+#define DBTOASTER_COLUMNAR_HPP
+
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "types.hpp"
+
+// Columnar binary files hold one relation in the same structure-of-arrays
+// layout as the TPCH*Batch types:
+//
+//   ColumnarHeader                 magic, format version, column and row count
+//   ColumnarColumn[numColumns]     name, type, element width and data extent
+//   column data                    each column starts at a COLUMNAR_ALIGNMENT boundary
+//
+// Fixed-width columns are plain arrays of numRows values. A string column is
+// an array of numRows + 1 offsets into the NUL-terminated characters that
+// follow it. Values are stored in host byte order.
+//
+// A mapped file hands its fixed-width columns to a batch without copying them.
+// String columns only need an array of STRING_TYPE descriptors; for pooled
+// strings these point into the mapping as well.
+
+#define COLUMNAR_MAGIC "DBTCOL\0\0"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_ALIGNMENT 64
+#define COLUMNAR_NAME_SIZE 32
+
+namespace dbtoaster
+{
+    enum ColumnarType { COLUMN_LONG = 1, COLUMN_DOUBLE = 2, COLUMN_STRING = 3 };
+
+    struct ColumnarHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t numColumns;
+        uint64_t numRows;
+    };
+
+    struct ColumnarColumn
+    {
+        char name[COLUMNAR_NAME_SIZE];
+        uint32_t type;
+        uint32_t width;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    template <typename T> struct ColumnarTypeOf;
+    template <> struct ColumnarTypeOf<long> { static const uint32_t value = COLUMN_LONG; };
+    template <> struct ColumnarTypeOf<double> { static const uint32_t value = COLUMN_DOUBLE; };
+
+    inline uint64_t alignColumn(uint64_t offset)
+    {
+        return (offset + COLUMNAR_ALIGNMENT - 1) & ~(uint64_t)(COLUMNAR_ALIGNMENT - 1);
+    }
+
+    // Initializes the string descriptors of a mapped column. The generic
+    // version copies the characters; pooled strings borrow them from the
+    // mapping and hold one extra reference, so that copies made by the
+    // program never release the mapped characters.
+    template <typename S>
+    struct MappedString
+    {
+        static void init(S* s, const char* str, uint64_t length) { new (s) S(str, length); }
+        static void release(S* s) { s->~S(); }
+    };
+
+    template <>
+    struct MappedString<PooledRefCountedString>
+    {
+        static void init(PooledRefCountedString* s, const char* str, uint64_t length)
+        {
+            s->ptr_count_ = pool.add();
+            *s->ptr_count_ = 2;
+            s->size_ = length;
+            s->data_ = const_cast<char*>(str);
+        }
+
+        static void release(PooledRefCountedString* s)
+        {
+            // Strings still shared with the program keep their pinned count.
+            if (*s->ptr_count_ == 2) pool.del(s->ptr_count_);
+            else --(*s->ptr_count_);
+        }
+    };
+
+    class ColumnarFile
+    {
+        public:
+            ColumnarFile(const std::string& path) : base_(nullptr), length_(0), header_(nullptr), columns_(nullptr)
+            {
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) throw std::runtime_error("cannot open columnar file " + path);
+                struct stat st;
+                if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ColumnarHeader))
+                {
+                    close(fd);
+                    throw std::runtime_error("invalid columnar file " + path);
+                }
+                length_ = st.st_size;
+                // Private writable mapping: pages stay shared with the page
+                // cache unless a program writes into its input.
+                void* p = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                close(fd);
+                if (p == MAP_FAILED) throw std::runtime_error("cannot map columnar file " + path);
+                base_ = static_cast<char*>(p);
+                madvise(base_, length_, MADV_SEQUENTIAL);
+
+                header_ = reinterpret_cast<const ColumnarHeader*>(base_);
+                columns_ = reinterpret_cast<const ColumnarColumn*>(base_ + sizeof(ColumnarHeader));
+                if (memcmp(header_->magic, COLUMNAR_MAGIC, sizeof(header_->magic)) != 0)
+                    fail("not a columnar file " + path);
+                if (header_->version != COLUMNAR_VERSION)
+                    fail("unsupported columnar format version in " + path);
+                if (sizeof(ColumnarHeader) + header_->numColumns * sizeof(ColumnarColumn) > length_)
+                    fail("truncated columnar file " + path);
+                for (uint32_t i = 0; i < header_->numColumns; i++)
+                {
+                    if (columns_[i].offset > length_ || columns_[i].length > length_ - columns_[i].offset)
+                        fail("truncated columnar file " + path);
+                }
+            }
+
+            ~ColumnarFile()
+            {
+                for (size_t i = 0; i < strings_.size(); i++)
+                {
+                    for (size_t j = 0; j < header_->numRows; j++)
+                        MappedString<STRING_TYPE>::release(strings_[i] + j);
+                    operator delete(strings_[i]);
+                }
+                if (base_ != nullptr) munmap(base_, length_);
+            }
+
+            size_t numRows() const { return header_->numRows; }
+
+            // Points the columns of 'batch' into the mapping. The batch must
+            // declare its columns in the order they were written.
+            template <typename Batch>
+            void bind(Batch& batch)
+            {
+                Binder binder(*this);
+                batch.visitColumns(binder);
+                if (binder.index != header_->numColumns)
+                    throw std::runtime_error("columnar file has a different number of columns");
+                batch.size = header_->numRows;
+                batch.capacity = header_->numRows;
+            }
+
+        private:
+            char* base_;
+            size_t length_;
+            const ColumnarHeader* header_;
+            const ColumnarColumn* columns_;
+            std::vector<STRING_TYPE*> strings_;
+
+            void fail(const std::string& msg)
+            {
+                munmap(base_, length_);
+                base_ = nullptr;
+                throw std::runtime_error(msg);
+            }
+
+            const ColumnarColumn& column(uint32_t index, const char* name, uint32_t type, uint32_t width)
+            {
+                if (index >= header_->numColumns)
+                    throw std::runtime_error(std::string("columnar file has no column ") + name);
+                const ColumnarColumn& c = columns_[index];
+                if (strncmp(c.name, name, COLUMNAR_NAME_SIZE) != 0 || c.type != type || c.width != width)
+                    throw std::runtime_error(std::string("columnar file does not match column ") + name);
+                return c;
+            }
+
+            struct Binder
+            {
+                ColumnarFile& file;
+                uint32_t index;
+
+                Binder(ColumnarFile& f) : file(f), index(0) { }
+
+                template <typename T>
+                void operator()(const char* name, T*& values)
+                {
+                    const ColumnarColumn& c = file.column(index++, name, ColumnarTypeOf<T>::value, sizeof(T));
+                    if (c.length < file.header_->numRows * sizeof(T))
+                        throw std::runtime_error(std::string("truncated column ") + name);
+                    values = reinterpret_cast<T*>(file.base_ + c.offset);
+                }
+
+                void operator()(const char* name, STRING_TYPE*& values)
+                {
+                    const ColumnarColumn& c = file.column(index++, name, COLUMN_STRING, sizeof(uint64_t));
+                    uint64_t n = file.header_->numRows;
+                    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(file.base_ + c.offset);
+                    if (c.length < (n + 1) * sizeof(uint64_t) || offsets[n] > c.length)
+                        throw std::runtime_error(std::string("truncated column ") + name);
+                    const char* chars = file.base_ + c.offset;
+                    values = static_cast<STRING_TYPE*>(operator new(n * sizeof(STRING_TYPE)));
+                    for (uint64_t i = 0; i < n; i++)
+                        MappedString<STRING_TYPE>::init(values + i, chars + offsets[i], offsets[i + 1] - offsets[i] - 1);
+                    file.strings_.push_back(values);
+                }
+            };
+
+            ColumnarFile(const ColumnarFile&) = delete;
+            ColumnarFile& operator=(const ColumnarFile&) = delete;
+    };
+
+    // Base of the batch types. A batch either owns its columns or shares them
+    // with a mapped file or a larger batch it is a slice of.
+    struct ColumnarBatch
+    {
+        bool ownsColumns;
+        std::shared_ptr<ColumnarFile> file;
+
+        ColumnarBatch() : ownsColumns(true) { }
+
+        ColumnarBatch(const std::shared_ptr<ColumnarFile>& f) : ownsColumns(false), file(f) { }
+    };
+
+    struct ColumnCollector
+    {
+        std::vector<void*> columns;
+
+        template <typename T>
+        void operator()(const char*, T*& values) { columns.push_back(values); }
+    };
+
+    struct ColumnSlicer
+    {
+        const std::vector<void*>& columns;
+        size_t offset;
+        size_t index;
+
+        ColumnSlicer(const std::vector<void*>& c, size_t o) : columns(c), offset(o), index(0) { }
+
+        template <typename T>
+        void operator()(const char*, T*& values) { values = static_cast<T*>(columns[index++]) + offset; }
+    };
+
+    // Points the columns of 'view' to rows [offset, offset + length) of 'batch'.
+    template <typename Batch>
+    void sliceColumns(Batch& view, Batch& batch, size_t offset, size_t length)
+    {
+        ColumnCollector collector;
+        batch.visitColumns(collector);
+        ColumnSlicer slicer(collector.columns, offset);
+        view.visitColumns(slicer);
+        view.size = length;
+        view.capacity = length;
+    }
+
+    template <typename Batch>
+    Batch* readFromColumnarFile(const std::string& path)
+    {
+        return new Batch(std::make_shared<ColumnarFile>(path));
+    }
+
+    struct ColumnWriter
+    {
+        std::vector<ColumnarColumn> columns;
+        std::vector<std::pair<const void*, uint64_t> > data;
+        std::vector<std::vector<uint64_t> > offsets;
+        uint64_t size;
+
+        template <typename T>
+        void operator()(const char* name, T*& values)
+        {
+            add(name, ColumnarTypeOf<T>::value, sizeof(T), size * sizeof(T));
+            data.push_back(std::make_pair(static_cast<const void*>(values), size * sizeof(T)));
+        }
+
+        void operator()(const char* name, STRING_TYPE*& values)
+        {
+            offsets.emplace_back();
+            std::vector<uint64_t>& o = offsets.back();
+            o.reserve(size + 1);
+            uint64_t pos = (size + 1) * sizeof(uint64_t);
+            for (uint64_t i = 0; i < size; i++)
+            {
+                o.push_back(pos);
+                pos += values[i].size() + 1;
+            }
+            o.push_back(pos);
+            add(name, COLUMN_STRING, sizeof(uint64_t), pos);
+            data.push_back(std::make_pair(static_cast<const void*>(values), 0));
+        }
+
+        void add(const char* name, uint32_t type, uint32_t width, uint64_t length)
+        {
+            if (strlen(name) >= COLUMNAR_NAME_SIZE)
+                throw std::runtime_error(std::string("column name too long: ") + name);
+            ColumnarColumn c;
+            memset(&c, 0, sizeof(c));
+            strncpy(c.name, name, COLUMNAR_NAME_SIZE - 1);
+            c.type = type;
+            c.width = width;
+            c.length = length;
+            columns.push_back(c);
+        }
+    };
+
+    template <typename Batch>
+    void writeToColumnarFile(Batch& batch, const std::string& path)
+    {
+        ColumnWriter writer;
+        writer.size = batch.size;
+        batch.visitColumns(writer);
+
+        ColumnarHeader header;
+        memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+        header.version = COLUMNAR_VERSION;
+        header.numColumns = writer.columns.size();
+        header.numRows = batch.size;
+
+        uint64_t pos = sizeof(ColumnarHeader) + writer.columns.size() * sizeof(ColumnarColumn);
+        for (ColumnarColumn& c : writer.columns)
+        {
+            c.offset = alignColumn(pos);
+            pos = c.offset + c.length;
+        }
+
+        std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("cannot create columnar file " + path);
+        file.write((const char*) &header, sizeof(header));
+        file.write((const char*) writer.columns.data(), writer.columns.size() * sizeof(ColumnarColumn));
+        pos = sizeof(ColumnarHeader) + writer.columns.size() * sizeof(ColumnarColumn);
+
+        static const char padding[COLUMNAR_ALIGNMENT] = { };
+        size_t strings = 0;
+        for (size_t i = 0; i < writer.columns.size(); i++)
+        {
+            const ColumnarColumn& c = writer.columns[i];
+            file.write(padding, c.offset - pos);
+            if (c.type == COLUMN_STRING)
+            {
+                const std::vector<uint64_t>& o = writer.offsets[strings++];
+                const STRING_TYPE* values = static_cast<const STRING_TYPE*>(writer.data[i].first);
+                file.write((const char*) o.data(), o.size() * sizeof(uint64_t));
+                for (uint64_t j = 0; j < batch.size; j++)
+                    file.write(values[j].c_str() != nullptr ? values[j].c_str() : "", values[j].size()).put('\0');
+            }
+            else
+            {
+                file.write((const char*) writer.data[i].first, writer.data[i].second);
+            }
+            pos = c.offset + c.length;
+        }
+        file.close();
+        if (!file) throw std::runtime_error("cannot write columnar file " + path);
+    }
+}
+
+#endif /* DBTOASTER_COLUMNAR_HPP */
@@ -5,6 +5,15 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#ifndef CSV_PARSE_BLOCK_SIZE
+#define CSV_PARSE_BLOCK_SIZE (8 << 20)   // bytes split by one thread at once
+#endif
 
 namespace dbtoaster {
         
@@ -51,21 +60,98 @@ namespace dbtoaster {
         return str;
     }   
 
+    // Splits a row into its fields the way repeated std::getline calls with
+    // the delimiter do, i.e., an empty last field is dropped.
+    inline void splitRow(const char* begin, const char* end, char delimiter, std::vector<std::string>& fields)
+    {
+        const char* start = begin;
+        for (const char* p = begin; p < end; ++p)
+        {
+            if (*p == delimiter)
+            {
+                fields.emplace_back(start, p);
+                start = p + 1;
+            }
+        }
+        if (start < end) fields.emplace_back(start, end);
+    }
+
+    // Splits the newline-terminated rows of [begin, end) into their fields.
+    inline void splitRows(const char* begin, const char* end, char delimiter, std::vector<std::vector<std::string>>& rows)
+    {
+        while (begin < end)
+        {
+            const char* eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            if (eol == nullptr) eol = end;
+            rows.emplace_back();
+            splitRow(begin, eol, delimiter, rows.back());
+            begin = eol + 1;
+        }
+    }
+
+    inline const char* nextRow(const char* pos, const char* end)
+    {
+        if (pos >= end) return end;
+        const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        return (eol == nullptr ? end : eol + 1);
+    }
+
+    // Rows are split into fields by 'numThreads' threads (default: one per
+    // core), each working on a range of whole rows. The rows are then turned
+    // into T on the calling thread, in their original order; T may allocate
+    // from pools that are not thread-safe.
     template <typename T>
-    void readFromFile(std::vector<T>& data, const std::string& path, char delimiter)
+    void readFromFile(std::vector<T>& data, const std::string& path, char delimiter, size_t numThreads = 0)
     {            
         data.clear();
         
-        std::ifstream file(path);
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        file.seekg(0, std::ios::end);
+        std::streamoff length = file.tellg();
+        if (length <= 0) return;
+        std::vector<char> buffer(length);
+        file.seekg(0, std::ios::beg);
+        file.read(buffer.data(), length);
+        file.close();
+
+        if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 1;
 
-        CSVAdaptor row(delimiter);
-        while (file >> row)
+        std::vector<std::vector<std::vector<std::string>>> rows(numThreads);
+        std::vector<const char*> cuts(numThreads + 1);
+        const char* pos = buffer.data();
+        const char* end = pos + buffer.size();
+        while (pos < end)
         {
-            T tmp(row.data);
-            data.push_back(tmp);
-        }
+            size_t blockSize = numThreads * CSV_PARSE_BLOCK_SIZE;
+            const char* blockEnd = ((size_t)(end - pos) <= blockSize ? end : nextRow(pos + blockSize, end));
 
-        file.close();
+            cuts[0] = pos;
+            for (size_t i = 1; i < numThreads; i++)
+            {
+                cuts[i] = nextRow(std::max(cuts[i - 1], pos + (blockEnd - pos) / numThreads * i), blockEnd);
+            }
+            cuts[numThreads] = blockEnd;
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < numThreads; i++)
+            {
+                threads.emplace_back(splitRows, cuts[i], cuts[i + 1], delimiter, std::ref(rows[i]));
+            }
+            splitRows(cuts[0], cuts[1], delimiter, rows[0]);
+            for (std::thread& t : threads) t.join();
+
+            for (size_t i = 0; i < numThreads; i++)
+            {
+                for (std::vector<std::string>& row : rows[i])
+                {
+                    T tmp(row);
+                    data.push_back(tmp);
+                }
+                rows[i].clear();
+            }
+            pos = blockEnd;
+        }
     }
 
     template <typename T>
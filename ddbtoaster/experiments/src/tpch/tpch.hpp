@@ -4,6 +4,7 @@
 #include <vector>
 #include "types.hpp"
 #include "serialization.hpp"
+#include "columnar.hpp"
 
 namespace dbtoaster 
 {
@@ -403,7 +404,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHLineitemBatch
+    struct TPCHLineitemBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -428,6 +429,13 @@ namespace dbtoaster
 
         TPCHLineitemBatch(size_t c) { initCapacity(c); }            
 
+        TPCHLineitemBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHLineitemBatch(TPCHLineitemBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHLineitemBatch(const TPCHLineitemBatch& batch) 
         {
             initCapacity(batch.size);
@@ -480,6 +488,27 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("orderkey", orderkey);
+            v("partkey", partkey);
+            v("suppkey", suppkey);
+            v("linenumber", linenumber);
+            v("quantity", quantity);
+            v("extendedprice", extendedprice);
+            v("discount", discount);
+            v("tax", tax);
+            v("returnflag", returnflag);
+            v("linestatus", linestatus);
+            v("shipdate", shipdate);
+            v("commitdate", commitdate);
+            v("receiptdate", receiptdate);
+            v("shipinstruct", shipinstruct);
+            v("shipmode", shipmode);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c) 
         {           
             assert(c > 0);
@@ -527,6 +556,7 @@ namespace dbtoaster
 
         ~TPCHLineitemBatch()
         {
+            if (!ownsColumns) return;
             delete[] orderkey;
             delete[] partkey;
             delete[] suppkey;
@@ -546,7 +576,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHOrdersBatch
+    struct TPCHOrdersBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -564,6 +594,13 @@ namespace dbtoaster
 
         TPCHOrdersBatch(size_t c) { initCapacity(c); }
 
+        TPCHOrdersBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHOrdersBatch(TPCHOrdersBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHOrdersBatch(const TPCHOrdersBatch& batch)
         {
             initCapacity(batch.size);
@@ -602,6 +639,20 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("orderkey", orderkey);
+            v("custkey", custkey);
+            v("orderstatus", orderstatus);
+            v("totalprice", totalprice);
+            v("orderdate", orderdate);
+            v("orderpriority", orderpriority);
+            v("clerk", clerk);
+            v("shippriority", shippriority);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c) 
         {           
             assert(c > 0);
@@ -635,6 +686,7 @@ namespace dbtoaster
 
         ~TPCHOrdersBatch()
         {
+            if (!ownsColumns) return;
             delete[] orderkey;
             delete[] custkey;
             delete[] orderstatus;
@@ -647,7 +699,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHCustomerBatch
+    struct TPCHCustomerBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -663,6 +715,13 @@ namespace dbtoaster
         //TPCHCustomerBatch() : size(0), capacity(0) { }
 
         TPCHCustomerBatch(size_t c) { initCapacity(c); }
+
+        TPCHCustomerBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHCustomerBatch(TPCHCustomerBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
         
         TPCHCustomerBatch(const TPCHCustomerBatch& batch)
         {
@@ -700,6 +759,19 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("custkey", custkey);
+            v("name", name);
+            v("address", address);
+            v("nationkey", nationkey);
+            v("phone", phone);
+            v("acctbal", acctbal);
+            v("mktsegment", mktsegment);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c) 
         {           
             assert(c > 0);
@@ -731,6 +803,7 @@ namespace dbtoaster
 
         ~TPCHCustomerBatch()
         {
+            if (!ownsColumns) return;
             delete[] custkey;
             delete[] name;
             delete[] address;
@@ -742,7 +815,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHPartSuppBatch
+    struct TPCHPartSuppBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -755,6 +828,13 @@ namespace dbtoaster
         // TPCHPartSuppBatch() : size(0), capacity(0) { }
 
         TPCHPartSuppBatch(size_t c) { initCapacity(c); } 
+
+        TPCHPartSuppBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHPartSuppBatch(TPCHPartSuppBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
         
         TPCHPartSuppBatch(const TPCHPartSuppBatch& batch)
         {
@@ -786,6 +866,16 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("partkey", partkey);
+            v("suppkey", suppkey);
+            v("availqty", availqty);
+            v("supplycost", supplycost);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c)
         {
             assert(c > 0);
@@ -811,6 +901,7 @@ namespace dbtoaster
 
         ~TPCHPartSuppBatch()
         {
+            if (!ownsColumns) return;
             delete[] partkey;
             delete[] suppkey;
             delete[] availqty;
@@ -819,7 +910,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHPartBatch
+    struct TPCHPartBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -837,6 +928,13 @@ namespace dbtoaster
 
         TPCHPartBatch(size_t c) { initCapacity(c); } 
 
+        TPCHPartBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHPartBatch(TPCHPartBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHPartBatch(const TPCHPartBatch& batch)
         {
             initCapacity(batch.size);
@@ -875,6 +973,20 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("partkey", partkey);
+            v("name", name);
+            v("mfgr", mfgr);
+            v("brand", brand);
+            v("type", type);
+            v("psize", psize);
+            v("container", container);
+            v("retailprice", retailprice);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c)
         {
             assert(c > 0);
@@ -908,6 +1020,7 @@ namespace dbtoaster
 
         ~TPCHPartBatch()
         {
+            if (!ownsColumns) return;
             delete[] partkey;
             delete[] name;
             delete[] mfgr;
@@ -920,7 +1033,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHSupplierBatch
+    struct TPCHSupplierBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -936,6 +1049,13 @@ namespace dbtoaster
 
         TPCHSupplierBatch(size_t c) { initCapacity(c); }
 
+        TPCHSupplierBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHSupplierBatch(TPCHSupplierBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHSupplierBatch(const TPCHSupplierBatch& batch)
         {
             initCapacity(batch.size);
@@ -970,6 +1090,18 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("suppkey", suppkey);
+            v("name", name);
+            v("address", address);
+            v("nationkey", nationkey);
+            v("phone", phone);
+            v("acctbal", acctbal);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c)
         {
             assert(c > 0);
@@ -999,6 +1131,7 @@ namespace dbtoaster
 
         ~TPCHSupplierBatch()
         {
+            if (!ownsColumns) return;
             delete[] suppkey;
             delete[] name;
             delete[] address;
@@ -1009,7 +1142,7 @@ namespace dbtoaster
         }  
     };
 
-    struct TPCHNationBatch
+    struct TPCHNationBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -1022,6 +1155,13 @@ namespace dbtoaster
 
         TPCHNationBatch(size_t c) { initCapacity(c); }
 
+        TPCHNationBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHNationBatch(TPCHNationBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHNationBatch(const TPCHNationBatch& batch)
         {
             initCapacity(batch.size);
@@ -1050,6 +1190,15 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("nationkey", nationkey);
+            v("name", name);
+            v("regionkey", regionkey);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c)
         {
             assert(c > 0);
@@ -1073,6 +1222,7 @@ namespace dbtoaster
 
         ~TPCHNationBatch()
         {
+            if (!ownsColumns) return;
             delete[] nationkey;
             delete[] name;
             delete[] regionkey;
@@ -1080,7 +1230,7 @@ namespace dbtoaster
         }
     };
 
-    struct TPCHRegionBatch
+    struct TPCHRegionBatch : ColumnarBatch
     {
         size_t size;
         size_t capacity;
@@ -1092,6 +1242,13 @@ namespace dbtoaster
 
         TPCHRegionBatch(size_t c) { initCapacity(c); }
 
+        TPCHRegionBatch(const std::shared_ptr<ColumnarFile>& f) : ColumnarBatch(f) { f->bind(*this); }
+
+        TPCHRegionBatch(TPCHRegionBatch& batch, size_t offset, size_t length) : ColumnarBatch(batch.file)
+        {
+            sliceColumns(*this, batch, offset, length);
+        }
+
         TPCHRegionBatch(const TPCHRegionBatch& batch)
         {
             initCapacity(batch.size);
@@ -1118,6 +1275,14 @@ namespace dbtoaster
             }
         }
 
+        template <class Visitor>
+        void visitColumns(Visitor& v)
+        {
+            v("regionkey", regionkey);
+            v("name", name);
+            v("comment", comment);
+        }
+
         void initCapacity(size_t c)
         {
             assert(c > 0);
@@ -1139,6 +1304,7 @@ namespace dbtoaster
 
         ~TPCHRegionBatch()
         {
+            if (!ownsColumns) return;
             delete[] regionkey;
             delete[] name;
             delete[] comment;
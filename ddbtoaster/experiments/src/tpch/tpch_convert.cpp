@@ -0,0 +1,76 @@
+// Converts TPC-H CSV files into the columnar files that tpch_template.hpp
+// maps instead of parsing when compiled with -DCOLUMNAR_INPUT.
+//
+//   g++ -std=c++11 -O3 -pthread src/tpch/tpch_convert.cpp -I src/lib -I src/tpch -o bin/tpch_convert
+//   bin/tpch_convert lineitem datasets/tpch/standard/lineitem.csv datasets/tpch/standard/lineitem.col
+//
+// See also convert_tpch.sh.
+
+#include <cassert>
+#include <iostream>
+#include "macro.hpp"
+#include "types.hpp"
+#include "functions.hpp"
+#include "stopwatch.hpp"
+#include "tpch.hpp"
+#include "csvreader.hpp"
+
+using namespace dbtoaster;
+
+template <typename T, typename Batch>
+int convert(const std::string& input, const std::string& output)
+{
+    Stopwatch sw;
+    sw.restart();
+    std::vector<T> rows;
+    readFromFile(rows, input, '|');
+    if (rows.empty())
+    {
+        std::cerr << "No rows in " << input << std::endl;
+        return 1;
+    }
+    Batch batch(rows);
+    rows.clear();
+    writeToColumnarFile(batch, output);
+
+    // Read the file back, so that a truncated or mismatching file is
+    // reported here rather than when a query is run.
+    std::unique_ptr<Batch> mapped(readFromColumnarFile<Batch>(output));
+    sw.stop();
+    if (mapped->size != batch.size)
+    {
+        std::cerr << "Row count mismatch in " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Converted " << input << " (" << batch.size << " rows) to " << output << "... "
+              << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <table> <input.csv> <output.col>" << std::endl;
+        return 1;
+    }
+    std::string table(argv[1]);
+    try
+    {
+        if (table == "lineitem") return convert<TPCHLineitem, TPCHLineitemBatch>(argv[2], argv[3]);
+        if (table == "orders") return convert<TPCHOrders, TPCHOrdersBatch>(argv[2], argv[3]);
+        if (table == "customer") return convert<TPCHCustomer, TPCHCustomerBatch>(argv[2], argv[3]);
+        if (table == "partsupp") return convert<TPCHPartSupp, TPCHPartSuppBatch>(argv[2], argv[3]);
+        if (table == "part") return convert<TPCHPart, TPCHPartBatch>(argv[2], argv[3]);
+        if (table == "supplier") return convert<TPCHSupplier, TPCHSupplierBatch>(argv[2], argv[3]);
+        if (table == "nation") return convert<TPCHNation, TPCHNationBatch>(argv[2], argv[3]);
+        if (table == "region") return convert<TPCHRegion, TPCHRegionBatch>(argv[2], argv[3]);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "Unknown table " << table << std::endl;
+    return 1;
+}
@@ -1,6 +1,7 @@
 #ifndef DBTOASTER_TEST_TEMPLATE_HPP
 #define DBTOASTER_TEST_TEMPLATE_HPP
 
+#include <deque>
 #include "stopwatch.hpp"
 #include "csvreader.hpp"
 
@@ -59,6 +60,19 @@ namespace dbtoaster
     #endif
 
 
+    // With COLUMNAR_INPUT, relations are mapped from the columnar files
+    // written by tpch_convert (see convert_tpch.sh) instead of parsed from CSV.
+#ifdef COLUMNAR_INPUT
+    #define LOAD_RELATION(batch, T, name)                                           \
+        batch = readFromColumnarFile<T##Batch>(dataPath + "/" + dataset + "/" + name + ".col");
+#else
+    #define LOAD_RELATION(batch, T, name) {                                         \
+        std::vector<T> rows;                                                        \
+        readFromFile(rows, dataPath + "/" + dataset + "/" + name + ".csv", '|');    \
+        batch = new T##Batch(rows);                                                 \
+    }
+#endif
+
     class data_t;
 
     IF_LINEITEM ( TPCHLineitemBatch* lineitemBatch; )
@@ -76,84 +90,52 @@ namespace dbtoaster
 
         IF_LINEITEM ({
             sw.restart();
-            std::vector<TPCHLineitem> lineitems;
-            //readFromBinaryFile(lineitems, dataPath + "/" + dataset + "/lineitem.bin");
-            readFromFile(lineitems, dataPath + "/" + dataset + "/lineitem.csv", '|');
-            //writeToBinaryFile(lineitems, dataPath + "/" + dataset + "/lineitem.bin");
-            lineitemBatch = new TPCHLineitemBatch(lineitems);
+            LOAD_RELATION(lineitemBatch, TPCHLineitem, "lineitem")
             sw.stop();
             std::cout << "Loaded lineitem (" << lineitemBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_ORDERS ({
             sw.restart();
-            std::vector<TPCHOrders> orders;
-            //readFromBinaryFile(orders, dataPath + "/" + dataset + "./orders.bin");
-            readFromFile(orders, dataPath + "/" + dataset + "/orders.csv", '|');
-            //writeToBinaryFile(orders, dataPath + "/" + dataset + "/orders.bin");
-            ordersBatch = new TPCHOrdersBatch(orders);
+            LOAD_RELATION(ordersBatch, TPCHOrders, "orders")
             sw.stop();
             std::cout << "Loaded orders (" << ordersBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_CUSTOMER ({
             sw.restart();
-            std::vector<TPCHCustomer> customers;
-            //readFromBinaryFile(customers, dataPath + "/" + dataset + "/customers.bin");
-            readFromFile(customers, dataPath + "/" + dataset + "/customer.csv", '|');
-            //writeToBinaryFile(customers, dataPath + "/" + dataset + "/customers.bin");
-            customerBatch = new TPCHCustomerBatch(customers);            
+            LOAD_RELATION(customerBatch, TPCHCustomer, "customer")
             sw.stop();
             std::cout << "Loaded customer (" << customerBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_PARTSUPP ({
             sw.restart();
-            std::vector<TPCHPartSupp> partsupps;
-            //readFromBinaryFile(partsupps, dataPath + "/" + dataset + "/partsupp.bin");
-            readFromFile(partsupps, dataPath + "/" + dataset + "/partsupp.csv", '|');
-            //writeToBinaryFile(partsupps, dataPath + "/" + dataset + "/partsupp.bin");
-            partsuppBatch = new TPCHPartSuppBatch(partsupps);            
+            LOAD_RELATION(partsuppBatch, TPCHPartSupp, "partsupp")
             sw.stop();
             std::cout << "Loaded partsupp (" << partsuppBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_PART ({
             sw.restart();
-            std::vector<TPCHPart> parts;
-            //readFromBinaryFile(parts, dataPath + "/" + dataset + "/part.bin");
-            readFromFile(parts, dataPath + "/" + dataset + "/part.csv", '|');
-            //writeToBinaryFile(parts, dataPath + "/" + dataset + "/part.bin");
-            partBatch = new TPCHPartBatch(parts);    
+            LOAD_RELATION(partBatch, TPCHPart, "part")
             sw.stop();
             std::cout << "Loaded part (" << partBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_SUPPLIER ({
             sw.restart();
-            std::vector<TPCHSupplier> suppliers;
-            //readFromBinaryFile(suppliers, dataPath + "/" + dataset + "/supplier.bin");
-            readFromFile(suppliers, dataPath + "/" + dataset + "/supplier.csv", '|');
-            //writeToBinaryFile(suppliers, dataPath + "/" + dataset + "/supplier.bin");
-            supplierBatch = new TPCHSupplierBatch(suppliers);
+            LOAD_RELATION(supplierBatch, TPCHSupplier, "supplier")
             sw.stop();
             std::cout << "Loaded supplier (" << supplierBatch->size << ")... " << sw.elapsedTimeInMilliSeconds() << " ms" << std::endl;
         })
 
         IF_NATION ({
-            std::vector<TPCHNation> nations;
-            //readFromBinaryFile(nations, dataPath + "/" + dataset + "/nation.bin");
-            readFromFile(nations, dataPath + "/" + dataset + "/nation.csv", '|');
-            //writeToBinaryFile(nations, dataPath + "/" + dataset + "/nation.bin");
-            nationBatch = new TPCHNationBatch(nations);
+            LOAD_RELATION(nationBatch, TPCHNation, "nation")
         })  
 
         IF_REGION ({
-            std::vector<TPCHRegion> regions;
-            //readFromBinaryFile(regions, dataPath + "/" + dataset + "/region.bin");
-            readFromFile(regions, dataPath + "/" + dataset + "/region.csv", '|');
-            //writeToBinaryFile(regions, dataPath + "/" + dataset + "/region.bin");
-            regionBatch = new TPCHRegionBatch(regions);
+            LOAD_RELATION(regionBatch, TPCHRegion, "region")
         })    
     }
 
@@ -172,50 +154,61 @@ namespace dbtoaster
 
 #ifdef BATCH_MODE
 
+    // Stream batches are slices of the loaded relations: they share their
+    // columns (and, with COLUMNAR_INPUT, the mapped file) instead of copying
+    // the tuples. A deque never relocates them as batches are added.
+    struct BatchRange
+    {
+        size_t start;
+        size_t size;
+
+        BatchRange() : start(0), size(0) { }
+    };
+
     // Vectors storing batch updates
-    IF_LINEITEM ( std::vector<TPCHLineitemBatch> lineitemBatchList; )    
-    IF_ORDERS ( std::vector<TPCHOrdersBatch> ordersBatchList; )
-    IF_CUSTOMER ( std::vector<TPCHCustomerBatch> customerBatchList; )
-    IF_PARTSUPP ( std::vector<TPCHPartSuppBatch> partsuppBatchList; )
-    IF_PART ( std::vector<TPCHPartBatch> partBatchList; )
-    IF_SUPPLIER ( std::vector<TPCHSupplierBatch> supplierBatchList; )
+    IF_LINEITEM ( std::deque<TPCHLineitemBatch> lineitemBatchList; )    
+    IF_ORDERS ( std::deque<TPCHOrdersBatch> ordersBatchList; )
+    IF_CUSTOMER ( std::deque<TPCHCustomerBatch> customerBatchList; )
+    IF_PARTSUPP ( std::deque<TPCHPartSuppBatch> partsuppBatchList; )
+    IF_PART ( std::deque<TPCHPartBatch> partBatchList; )
+    IF_SUPPLIER ( std::deque<TPCHSupplierBatch> supplierBatchList; )
     IF_NATION ( std::vector<TPCHNationBatch> nationBatchList; )
     IF_REGION ( std::vector<TPCHRegionBatch> regionBatchList; )
 
-    #define FLUSH_LINEITEM_BATCH {                      \
-        TPCHLineitemBatch batch(tmpLineitemBatch);      \
-        lineitemBatchList.push_back(batch);             \
-        tmpLineitemBatch.size = 0;                      \
+    #define FLUSH_LINEITEM_BATCH {                                                                     \
+        lineitemBatchList.emplace_back(*lineitemBatch, tmpLineitemBatch.start, tmpLineitemBatch.size); \
+        tmpLineitemBatch.start += tmpLineitemBatch.size;                                               \
+        tmpLineitemBatch.size = 0;                                                                     \
     }
 
-    #define FLUSH_ORDERS_BATCH {                        \
-        TPCHOrdersBatch batch(tmpOrdersBatch);          \
-        ordersBatchList.push_back(batch);               \
-        tmpOrdersBatch.size = 0;                        \
+    #define FLUSH_ORDERS_BATCH {                                                               \
+        ordersBatchList.emplace_back(*ordersBatch, tmpOrdersBatch.start, tmpOrdersBatch.size); \
+        tmpOrdersBatch.start += tmpOrdersBatch.size;                                           \
+        tmpOrdersBatch.size = 0;                                                               \
     }
 
-    #define FLUSH_CUSTOMER_BATCH {                      \
-        TPCHCustomerBatch batch(tmpCustomerBatch);      \
-        customerBatchList.push_back(batch);             \
-        tmpCustomerBatch.size = 0;                      \
+    #define FLUSH_CUSTOMER_BATCH {                                                                     \
+        customerBatchList.emplace_back(*customerBatch, tmpCustomerBatch.start, tmpCustomerBatch.size); \
+        tmpCustomerBatch.start += tmpCustomerBatch.size;                                               \
+        tmpCustomerBatch.size = 0;                                                                     \
     }
 
-    #define FLUSH_PART_BATCH {                          \
-        TPCHPartBatch batch(tmpPartBatch);              \
-        partBatchList.push_back(batch);                 \
-        tmpPartBatch.size = 0;                          \
+    #define FLUSH_PART_BATCH {                                                         \
+        partBatchList.emplace_back(*partBatch, tmpPartBatch.start, tmpPartBatch.size); \
+        tmpPartBatch.start += tmpPartBatch.size;                                       \
+        tmpPartBatch.size = 0;                                                         \
     }
 
-    #define FLUSH_PARTSUPP_BATCH {                      \
-        TPCHPartSuppBatch batch(tmpPartsuppBatch);      \
-        partsuppBatchList.push_back(batch);             \
-        tmpPartsuppBatch.size = 0;                      \
+    #define FLUSH_PARTSUPP_BATCH {                                                                     \
+        partsuppBatchList.emplace_back(*partsuppBatch, tmpPartsuppBatch.start, tmpPartsuppBatch.size); \
+        tmpPartsuppBatch.start += tmpPartsuppBatch.size;                                               \
+        tmpPartsuppBatch.size = 0;                                                                     \
     }
 
-    #define FLUSH_SUPPLIER_BATCH {                      \
-        TPCHSupplierBatch batch(tmpSupplierBatch);      \
-        supplierBatchList.push_back(batch);             \
-        tmpSupplierBatch.size = 0;                      \
+    #define FLUSH_SUPPLIER_BATCH {                                                                     \
+        supplierBatchList.emplace_back(*supplierBatch, tmpSupplierBatch.start, tmpSupplierBatch.size); \
+        tmpSupplierBatch.start += tmpSupplierBatch.size;                                               \
+        tmpSupplierBatch.size = 0;                                                                     \
     }
 
     #define FLUSH_NATION_BATCH {                        \
@@ -245,24 +238,7 @@ namespace dbtoaster
     }        
 
     #define ADD_TO_LINEITEM_BATCH {             \
-        tmpLineitemBatch.add(                   \
-            lineitemBatch->orderkey[i],         \
-            lineitemBatch->partkey[i],          \
-            lineitemBatch->suppkey[i],          \
-            lineitemBatch->linenumber[i],       \
-            lineitemBatch->quantity[i],         \
-            lineitemBatch->extendedprice[i],    \
-            lineitemBatch->discount[i],         \
-            lineitemBatch->tax[i],              \
-            lineitemBatch->returnflag[i],       \
-            lineitemBatch->linestatus[i],       \
-            lineitemBatch->shipdate[i],         \
-            lineitemBatch->commitdate[i],       \
-            lineitemBatch->receiptdate[i],      \
-            lineitemBatch->shipinstruct[i],     \
-            lineitemBatch->shipmode[i],         \
-            lineitemBatch->comment[i]           \
-        );                                      \
+        tmpLineitemBatch.size++;                \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
@@ -270,17 +246,7 @@ namespace dbtoaster
     }
 
     #define ADD_TO_ORDERS_BATCH {               \
-        tmpOrdersBatch.add(                     \
-            ordersBatch->orderkey[i],           \
-            ordersBatch->custkey[i],            \
-            ordersBatch->orderstatus[i],        \
-            ordersBatch->totalprice[i],         \
-            ordersBatch->orderdate[i],          \
-            ordersBatch->orderpriority[i],      \
-            ordersBatch->clerk[i],              \
-            ordersBatch->shippriority[i],       \
-            ordersBatch->comment[i]             \
-        );                                      \
+        tmpOrdersBatch.size++;                  \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
@@ -288,16 +254,7 @@ namespace dbtoaster
     }
 
     #define ADD_TO_CUSTOMER_BATCH {             \
-        tmpCustomerBatch.add(                   \
-            customerBatch->custkey[i],          \
-            customerBatch->name[i],             \
-            customerBatch->address[i],          \
-            customerBatch->nationkey[i],        \
-            customerBatch->phone[i],            \
-            customerBatch->acctbal[i],          \
-            customerBatch->mktsegment[i],       \
-            customerBatch->comment[i]           \
-        );                                      \
+        tmpCustomerBatch.size++;                \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
@@ -305,33 +262,15 @@ namespace dbtoaster
     }
 
     #define ADD_TO_PART_BATCH {                 \
-         tmpPartBatch.add(                      \
-            partBatch->partkey[i],              \
-            partBatch->name[i],                 \
-            partBatch->mfgr[i],                 \
-            partBatch->brand[i],                \
-            partBatch->type[i],                 \
-            partBatch->psize[i],                \
-            partBatch->container[i],            \
-            partBatch->retailprice[i],          \
-            partBatch->comment[i]               \
-        );                                      \
+        tmpPartBatch.size++;                    \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
         }                                       \
-     }
+    }
 
     #define ADD_TO_SUPPLIER_BATCH {             \
-        tmpSupplierBatch.add(                   \
-            supplierBatch->suppkey[i],          \
-            supplierBatch->name[i],             \
-            supplierBatch->address[i],          \
-            supplierBatch->nationkey[i],        \
-            supplierBatch->phone[i],            \
-            supplierBatch->acctbal[i],          \
-            supplierBatch->comment[i]           \
-        );                                      \
+        tmpSupplierBatch.size++;                \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
@@ -339,13 +278,7 @@ namespace dbtoaster
     }
 
     #define ADD_TO_PARTSUPP_BATCH {             \
-        tmpPartsuppBatch.add(                   \
-            partsuppBatch->partkey[i],          \
-            partsuppBatch->suppkey[i],          \
-            partsuppBatch->availqty[i],         \
-            partsuppBatch->supplycost[i],       \
-            partsuppBatch->comment[i]           \
-        );                                      \
+        tmpPartsuppBatch.size++;                \
         if (++batchCounter == batchSize) {      \
             FLUSH_STREAM_BATCHES                \
             batchCounter = 0;                   \
@@ -449,12 +382,12 @@ namespace dbtoaster
     { 
         size_t i = 0, count = 0, batchCounter = 0;
 
-        IF_LINEITEM ( TPCHLineitemBatch tmpLineitemBatch(batchSize); )
-        IF_ORDERS ( TPCHOrdersBatch tmpOrdersBatch(batchSize); )
-        IF_CUSTOMER ( TPCHCustomerBatch tmpCustomerBatch(batchSize); )
-        IF_PARTSUPP ( TPCHPartSuppBatch tmpPartsuppBatch(batchSize); )
-        IF_PART ( TPCHPartBatch tmpPartBatch(batchSize); )    
-        IF_SUPPLIER ( TPCHSupplierBatch tmpSupplierBatch(batchSize); )
+        IF_LINEITEM ( BatchRange tmpLineitemBatch; )
+        IF_ORDERS ( BatchRange tmpOrdersBatch; )
+        IF_CUSTOMER ( BatchRange tmpCustomerBatch; )
+        IF_PARTSUPP ( BatchRange tmpPartsuppBatch; )
+        IF_PART ( BatchRange tmpPartBatch; )    
+        IF_SUPPLIER ( BatchRange tmpSupplierBatch; )
 
 
         IF_SUPPLIER ({
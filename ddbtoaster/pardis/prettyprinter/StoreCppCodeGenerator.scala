@@ -437,6 +437,10 @@ class StoreCppCodeGenerator(override val IR: StoreDSL) extends CCodeGenerator wi
     case StoreInsert(self, e) => doc"$self.add($e)"
     case StoreUnsafeInsert(self, e) if Optimizer.concCPP => doc"$self.insert_nocheck($e, xact)"
     case StoreUnsafeInsert(self, e)  => doc"$self.insert_nocheck($e)"
+    // As for slices below, a constant index number calls the index through its own type
+    case StoreGet(self, Constant(idx: Int), key) if !Optimizer.concCPP => doc"$self.template get<$idx>($key)"
+    case StoreGetCopy(self, Constant(idx: Int), key) if !Optimizer.concCPP => doc"$self.template getCopy<$idx>($key)"
+    case StoreGetCopyDependent(self, Constant(idx: Int), key) if !Optimizer.concCPP => doc"$self.template getCopyDependent<$idx>($key)"
     case StoreGet(self, idx, key) => doc"$self.get($key, $idx)"
     case StoreGetCopy(self, idx, key) => doc"$self.getCopy($key, $idx)"
     case StoreGetCopyDependent(self, idx, key) => doc"$self.getCopyDependent($key, $idx)"
@@ -446,6 +450,13 @@ class StoreCppCodeGenerator(override val IR: StoreDSL) extends CCodeGenerator wi
     case StoreDelete1(self, key) => doc"$self.del($key)"
     case StoreDeleteCopyDependent(self, key) => doc"$self.delCopyDependent($key)"
     case StoreDeleteCopy(self, key) => doc"$self.delCopy($key)"
+    // A constant index number selects the index type at compile time, so that the lambda 
+    // is inlined into the slice loop of that index. The number is printed as a plain 
+    // integer literal, and 'template' keeps the call valid where the store's type is
+    // dependent (it is also allowed elsewhere since C++11).
+    case StoreSlice(self, Constant(idx: Int), key, f) if !Optimizer.concCPP => doc"$self.template slice<$idx>($key, $f)"
+    case StoreSliceCopy(self, Constant(idx: Int), key, f) if !Optimizer.concCPP => doc"$self.template sliceCopy<$idx>($key, $f)"
+    case StoreSliceCopyDependent(self, Constant(idx: Int), key, f) if !Optimizer.concCPP => doc"$self.template sliceCopyDependent<$idx>($key, $f)"
     case StoreSlice(self, idx, key, f) => doc"$self.slice($idx, $key, $f)"
     case StoreSliceCopy(self, idx, key, f) => doc"$self.sliceCopy($idx, $key, $f)"
     case StoreSliceCopyDependent(self, idx, key, f) => doc"$self.sliceCopyDependent($idx, $key, $f)"
@@ -799,6 +799,9 @@ class TpccPardisConcCppGen(val IR: StoreDSL) extends TpccPardisGen {
 
     }
 
+    //tables with a ${name}TblSize constant in the header size their primary index from it
+    val tblSizes = Set("warehouseTbl", "itemTbl", "districtTbl", "customerTbl", "orderTbl", "newOrderTbl", "orderLineTbl", "stockTbl", "historyTbl")
+
     val (stTypdef, stDecl, stInit1, stRefs, stInit2) = optTP.globalVars.map(s => {
       def idxTypeName(i: Int) = s.name :: "Idx" :: i :: "Type"
 
@@ -814,7 +817,7 @@ class TpccPardisConcCppGen(val IR: StoreDSL) extends TpccPardisGen {
 
       val idxDecl = idx3.zipWithIndex.map(t => doc"${idxTypeName(t._2)}& ${t._1._1};").mkDocument("  ")
 
-      val storeinit = s.name :: (if (Optimizer.initialStoreSize) doc"(${s.name}ArrayLengths, ${s.name}PoolSizes)" else doc"()") :: ", "
+      val storeinit = s.name :: (if (Optimizer.initialStoreSize) doc"(${s.name}ArrayLengths, ${s.name}PoolSizes)" else if (tblSizes.contains(s.name)) doc"(${s.name}Size)" else doc"()") :: ", "
       val storeRefInit = s.name :: "(t." :: s.name :: "), "
 
       val idxInit = idx3.zipWithIndex.map(t => doc"${t._1._1}(*(${idxTypeName(t._2)} *)${s.name}.index[${t._2}])").mkDocument(", ")
@@ -83,6 +83,11 @@ object Compiler {
   private var packageName = DEFAULT_PACKAGE_NAME    // class package
   private var datasetName = DEFAULT_DATASET_NAME    // dataset name (used for codegen)
   private var datasetWithDeletions = false          // whether dataset contains deletions or not
+  private var swissIndexMaps = Set[String]()        // maps with an open-addressing primary index (C++)
+  private var tinyMaps = Set[String]()              // maps stored inline while they have few entries (C++)
+  private var flatMaps = Set[String]()              // maps with entries stored inline in a FlatHashMap (C++)
+  private var denseIndexMaps = Set[String]()        // integer-keyed maps with a direct-addressed primary index (C++)
+  private var batchPrefetch = false                 // prefetch map lookups ahead in batch trigger loops (C++)
   
   // Execution
   private var execOutput = false               // compile and execute immediately
@@ -146,6 +151,11 @@ object Compiler {
     error("  -d <name>     dataset name")
     error("  --del         dataset contains deletions")
     error("  -L            libraries for target language")
+    error("  --swiss-index <map>  open-addressing primary index for map, or * for all maps (C++)")
+    error("  --tiny-map <map>     map stored inline while it has few entries, or * for all maps (C++)")
+    error("  --flat-map <map>     map with entries stored inline in a flat table, or * for all maps (C++)")
+    error("  --dense-index <map>  direct-addressed primary index for map keyed by one integer, or * (C++)")
+    error("  --batch-prefetch     prefetch map lookups ahead in batch trigger loops (C++)")
     error("Execution options:")
     error("  -x            compile and execute immediately")
     error("  -xd <path>    destination for generated binaries")
@@ -203,6 +213,11 @@ object Compiler {
     packageName = DEFAULT_PACKAGE_NAME
     datasetName = DEFAULT_DATASET_NAME
     datasetWithDeletions = false
+    swissIndexMaps = Set()
+    tinyMaps = Set()
+    flatMaps = Set()
+    denseIndexMaps = Set()
+    batchPrefetch = false
   
     execOutput = false
     execArgs = Nil
@@ -253,6 +268,11 @@ object Compiler {
                               })
         case "-d" => eat(s => datasetName = s)
         case "--del" => datasetWithDeletions = true
+        case "--swiss-index" => eat(s => swissIndexMaps ++= s.split(",").map(_.trim))
+        case "--tiny-map" => eat(s => tinyMaps ++= s.split(",").map(_.trim))
+        case "--flat-map" => eat(s => flatMaps ++= s.split(",").map(_.trim))
+        case "--dense-index" => eat(s => denseIndexMaps ++= s.split(",").map(_.trim))
+        case "--batch-prefetch" => batchPrefetch = true
         case "-L" => eat(s => execRuntimeLibs = s :: execRuntimeLibs)
         // case "-wa" => watch = true;
         // case "-ni" => ni = true; frontendIvmDepth = 0; frontendDebugFlags = Nil
@@ -484,7 +504,8 @@ object Compiler {
     val codegenOpts =
       new CodeGenOptions(
         className, packageName, datasetName, datasetWithDeletions, execTimeoutMilli, 
-        DEPLOYMENT_STATUS == DEPLOYMENT_STATUS_RELEASE, PRINT_TIMING_INFO, execPrintProgress)
+        DEPLOYMENT_STATUS == DEPLOYMENT_STATUS_RELEASE, PRINT_TIMING_INFO, execPrintProgress,
+        swissIndexMaps, tinyMaps, flatMaps, denseIndexMaps, batchPrefetch)
 
     val (tCodegen, code) = Utils.ns(() => codegen(sourceM3, lang, codegenOpts))
 
@@ -54,7 +54,7 @@ struct MinAggregator {
             }
             return nullptr;
         }
-        Version<E>* newV = aligned_malloc(Version<E>);
+        Version<E>* newV = Version<E>::alloc(xact);
         new(newV) Version<E>(vh, xact);
         
         if (!e->versionHead.compare_exchange_strong(vh, newV)) {
@@ -63,7 +63,7 @@ struct MinAggregator {
                 Transaction* otherXact = TStoPTR(vh->xactid);
                 xact.failedBecauseOf = otherXact;
             }
-            free(newV);
+            Version<E>::release(newV, xact);
             return nullptr;
         }
         xact.undoBufferHead = newV;
@@ -119,7 +119,7 @@ struct MaxAggregator {
             }
             return nullptr;
         }
-        Version<E>* newV = aligned_malloc(Version<E>);
+        Version<E>* newV = Version<E>::alloc(xact);
         new(newV) Version<E>(vh, xact);
         
         if (!e->versionHead.compare_exchange_strong(vh, newV)) {
@@ -128,7 +128,7 @@ struct MaxAggregator {
                 Transaction* otherXact = TStoPTR(vh->xactid);
                 xact.failedBecauseOf = otherXact;
             }
-            free(newV);
+            Version<E>::release(newV, xact);
             return nullptr;
         }
         xact.undoBufferHead = newV;
@@ -200,7 +200,7 @@ struct MedianAggregator {
             return nullptr;
         }
 
-        Version<E>* newV = aligned_malloc(Version<E>);
+        Version<E>* newV = Version<E>::alloc(xact);
         new(newV) Version<E>(vh, xact);
         
          if (!e->versionHead.compare_exchange_strong(vh, newV)) {
@@ -209,7 +209,7 @@ struct MedianAggregator {
                 Transaction* otherXact = TStoPTR(vh->xactid);
                 xact.failedBecauseOf = otherXact;
             }
-            free(newV);
+            Version<E>::release(newV, xact);
             return nullptr;
         }
          xact.undoBufferHead = newV;
@@ -32,6 +32,8 @@ struct ForEachPred : public PRED {
 #endif
 
     virtual bool matchesAny(Transaction *t) {
+        if (!t->writeSummary.mayHaveWritten(tbl))
+            return false;
 
         VBase* dv = t->undoBufferHead;
         while (dv != nullptr) {
@@ -71,6 +73,8 @@ struct GetPred : public PRED {
 #endif
 
     virtual bool matchesAny(Transaction *t) {
+        if (!t->writeSummary.mayHaveWritten(tbl, IDX_FN::hash(key)))
+            return false;
 
         VBase* dv = t->undoBufferHead;
         while (dv != nullptr) {
@@ -116,6 +120,8 @@ struct SlicePred : public PRED {
 #endif
 
     virtual bool matchesAny(Transaction *t) {
+        if (!t->writeSummary.mayHaveWritten(tbl, IDX_FN::hash(key)))
+            return false;
         VBase* dv = t->undoBufferHead;
         while (dv != nullptr) {
             if (matches(dv))
@@ -170,6 +176,8 @@ struct MinSlicePred : public PRED {
 #endif
 
     virtual bool matchesAny(Transaction *t) {
+        if (!t->writeSummary.mayHaveWritten(tbl, IDX_FN::hash(key)))
+            return false;
         VBase* dv = t->undoBufferHead;
         while (dv != nullptr) {
             if (matches(dv))
@@ -223,6 +231,8 @@ struct MaxSlicePred : public PRED {
 #endif
 
     virtual bool matchesAny(Transaction *t) {
+        if (!t->writeSummary.mayHaveWritten(tbl, IDX_FN::hash(key)))
+            return false;
         VBase* dv = t->undoBufferHead;
         while (dv != nullptr) {
             if (matches(dv))
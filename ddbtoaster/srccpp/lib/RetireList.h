@@ -0,0 +1,66 @@
+#ifndef RETIRELIST_H
+#define RETIRELIST_H
+
+#include <vector>
+#include "types.h"
+#include "ThreadArena.h"
+
+/*
+ Objects that a thread has unlinked from the shared structures (versions,
+ entries) but that transactions still running may hold pointers to. Objects
+ retired since the last seal() are stamped with the timestamp passed to it,
+ read after they were unlinked; they are freed once every thread is idle or
+ runs a transaction that published a start timestamp at or after the stamp.
+ Only the owning thread touches the list.
+ */
+struct ALIGN RetireList {
+
+    struct Retired {
+        timestamp ts;
+        void* ptr;
+        void (*reclaim)(void*, ThreadArena&);
+    };
+
+    std::vector<Retired> items; //stamps are non-decreasing
+    size_t head; //items before head are freed
+    size_t sealed; //items before sealed are stamped
+
+    RetireList() : head(0), sealed(0) {
+    }
+
+    FORCE_INLINE void retire(void* ptr, void (*reclaim)(void*, ThreadArena&)) {
+        items.push_back(Retired{0, ptr, reclaim});
+    }
+
+    FORCE_INLINE bool hasUnsealed() const {
+        return sealed != items.size();
+    }
+
+    FORCE_INLINE void seal(timestamp ts) {
+        for (; sealed < items.size(); ++sealed)
+            items[sealed].ts = ts;
+    }
+
+    FORCE_INLINE bool empty() const {
+        return head == items.size();
+    }
+
+    //Frees the sealed objects retired at or before oldest, the start timestamp of the oldest active transaction, into the arena of the thread
+
+    FORCE_INLINE void reclaim(timestamp oldest, ThreadArena& arena) {
+        while (head < sealed && items[head].ts <= oldest) {
+            items[head].reclaim(items[head].ptr, arena);
+            ++head;
+        }
+        if (head == items.size()) {
+            items.clear();
+            head = sealed = 0;
+        } else if (head > items.size() / 2) {
+            items.erase(items.begin(), items.begin() + head);
+            sealed -= head;
+            head = 0;
+        }
+    }
+};
+
+#endif /* RETIRELIST_H */
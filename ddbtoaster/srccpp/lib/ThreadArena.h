@@ -0,0 +1,130 @@
+#ifndef THREADARENA_H
+#define THREADARENA_H
+
+#include <stdlib.h>
+#include <assert.h>
+#include "types.h"
+
+#ifndef PREDICATE_CHUNK_SIZE
+#define PREDICATE_CHUNK_SIZE (64 * 1024)
+#endif
+
+#define VERSION_POOL_CLASSES 16 //pooled blocks are 64 to 1024 bytes
+#ifndef VERSION_POOL_LIMIT
+#define VERSION_POOL_LIMIT 4096 //blocks per size, the rest go back to the global allocator
+#endif
+
+/*
+ Memory of the transactions run by one thread, which runs one at a time.
+ Predicates die with their transaction: they are bump-allocated from chunks
+ that commit and rollback release all at once (releasePredicates), without
+ running destructors, as the free() calls did before. Versions outlive their
+ transaction, so they come from per-size free lists of the blocks the thread
+ freed earlier: versions that lost a CAS, or that its rollbacks and GC passes
+ retired. Blocks are plain aligned_alloc blocks, so free() remains valid for
+ them and a block may be freed into the pool of a thread other than the one
+ that allocated it.
+ */
+struct ALIGN ThreadArena {
+
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    struct Block {
+        Block* next;
+    };
+
+    Chunk* chunks; //chunks in use first, then the free ones
+    Chunk* current;
+    char* top;
+    char* end;
+
+    Block* pools[VERSION_POOL_CLASSES];
+    size_t poolSizes[VERSION_POOL_CLASSES];
+
+    ThreadArena() : chunks(nullptr), current(nullptr), top(nullptr), end(nullptr) {
+        for (size_t i = 0; i < VERSION_POOL_CLASSES; ++i) {
+            pools[i] = nullptr;
+            poolSizes[i] = 0;
+        }
+    }
+
+    ~ThreadArena() {
+        while (chunks) {
+            Chunk* c = chunks;
+            chunks = chunks->next;
+            free(c);
+        }
+        for (size_t i = 0; i < VERSION_POOL_CLASSES; ++i) {
+            while (pools[i]) {
+                Block* b = pools[i];
+                pools[i] = b->next;
+                free(b);
+            }
+        }
+    }
+
+    static FORCE_INLINE char* data(Chunk* c) {
+        return (char*) (c + 1);
+    }
+
+    FORCE_INLINE void* allocPredicate(size_t size) {
+        size = (size + 15) & ~(size_t) 15;
+        if ((size_t) (end - top) < size)
+            nextChunk(size);
+        void* p = top;
+        top += size;
+        return p;
+    }
+
+    //Moves to the next free chunk, or links a new one after the current one if that is too small
+    void nextChunk(size_t size) {
+        Chunk* c = current ? current->next : chunks;
+        if (c == nullptr || c->size < size) {
+            size_t s = size > PREDICATE_CHUNK_SIZE ? size : PREDICATE_CHUNK_SIZE;
+            Chunk* n = (Chunk*) malloc(sizeof (Chunk) + s);
+            n->size = s;
+            n->next = c;
+            if (current)
+                current->next = n;
+            else
+                chunks = n;
+            c = n;
+        }
+        current = c;
+        top = data(c);
+        end = top + c->size;
+    }
+
+    FORCE_INLINE void releasePredicates() {
+        current = nullptr;
+        top = end = nullptr;
+    }
+
+    FORCE_INLINE void* allocVersion(size_t size) {
+        assert(size % 64 == 0);
+        size_t cls = size / 64 - 1;
+        if (cls < VERSION_POOL_CLASSES && pools[cls]) {
+            Block* b = pools[cls];
+            pools[cls] = b->next;
+            --poolSizes[cls];
+            return b;
+        }
+        return aligned_alloc(64, size);
+    }
+
+    FORCE_INLINE void freeVersion(void* p, size_t size) {
+        size_t cls = size / 64 - 1;
+        if (cls < VERSION_POOL_CLASSES && poolSizes[cls] < VERSION_POOL_LIMIT) {
+            Block* b = (Block*) p;
+            b->next = pools[cls];
+            pools[cls] = b;
+            ++poolSizes[cls];
+        } else
+            free(p);
+    }
+};
+
+#endif /* THREADARENA_H */
@@ -1,6 +1,64 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
+#include <string.h>
 #include "types.h"
+#include "ThreadArena.h"
+
+#ifndef WRITE_SUMMARY_BITS
+#define WRITE_SUMMARY_BITS 2048
+#endif
+
+/*
+ Bloom filter over the write set of a committing transaction: the tables written
+ and, for every version written (and the version it replaced), the key under
+ each index of its table. Predicates check it before scanning the undo buffer.
+ Until it is built (valid == false), every table and key may have been written.
+ */
+struct WriteSummary {
+    uint64_t tables;
+    uint64_t keys[WRITE_SUMMARY_BITS / 64];
+    bool valid;
+
+    WriteSummary() : valid(false) {
+    }
+
+    static FORCE_INLINE uint64_t mix(const MBase* tbl, size_t h) {
+        uint64_t x = (uint64_t) tbl ^ (h * 0x9E3779B97F4A7C15ULL);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    FORCE_INLINE void clear() {
+        tables = 0;
+        memset(keys, 0, sizeof (keys));
+    }
+
+    FORCE_INLINE void addTable(const MBase* tbl) {
+        tables |= 1ULL << (mix(tbl, 0) & 63);
+    }
+
+    //two bits per key, from either half of the mixed hash
+    FORCE_INLINE void addKey(const MBase* tbl, size_t h) {
+        uint64_t x = mix(tbl, h);
+        size_t b1 = x % WRITE_SUMMARY_BITS, b2 = (x >> 32) % WRITE_SUMMARY_BITS;
+        keys[b1 / 64] |= 1ULL << (b1 % 64);
+        keys[b2 / 64] |= 1ULL << (b2 % 64);
+    }
+
+    FORCE_INLINE bool mayHaveWritten(const MBase* tbl) const {
+        return !valid || (tables & (1ULL << (mix(tbl, 0) & 63)));
+    }
+
+    FORCE_INLINE bool mayHaveWritten(const MBase* tbl, size_t h) const {
+        if (!valid)
+            return true;
+        uint64_t x = mix(tbl, h);
+        size_t b1 = x % WRITE_SUMMARY_BITS, b2 = (x >> 32) % WRITE_SUMMARY_BITS;
+        return (keys[b1 / 64] & (1ULL << (b1 % 64))) && (keys[b2 / 64] & (1ULL << (b2 % 64)));
+    }
+};
 
 struct ALIGN Transaction {
     VBase* undoBufferHead;
@@ -13,7 +71,10 @@ struct ALIGN Transaction {
 
     uint8_t ptype;
     Transaction* failedBecauseOf;
+    WriteSummary writeSummary;
+    ThreadArena* arena; //of the thread running the transaction, set by begin
     Transaction() {
+        arena = nullptr;
         failedBecauseOf = nullptr;
         threadId = 0;
         commitTS = initCommitTS;
@@ -22,8 +83,21 @@ struct ALIGN Transaction {
         prevCommitted = nullptr;
     }
 
+    FORCE_INLINE void* allocPredicate(size_t size) {
+        return arena->allocPredicate(size);
+    }
+
+    FORCE_INLINE void releasePredicates() {
+        if (predicateHead != nullptr)
+            arena->releasePredicates();
+        predicateHead = nullptr;
+    }
+
     void reset() {
+        if (arena != nullptr)
+            releasePredicates();
         threadId = 0;
+        writeSummary.valid = false;
         commitTS = initCommitTS;
         undoBufferHead = nullptr;
         predicateHead = nullptr;
@@ -5,15 +5,29 @@
 #include "Transaction.h"
 #include "Predicate.h"
 #include "Version.h"
+#include "RetireList.h"
 #include "SpinLock.h"
 #include <type_traits>
 
 struct ALIGN TransactionManager {
+    /*
+     Start and commit timestamps come from one atomic counter, on a cache line
+     of its own (the struct is aligned). Every begin takes a fresh timestamp:
+     versions are visible if they committed before startTS and validation
+     checks those committed after it, so startTS must not equal any commitTS.
+     Commit timestamps are taken under commitLock, in the order of the commit list.
+     */
     std::atomic<timestamp> timestampGen;
-    SpinLock commitLock, counterLock;
+    SpinLock commitLock;
     std::atomic<Transaction *> committedXactsTail;
     std::atomic_flag isGCActive;
-    std::aligned_storage<sizeof (timestamp), 64 > activeXactStartTS[numThreads]; //64 bytes for cache alignment
+
+    struct ALIGN ActiveTS {
+        std::atomic<timestamp> ts;
+    };
+    ActiveTS activeXactStartTS[numThreads]; //start timestamp of the transaction running in each thread, -1 if none
+    RetireList retired[numThreads]; //versions and entries unlinked by each thread, see RetireList
+    ThreadArena arenas[numThreads]; //predicates and versions of the transactions of each thread, see ThreadArena
 
     TransactionManager() : timestampGen(0) {
         committedXactsTail = nullptr;
@@ -21,31 +35,63 @@ struct ALIGN TransactionManager {
     }
 
     FORCE_INLINE void begin(Transaction& xact, uint8_t tid) {
-        counterLock.lock();
         assert(xact.predicateHead == nullptr);
         assert(xact.undoBufferHead == nullptr);
-        auto ts = timestampGen++;
+        /*
+         A lower bound goes first, so that GC and reclamation do not miss the transaction between fetch_add
+         and publishing ts. Relaxed is enough: oldestActiveTS reads timestampGen before the slots, and if it
+         reads past this fetch_add, the fetch_add (a release) has made the store visible.
+         */
+        activeXactStartTS[tid].ts.store(timestampGen.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        auto ts = timestampGen.fetch_add(1);
         xact.startTS = ts;
-        counterLock.unlock();
-        *(timestamp*) (activeXactStartTS + tid) = ts;
+        xact.arena = arenas + tid;
+        activeXactStartTS[tid].ts.store(ts, std::memory_order_release);
+    }
+
+    //Start timestamp of the oldest active transaction, or the next timestamp if there is none
+
+    FORCE_INLINE timestamp oldestActiveTS() {
+        timestamp oldest = timestampGen;
+        for (uint8_t i = 0; i < numThreads; ++i) {
+            timestamp axstsi = activeXactStartTS[i].ts;
+            if (axstsi < oldest)
+                oldest = axstsi;
+        }
+        return oldest;
+    }
+
+    //Stamps what the thread retired since the last call, and frees what no active transaction can reach any more
+
+    FORCE_INLINE void reclaim(uint8_t tid) {
+        RetireList& rl = retired[tid];
+        if (rl.hasUnsealed())
+            rl.seal(timestampGen);
+        if (!rl.empty())
+            rl.reclaim(oldestActiveTS(), arenas[tid]);
     }
 
     FORCE_INLINE void rollback(Transaction& xact, uint8_t tid) {
-        *(timestamp*) (activeXactStartTS + tid) = -1;
         auto dv = xact.undoBufferHead;
         while (dv) {
             assert(TStoPTR(dv->xactid) == &xact);
-            dv->removeFromVersionChain();
+            dv->removeFromVersionChain(retired[tid]);
             dv = dv->nextInUndoBuffer;
         }
-        PRED* p;
-        while (xact.predicateHead) {
-            p = xact.predicateHead;
-            xact.predicateHead = xact.predicateHead->next;
-            free(p);
-        }
+        activeXactStartTS[tid].ts.store(-1, std::memory_order_release);
+        xact.releasePredicates();
         xact.undoBufferHead = nullptr;
-        xact.predicateHead = nullptr;
+        reclaim(tid);
+    }
+
+    //Summarizes the write set once, so that predicates of transactions validating against this one can skip its versions (see WriteSummary)
+
+    FORCE_INLINE void summarizeWrites(Transaction& xact) {
+        WriteSummary& s = xact.writeSummary;
+        s.clear();
+        for (VBase* dv = xact.undoBufferHead; dv != nullptr; dv = dv->nextInUndoBuffer)
+            dv->e->tbl->summarize(dv, s);
+        s.valid = true;
     }
 
     //Validate transaction by matching its predicates with versions of recently committed transactions 
@@ -69,9 +115,7 @@ struct ALIGN TransactionManager {
 
     FORCE_INLINE void commit(Transaction& xact, uint8_t tid) {
         auto dv = xact.undoBufferHead;
-        counterLock.lock();
         xact.commitTS = timestampGen.fetch_add(1);
-        counterLock.unlock();
         commitLock.unlock();
 
         while (dv) {
@@ -81,34 +125,28 @@ struct ALIGN TransactionManager {
             // BUt this has performance overhead as in almost all cases, it will lookup transaction un necessarily
             dv = dv->nextInUndoBuffer;
         }
-        *(timestamp*) (activeXactStartTS + tid) = -1;
+        activeXactStartTS[tid].ts.store(-1, std::memory_order_release);
         /* 
         SBJ: can set it only after setting commitTS of versions. 
         Otherwise some other transaction might go ahead and try to read 
         older version which was GCed
          */
-        PRED* p;
-        while (xact.predicateHead) {
-            p = xact.predicateHead;
-            xact.predicateHead = xact.predicateHead->next;
-            free(p);
-        }
-        garbageCollect();
+        xact.releasePredicates();
+        garbageCollect(tid);
+        reclaim(tid);
     }
 
     FORCE_INLINE bool validateAndCommit(Transaction& xact, uint8_t tid) {
         if (xact.undoBufferHead == nullptr) { //Read only transaction
-            PRED* p;
-            *(timestamp*) (activeXactStartTS + tid) = -1;
-            while (xact.predicateHead) {
-                p = xact.predicateHead;
-                xact.predicateHead = xact.predicateHead->next;
-                free(p);
-            }
+            activeXactStartTS[tid].ts.store(-1, std::memory_order_release);
+            xact.releasePredicates();
             xact.commitTS = xact.startTS;
             return true;
         }
 
+        //must be complete before the transaction enters the commit list
+        summarizeWrites(xact);
+
 
         Transaction *startXact = committedXactsTail, *endXact = nullptr, *currentXact;
 
@@ -159,14 +197,11 @@ struct ALIGN TransactionManager {
         } while (true);
     }
 
-    FORCE_INLINE void garbageCollect() {
+    //Unlinks the versions (and deleted entries) that no active transaction can read any more into the retire list of the thread
+
+    FORCE_INLINE void garbageCollect(uint8_t tid) {
         if (!isGCActive.test_and_set()) {
-            timestamp oldest = timestampGen;
-            for (uint8_t i = 0; i < numThreads; ++i) {
-                timestamp axstsi = *(timestamp*) (activeXactStartTS + i);
-                if (axstsi < oldest)
-                    oldest = axstsi;
-            }
+            timestamp oldest = oldestActiveTS();
             Transaction* xact = committedXactsTail, *xactOld = nullptr;
             while (xact != nullptr && xact->commitTS > oldest) {
                 xactOld = xact;
@@ -179,25 +214,12 @@ struct ALIGN TransactionManager {
                     Transaction *xact2 = xact;
                     committedXactsTail.compare_exchange_strong(xact2, nullptr);
                 }
-                VBase *v, *tmp;
-//                std::vector<VBase*> gcVersions;
+                //newest first, so that a version retired through a newer one is skipped when its own transaction comes
                 while (xact != nullptr) {
-                    v = xact->undoBufferHead;
-                    while (v != nullptr) {
-                        tmp = v->getVersionAfter(oldest);
-                        //                            while (tmp != nullptr && tmp->xactid != nonAccessibleMemory) { //using -1 to denote deleted versions
-                        //                                tmp->xactid = nonAccessibleMemory;
-                        //                                gcVersions.push_back(tmp);
-                        //                                tmp = tmp->oldV;
-                        //                            }
-                        v = v->nextInUndoBuffer;
-                    }
+                    for (VBase* v = xact->undoBufferHead; v != nullptr; v = v->nextInUndoBuffer)
+                        v->retireOlderVersions(retired[tid]);
                     xact = xact->prevCommitted;
                 }
-                //                    for (auto v : gcVersions) {
-                //                        memset(v, 0xab, sizeof (VBase));
-                //                        free(v);
-                //                    }
             }
 
             isGCActive.clear();
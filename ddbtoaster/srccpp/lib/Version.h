@@ -5,6 +5,7 @@
 #include <atomic>
 #include "types.h"
 #include "Transaction.h"
+#include "RetireList.h"
 #include "mmap/cmmap.hpp"
 template <typename T>
 struct ALIGN EntryMV;
@@ -15,8 +16,9 @@ struct VBase {
     VBase* nextInUndoBuffer;
     EBase* e; 
     col_type cols;
+    bool retired;
 
-    VBase(Transaction& x) : xactid(PTRtoTS(&x)), oldV(nullptr), nextInUndoBuffer(x.undoBufferHead), cols(-1) {
+    VBase(Transaction& x) : xactid(PTRtoTS(&x)), oldV(nullptr), nextInUndoBuffer(x.undoBufferHead), cols(-1), retired(false) {
        //Should not add to x.undoBuffer now. This version can still be deleted
     }
 
@@ -24,8 +26,8 @@ struct VBase {
         size_t ptr2 = (size_t)entry - sizeof(VBase);
         return (VBase *) (ptr2 & (~63));
     }
-    virtual VBase* getVersionAfter(timestamp oldest) = 0;
-    virtual void removeFromVersionChain() = 0;
+    virtual void retireOlderVersions(RetireList& rl) = 0;
+    virtual void removeFromVersionChain(RetireList& rl) = 0;
 };
 
 template <typename T>
@@ -43,68 +45,62 @@ template <typename T>
     //    Version(bool ignore, const Args&... args): obj(args...), entry(nullptr), xactid(mask), oldV(nullptr){
     //    }
 
-    VBase* getVersionAfter(timestamp oldest) override {
-        EntryMV<T>* e = (EntryMV<T>*)this->e;
-        Version<T>* dv = e->versionHead.load(); //dv != nullptr as there will always be one version
-        if (dv == nullptr) //Can happen if GC removes version but not the EntryMV
-            return nullptr;
-        VBase* dvOld = dv->oldV;
-        VBase *old = nullptr;
-        VBase *oldOld = dv;
-        while (isMarked(dvOld) || dv->xactid > oldest) {
-            if (!isMarked(dvOld)) {
-                if (oldOld != dv) {
-                    if (old == nullptr) {
-                        Version<T> * oldOldKV = (Version<T>*) oldOld;
-                        e->versionHead.compare_exchange_strong(oldOldKV, dv); //dont care abt result
-                    } else
-                        old->oldV.compare_exchange_strong(oldOld, dv); //dont care abt result
-                }
-                old = dv;
-                dv = (Version<T>*)dvOld;
-                assert(!dv || dv->e == this->e);
-                oldOld = dvOld;
-            } else {
-                dv = (Version<T>*)unmark(dvOld);
-            }
-            if (!dv)
-                break;
-            dvOld = dv->oldV.load();
+    static FORCE_INLINE Version<T>* alloc(Transaction& xact) {
+        return (Version<T>*) xact.arena->allocVersion(sizeof (Version<T>));
+    }
+
+    //For versions that were never published
+    static FORCE_INLINE void release(Version<T>* v, Transaction& xact) {
+        xact.arena->freeVersion(v, sizeof (Version<T>));
+    }
+
+    static void reclaim(void* p, ThreadArena& arena) {
+        Version<T>* v = (Version<T>*) p;
+        v->~Version<T>();
+        arena.freeVersion(v, sizeof (Version<T>));
+    }
+
+    /*
+     Called by GC for a version whose transaction committed before every active
+     transaction began: no transaction will read past it any more. Unlinks the
+     versions older than it and, if it deleted the entry and is still the latest
+     version, the entry. Versions retired through a newer version of the same
+     entry earlier in the GC pass are skipped.
+     */
+    void retireOlderVersions(RetireList& rl) override {
+        if (retired)
+            return;
+        //keep the links of the retired versions, transactions that skipped this one may still be walking them
+        VBase* dv = unmark(oldV.exchange(nullptr));
+        while (dv != nullptr && !dv->retired) {
+            dv->retired = true;
+            rl.retire(dv, reclaim);
+            dv = unmark(dv->oldV.load());
         }
-        if (oldOld != dv) {
-            if (old == nullptr) {
-                Version<T> * oldOldKV = (Version<T> *) oldOld;
-                e->versionHead.compare_exchange_strong(oldOldKV, (Version<T> *) dv); //dont care abt result
-            } else
-                old->oldV.compare_exchange_strong(oldOld, dv); //dont care abt result
+        EntryMV<T>* eptr = (EntryMV<T>*) e;
+        if (obj.isInvalid && eptr->versionHead == this) {
+            eptr->tbl->removeEntry(&obj, eptr);
+            retired = true;
+            rl.retire(eptr, EntryMV<T>::reclaim);
+            rl.retire(this, reclaim);
         }
-        if (!dv)
-            return nullptr;
-        if (old == nullptr) {  //latest version
-            if (dv->obj.isInvalid)
-                e->tbl->removeEntry(&dv->obj, e);
-            //Not really safe to delete dv here. But assuming that it takes a while after this return for dv to be deleted, it is safe
-            return dv->oldV;
-        } else if (old->xactid >= initCommitTS) //dv is the first committed version, cannot be deleted
-            return dv->oldV;
-        else
-            return dv;
     }
 
-    void removeFromVersionChain() override {
+    void removeFromVersionChain(RetireList& rl) override {
         EntryMV<T>* eptr = (EntryMV<T>*)e;
         assert(eptr->versionHead == this);
         eptr->tbl->undo(this);
         if (oldV == nullptr) { // Only version, created by INSERT
             eptr->tbl->removeEntry(&obj, eptr);
-            //            free(eptr);
-            //            free(this);
+            rl.retire(eptr, EntryMV<T>::reclaim);
+            rl.retire(this, reclaim);
         } else {
             Version<T>* dv = this;
             auto dvOld = (Version<T>*)oldV.load();
             if (!eptr->versionHead.compare_exchange_strong(dv, dvOld)) {
                 cerr << "DV being removed is not the first version" << endl;
-            }
+            } else
+                rl.retire(this, reclaim);
         }
     }
 
@@ -133,8 +129,15 @@ template <typename T>
     const T key;  //to avoid looking up versionHead to do key comparison for ordering. Assumes indexed columns same across all versions
     std::atomic<Version<T>*> versionHead;
     std::atomic<EntryMV<T>*> nxt;
+    EntryMV<T>* prv;
     void* backptrs[MAX_IDXES_PER_TBL];
-    EntryMV(MBase* tbl, const T& k, Version<T>* v) : EBase(tbl), key(k), versionHead(v), nxt(nullptr) {
+    EntryMV(MBase* tbl, const T& k, Version<T>* v) : EBase(tbl), key(k), versionHead(v), nxt(nullptr), prv(nullptr) {
+    }
+
+    static void reclaim(void* p, ThreadArena& arena) {
+        EntryMV<T>* e = (EntryMV<T>*) p;
+        e->~EntryMV<T>();
+        free(e);
     }
 
     //Returns the first version with cts > oldest AND not the only first committed version
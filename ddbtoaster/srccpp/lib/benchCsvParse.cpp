@@ -0,0 +1,170 @@
+/*
+ * Throughput of CSV framing and field parsing, comparing the strstr / atol /
+ * atof / strtok path with the scanners and parsers of parsers.hpp used by
+ * csv_adaptor.
+ *
+ *   make && g++ -O3 -std=c++11 benchCsvParse.cpp -I. -L. -ldbtoaster -lpthread -o benchCsvParse
+ *   ./benchCsvParse [lineitem.tbl] [passes]
+ *
+ * Without an input file, a TPC-H lineitem-shaped input is generated.
+ */
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "standard_adaptors.hpp"
+#include "parsers.hpp"
+#include "smhasher/MurmurHash2.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+using namespace dbtoaster::adaptors;
+
+static const char* LINEITEM_SCHEMA =
+    "long,long,long,long,double,double,double,double,"
+    "string,string,date,date,date,string,string,string";
+
+string generate_lineitem(size_t rows) {
+    static const char* instructs[] = { "DELIVER IN PERSON", "COLLECT COD", "NONE", "TAKE BACK RETURN" };
+    static const char* modes[] = { "REG AIR", "AIR", "RAIL", "SHIP", "TRUCK", "MAIL", "FOB" };
+    static const char* words[] = { "furiously", "carefully", "regular", "ideas", "deposits", "blithely", "final", "packages" };
+    default_random_engine r(42);
+    uniform_int_distribution<int> key(1, 6000000), part(1, 200000), supp(1, 10000);
+    uniform_int_distribution<int> qty(1, 50), cents(90000, 10494950), pct(0, 10);
+    uniform_int_distribution<int> year(1992, 1998), month(1, 12), day(1, 28), pick(0, 7);
+    ostringstream o;
+    char buf[64];
+    for (size_t i = 0; i < rows; ++i) {
+        o << key(r) << '|' << part(r) << '|' << supp(r) << '|' << (i % 7 + 1) << '|'
+          << qty(r) << '|';
+        int price = cents(r);
+        snprintf(buf, sizeof(buf), "%d.%02d|0.%02d|0.%02d|", price / 100, price % 100, pct(r), pct(r) % 9);
+        o << buf << "NAR"[pick(r) % 3] << '|' << "OF"[pick(r) % 2] << '|';
+        for (int d = 0; d < 3; ++d) {
+            snprintf(buf, sizeof(buf), "%04d-%02d-%02d|", year(r), month(r), day(r));
+            o << buf;
+        }
+        o << instructs[pick(r) % 4] << '|' << modes[pick(r) % 7] << '|'
+          << words[pick(r)] << ' ' << words[pick(r)] << ' ' << words[pick(r)] << '\n';
+    }
+    return o.str();
+}
+
+// The field parsing of csv_adaptor before parsers.hpp, writing into the
+// same tuple layout.
+bool legacy_interpret(char* data, const string& schema, const char* delim,
+                      tuple_arena& arena, const tuple_layout& layout) {
+    char* tuple = arena.allocate(layout);
+    tuple_writer fields(tuple);
+    size_t delimSize = strlen(delim);
+    char* field_start = data;
+    char* field_end;
+    for (size_t i = 0; i < schema.size(); ++i) {
+        field_end = strstr(field_start, delim);
+        if (field_end) *field_end = '\0';
+        switch (schema[i]) {
+            case 'l': fields.put<long>(atol(field_start)); break;
+            case 'f': fields.put<DOUBLE_TYPE>(atof(field_start)); break;
+            case 'h': fields.put<int>(static_cast<int>(MurmurHash2(field_start, strlen(field_start), 0))); break;
+            case 'd': {
+                char* y = strtok(field_start, "-");
+                char* m = y ? strtok(NULL, "-") : NULL;
+                char* d = m ? strtok(NULL, "-") : NULL;
+                if (!d) return false;
+                fields.put<date>(atoi(y) * 10000 + atoi(m) * 100 + atoi(d));
+                break;
+            }
+            case 's': arena.own(fields.put<STRING_TYPE>(field_start)); break;
+            default: return false;
+        }
+        if (field_end) field_start = field_end + delimSize;
+        else if (i + 1 < schema.size()) return false;
+    }
+    return true;
+}
+
+typedef chrono::high_resolution_clock bench_clock;
+
+double mb_per_s(size_t bytes, size_t passes, bench_clock::duration t) {
+    double s = chrono::duration_cast<chrono::duration<double> >(t).count();
+    return (double)bytes * passes / (1024.0 * 1024.0) / s;
+}
+
+int main(int argc, char** argv) {
+    string input;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        ifstream f(argv[1]);
+        stringstream ss;
+        ss << f.rdbuf();
+        input = ss.str();
+    } else {
+        input = generate_lineitem(500000);
+    }
+    size_t passes = argc > 2 ? atoi(argv[2]) : 5;
+    size_t bytes = input.size();
+    cout << "input: " << bytes / (1024 * 1024) << "MB, " << passes << " passes" << endl;
+
+    // room for the terminator and the over-read of aligned vector loads
+    vector<char> buffer(bytes + 64);
+    size_t frames_old = 0, frames_new = 0;
+    bench_clock::duration t_frame_old(0), t_frame_new(0);
+
+    for (size_t p = 0; p < passes; ++p) {
+        memcpy(&buffer[0], input.data(), bytes + 1);
+        bench_clock::time_point t0 = bench_clock::now();
+        char* start = &buffer[0];
+        char* pos;
+        while ((pos = strstr(start, "\n")) != nullptr) { *pos = '\0'; start = pos + 1; ++frames_old; }
+        t_frame_old += bench_clock::now() - t0;
+
+        memcpy(&buffer[0], input.data(), bytes + 1);
+        t0 = bench_clock::now();
+        start = &buffer[0];
+        while (*(pos = parsers::find_delimiter(start, "\n", 1)) != '\0') { *pos = '\0'; start = pos + 1; ++frames_new; }
+        t_frame_new += bench_clock::now() - t0;
+    }
+
+    // Frame once; the field parsers then run over the framed copy.
+    vector<size_t> lines;
+    for (size_t i = 0, s = 0; i < bytes; ++i) {
+        if (input[i] == '\n') { lines.push_back(s); s = i + 1; }
+    }
+    string framed = input;
+    for (size_t i = 0; i < bytes; ++i) if (framed[i] == '\n') framed[i] = '\0';
+
+    pair<string, string> params[] = { make_pair("delimiter", "|"), make_pair("schema", LINEITEM_SCHEMA) };
+    csv_adaptor adaptor(0, 2, params);
+    size_t valid_old = 0, valid_new = 0;
+    bench_clock::duration t_parse_old(0), t_parse_new(0);
+
+    for (size_t p = 0; p < passes; ++p) {
+        {
+            tuple_arena arena;
+            memcpy(&buffer[0], framed.data(), bytes + 1);
+            bench_clock::time_point t0 = bench_clock::now();
+            for (size_t i = 0; i < lines.size(); ++i)
+                valid_old += legacy_interpret(&buffer[lines[i]], adaptor.schema, "|", arena, adaptor.layout);
+            t_parse_old += bench_clock::now() - t0;
+        }
+        {
+            memcpy(&buffer[0], framed.data(), bytes + 1);
+            bench_clock::time_point t0 = bench_clock::now();
+            for (size_t i = 0; i < lines.size(); ++i)
+                valid_new += std::get<0>(adaptor.interpret_event(&buffer[lines[i]]));
+            t_parse_new += bench_clock::now() - t0;
+            adaptor.take_arena();
+        }
+    }
+
+    cout << "framing  strstr:        " << mb_per_s(bytes, passes, t_frame_old) << " MB/s (" << frames_old / passes << " frames)" << endl;
+    cout << "framing  find_delimiter: " << mb_per_s(bytes, passes, t_frame_new) << " MB/s (" << frames_new / passes << " frames)" << endl;
+    cout << "parsing  strstr/atof:   " << mb_per_s(bytes, passes, t_parse_old) << " MB/s (" << valid_old / passes << " tuples)" << endl;
+    cout << "parsing  csv_adaptor:   " << mb_per_s(bytes, passes, t_parse_new) << " MB/s (" << valid_new / passes << " tuples)" << endl;
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Per-operation cost of getValueOrDefault and addOrDelOnZero on maps keyed
+ * by a single integer drawn from a dense domain, with a chained, an
+ * open-addressing and a direct-addressed primary index.
+ *
+ *   make && g++ -O3 -std=c++11 benchDenseIndex.cpp -I. -L. -ldbtoaster -lpthread -o benchDenseIndex
+ *   ./benchDenseIndex [keys] [operations]
+ */
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct entry {
+    long A; long __av;
+
+    entry() {}
+    entry(long a, long v) : A(a), __av(v) {}
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e.A); return h; }
+    FORCE_INLINE static bool equals(const entry& x, const entry& y) { return x.A == y.A; }
+    FORCE_INLINE static long key(const entry& e) { return e.A; }
+};
+
+typedef MultiHashMap<entry, long, PrimaryHashIndex<entry, key_idxfn> > chained_map;
+typedef MultiHashMap<entry, long, SwissPrimaryHashIndex<entry, key_idxfn> > swiss_map;
+typedef MultiHashMap<entry, long, DenseArrayIndex<entry, key_idxfn> > dense_map;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+// Shortest of 'trials' runs of f, per operation.
+template<typename F>
+double ns_per_op(size_t ops, size_t trials, F f) {
+    double best = 0;
+    for (size_t t = 0; t < trials; ++t) {
+        bench_clock::time_point t0 = bench_clock::now();
+        f();
+        double ns = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count() / ops;
+        if (t == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+template<typename MAP>
+void run(const char* name, const vector<long>& keys, size_t n, size_t trials) {
+    MAP m;
+    entry e;
+    for (size_t i = 0; i < n; ++i) {
+        e.A = i + 1;
+        m.addOrDelOnZero(e, 1L);
+    }
+    long sum = 0;
+    double get = ns_per_op(keys.size(), trials, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            e.A = keys[i];
+            sum += m.getValueOrDefault(e);
+        }
+    });
+    // every other update removes the entry and the next one inserts it again
+    double update = ns_per_op(keys.size(), trials, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            e.A = keys[i];
+            m.addOrDelOnZero(e, (i & 1) ? 1L : -1L);
+        }
+    });
+    // keeps the lookups from being optimized away
+    cout << name << "get: " << get << " ns/op, addOrDelOnZero: " << update << " ns/op"
+         << " (checksum " << sum + (long) m.count() << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 100000;
+    size_t ops = argc > 2 ? atol(argv[2]) : 10000000;
+    size_t trials = 5;
+
+    // keys 1..n, each picked twice in a row by the updates
+    vector<long> keys(ops);
+    mt19937_64 rng(42);
+    for (size_t i = 0; i < ops; i += 2) keys[i] = 1 + rng() % n;
+    for (size_t i = 1; i < ops; i += 2) keys[i] = keys[i - 1];
+
+    cout << n << " keys, " << ops << " operations" << endl;
+    run<chained_map>("PrimaryHashIndex:      ", keys, n, trials);
+    run<swiss_map>("SwissPrimaryHashIndex: ", keys, n, trials);
+    run<dense_map>("DenseArrayIndex:       ", keys, n, trials);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Per-event cost of calling a no-op trigger from ProgramBase::process_event,
+ * comparing the map / shared_ptr / std::function path that it used to take
+ * with the dispatch table, for triggers registered through std::bind and
+ * through call_member.
+ *
+ *   make && g++ -O3 -std=c++11 benchDispatch.cpp -I. -L. -ldbtoaster -lpthread -o benchDispatch
+ *   ./benchDispatch [events] [relations]
+ */
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "program_base.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct data_t {
+    long count;
+
+    data_t() : count(0) {}
+
+    void on_insert(const event_args_t& ea) { ++count; }
+    void on_delete(const event_args_t& ea) { --count; }
+};
+
+class BenchProgram : public ProgramBase {
+  public:
+    data_t data;
+
+    BenchProgram(size_t relations, bool use_bind) {
+        for (size_t r = 0; r < relations; ++r) {
+            string name = "R" + to_string(r);
+            add_relation(name);
+            if (use_bind) {
+                add_trigger(name, insert_tuple, std::bind(&data_t::on_insert, &data, std::placeholders::_1));
+                add_trigger(name, delete_tuple, std::bind(&data_t::on_delete, &data, std::placeholders::_1));
+            } else {
+                add_trigger(name, insert_tuple, &ProgramBase::call_member<data_t, &data_t::on_insert>, &data);
+                add_trigger(name, delete_tuple, &ProgramBase::call_member<data_t, &data_t::on_delete>, &data);
+            }
+        }
+    }
+
+    void init() {}
+    snapshot_t take_snapshot() { return snapshot_t(); }
+
+    void run_table(const vector<event_t>& events) {
+        for (size_t i = 0; i < events.size(); ++i) process_event(events[i], false);
+    }
+
+    // The body of process_event before the dispatch table.
+    void run_legacy(const vector<event_t>& events) {
+        for (size_t i = 0; i < events.size(); ++i) {
+            const event_t& evt = events[i];
+            map<relation_id_t, relation_ptr_t>::iterator r_it = relations_by_id.find(evt.id);
+            if (r_it != relations_by_id.end() && !r_it->second->is_table &&
+                r_it->second->trigger[evt.type]) {
+                std::shared_ptr<trigger_t> trig = r_it->second->trigger[evt.type];
+                trig->log(r_it->second->name, evt);
+                (trig->fn)(evt.data);
+            }
+        }
+    }
+};
+
+typedef chrono::high_resolution_clock bench_clock;
+
+double ns_per_event(size_t events, bench_clock::duration t) {
+    return chrono::duration_cast<chrono::duration<double, nano> >(t).count() / events;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 20000000;
+    size_t relations = argc > 2 ? atol(argv[2]) : 8;
+
+    vector<event_t> events;
+    events.reserve(n);
+    srand(42);
+    for (size_t i = 0; i < n; ++i) {
+        event_type t = (rand() % 4 == 0) ? delete_tuple : insert_tuple;
+        events.push_back(event_t(t, rand() % relations, i, nullptr));
+    }
+
+    BenchProgram bound(relations, true);
+    BenchProgram direct(relations, false);
+
+    bench_clock::time_point t0 = bench_clock::now();
+    bound.run_legacy(events);
+    bench_clock::duration t_legacy = bench_clock::now() - t0;
+
+    t0 = bench_clock::now();
+    bound.run_table(events);
+    bench_clock::duration t_bound = bench_clock::now() - t0;
+
+    t0 = bench_clock::now();
+    direct.run_table(events);
+    bench_clock::duration t_direct = bench_clock::now() - t0;
+
+    cout << n << " events over " << relations << " relations" << endl;
+    cout << "map + std::function:        " << ns_per_event(n, t_legacy) << " ns/event" << endl;
+    cout << "dispatch table, std::bind:   " << ns_per_event(n, t_bound) << " ns/event" << endl;
+    cout << "dispatch table, call_member: " << ns_per_event(n, t_direct) << " ns/event" << endl;
+    // keeps the triggers from being optimized away
+    cout << "checksum: " << bound.data.count << " " << direct.data.count << endl;
+    return 0;
+}
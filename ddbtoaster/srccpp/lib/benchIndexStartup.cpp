@@ -0,0 +1,103 @@
+/*
+ * Startup time and resident set size of a concurrent table with a cuckoo
+ * primary and a cuckoo secondary index, as the TPC-C stock and order-line
+ * tables have, when it is constructed and when it is loaded with the rows of
+ * the given number of warehouses. The table is sized from the row count as
+ * the generated code sizes it from the *TblSize constants, or with "grow",
+ * starts at the default size and grows while loading.
+ *
+ *   make && g++ -O3 -std=c++11 benchIndexStartup.cpp -I. -L. -ldbtoaster -lpthread -o benchIndexStartup
+ *   for w in 1 2 4 8 16 32 64; do ./benchIndexStartup $w; done
+ *   ./benchIndexStartup [warehouses] [rows per warehouse] [grow]
+ *
+ * Needs libcuckoo on the include path, as the concurrent runtime does.
+ */
+#include <cstdlib>
+#include <bitset>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+
+#define SC_GENERATED 1
+#define CONCURRENT 1
+#include "mmap/mmap.hpp"
+#include "TransactionManager.h"
+
+using namespace std;
+
+TransactionManager xactManager;
+TransactionManager& Transaction::tm(xactManager);
+
+struct row {
+    long _1; long _2; bool isInvalid;
+
+    row() : _1(0), _2(0), isInvalid(false) {}
+    row(long a, long b) : _1(a), _2(b), isInvalid(false) {}
+
+    FORCE_INLINE row* copy() const {
+        row* ptr = (row*) malloc(sizeof(row));
+        new(ptr) row(_1, _2);
+        return ptr;
+    }
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const row& e) { return e._1 * 0x9e3779b97f4a7c15UL; }
+    FORCE_INLINE static char cmp(const row& x, const row& y) { return x._1 != y._1; }
+};
+
+struct group_idxfn {
+    FORCE_INLINE static size_t hash(const row& e) { return e._2 * 0x9e3779b97f4a7c15UL; }
+    FORCE_INLINE static char cmp(const row& x, const row& y) { return x._2 != y._2; }
+};
+
+typedef MultiHashMapMV<row, CuckooIndex<row, key_idxfn>, ConcurrentCuckooSecondaryIndex<row, group_idxfn> > bench_table;
+
+size_t rssKB() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+typedef chrono::high_resolution_clock bench_clock;
+
+double msSince(bench_clock::time_point t0) {
+    return chrono::duration_cast<chrono::duration<double, milli> >(bench_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    size_t warehouses = argc > 1 ? atol(argv[1]) : 1;
+    size_t perWarehouse = argc > 2 ? atol(argv[2]) : 100000;
+    bool grow = argc > 3 && strcmp(argv[3], "grow") == 0;
+    size_t n = warehouses * perWarehouse;
+
+    size_t rss0 = rssKB();
+    bench_clock::time_point t0 = bench_clock::now();
+    bench_table* table = aligned_malloc(bench_table);
+    if (grow)
+        new(table) bench_table();
+    else
+        new(table) bench_table(n);
+    double construct = msSince(t0);
+    size_t rss1 = rssKB();
+
+    // ten rows per group of the secondary index, like the order lines of an order
+    t0 = bench_clock::now();
+    Transaction xact;
+    xactManager.begin(xact, 0);
+    for (size_t k = 0; k < n; ++k)
+        table->insert_nocheck(row(k, k / 10), xact);
+    xactManager.commit(xact, 0);
+    double load = msSince(t0);
+    size_t rss2 = rssKB();
+
+    cout << "warehouses, rows, construct ms, RSS KB, load ms, RSS KB" << (grow ? " (grow)" : "") << endl;
+    cout << warehouses << ", " << n << ", " << construct << ", " << rss1 - rss0 << ", " << load << ", " << rss2 - rss0 << endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Resident set size of the concurrent runtime while transactions update,
+ * delete and re-insert the rows of a fixed-size table, so that every
+ * transaction leaves behind an old version and one in eight an entry. With
+ * reclamation the RSS stays flat once the retire lists reach steady state.
+ *
+ *   make && g++ -O3 -std=c++11 benchReclamation.cpp -I. -L. -ldbtoaster -lpthread -o benchReclamation
+ *   ./benchReclamation [transactions per thread] [threads]
+ *
+ * Needs libcuckoo on the include path, as the concurrent runtime does. Threads
+ * spin on commitLock: run with at most one thread per core.
+ */
+#include <cstdlib>
+#include <bitset>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#define SC_GENERATED 1
+#define CONCURRENT 1
+#include "mmap/mmap.hpp"
+#include "TransactionManager.h"
+
+using namespace std;
+
+TransactionManager xactManager;
+TransactionManager& Transaction::tm(xactManager);
+
+struct row {
+    long _1; long _2; bool isInvalid;
+
+    row() : _1(0), _2(0), isInvalid(false) {}
+    row(long a, long b) : _1(a), _2(b), isInvalid(false) {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const row& e) { return e._1; }
+    FORCE_INLINE static char cmp(const row& x, const row& y) { return x._1 != y._1; }
+};
+
+const size_t TABLE_SIZE = 1024;
+typedef MultiHashMapMV<row, ConcurrentArrayIndex<row, key_idxfn, TABLE_SIZE> > bench_table;
+
+bench_table* table;
+
+// Thread t owns the keys equal to t modulo the number of threads. Every
+// transaction updates one of them, except that every fourth one deletes the
+// row and the next one inserts it back.
+void worker(uint8_t tid, size_t threads, size_t n, size_t* aborts) {
+    Transaction xact;
+    size_t keys = TABLE_SIZE / threads;
+    for (size_t i = 0; i < n; ++i) {
+        long k = tid + threads * ((i / 2) % keys);
+        xact.reset();
+        xactManager.begin(xact, tid);
+        OperationReturnStatus st;
+        row key(k, 0);
+        row* r = table->index[0]->getForUpdate(&key, st, xact);
+        if (st == OP_SUCCESS) {
+            if (i % 8 == 0)
+                table->del(r);
+            else
+                r->_2 += 1;
+        } else if (st == NO_KEY) {
+            st = table->insert_nocheck(row(k, 0), xact);
+        }
+        if (st != OP_SUCCESS) {
+            xactManager.rollback(xact, tid);
+            ++*aborts;
+        } else if (!xactManager.validateAndCommit(xact, tid))
+            ++*aborts;
+    }
+}
+
+size_t rssKB() {
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+typedef chrono::high_resolution_clock bench_clock;
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 2000000;
+    size_t threads = argc > 2 ? min<size_t>(atol(argv[2]), numThreads) : 1;
+    size_t steps = 10;
+
+    table = aligned_malloc(bench_table);
+    new(table) bench_table();
+    Transaction t0;
+    xactManager.begin(t0, 0);
+    for (size_t k = 0; k < TABLE_SIZE; ++k)
+        table->insert_nocheck(row(k, 0), t0);
+    xactManager.commit(t0, 0);
+    memset(xactManager.activeXactStartTS, 0xff, sizeof(xactManager.activeXactStartTS[0]) * numThreads);
+
+    cout << threads << " threads, transactions, RSS KB, ns per transaction" << endl;
+    vector<size_t> aborts(threads, 0);
+    for (size_t s = 1; s <= steps; ++s) {
+        vector<thread> workers;
+        bench_clock::time_point t0 = bench_clock::now();
+        for (size_t t = 0; t < threads; ++t)
+            workers.push_back(thread(worker, (uint8_t) t, threads, n / steps, &aborts[t]));
+        for (size_t t = 0; t < threads; ++t)
+            workers[t].join();
+        double ns = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count();
+        cout << s * (n / steps) * threads << ", " << rssKB() << ", " << ns / (threads * (n / steps)) << endl;
+    }
+    size_t aborted = 0;
+    for (size_t t = 0; t < threads; ++t)
+        aborted += aborts[t];
+    cout << "aborted: " << aborted << endl;
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Latency of single inserts into a MultiHashMap with a primary and a
+ * secondary hash index while the map grows, reporting the worst case,
+ * the 99.99th percentile and the total time.
+ *
+ *   make && g++ -O3 -std=c++11 benchResize.cpp -I. -L. -ldbtoaster -lpthread -o benchResize
+ *   ./benchResize [entries]
+ *
+ * Add -DINCREMENTAL_RESIZE_MIN_SIZE=0x7fffffffffff to the compiler flags to
+ * measure indices that rehash all of their buckets at once.
+ */
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct entry {
+    long A; long B; long __av; entry* nxt; entry* prv;
+
+    entry() : nxt(nullptr), prv(nullptr) {}
+    entry(long a, long v) : A(a), B(a >> 4), __av(v), nxt(nullptr), prv(nullptr) {}
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e.A); return h; }
+    FORCE_INLINE static bool equals(const entry& x, const entry& y) { return x.A == y.A; }
+};
+
+struct group_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e.B); return h; }
+    FORCE_INLINE static bool equals(const entry& x, const entry& y) { return x.B == y.B; }
+};
+
+typedef MultiHashMap<entry, long, PrimaryHashIndex<entry, key_idxfn>,
+                     SecondaryHashIndex<entry, group_idxfn> > bench_map;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 20000000;
+
+    vector<long> keys(n);
+    mt19937_64 rng(42);
+    for (size_t i = 0; i < n; ++i) keys[i] = rng();
+
+    vector<float> latency(n);
+    bench_map m;
+    entry e;
+    bench_clock::time_point start = bench_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        bench_clock::time_point t0 = bench_clock::now();
+        e.A = keys[i];
+        e.B = keys[i] >> 4;
+        m.addOrDelOnZero(e, 1L);
+        latency[i] = chrono::duration_cast<chrono::duration<float, micro> >(bench_clock::now() - t0).count();
+    }
+    double total = chrono::duration_cast<chrono::duration<double, milli> >(bench_clock::now() - start).count();
+
+    sort(latency.begin(), latency.end());
+    cout << n << " inserts, INCREMENTAL_RESIZE_MIN_SIZE = " << INCREMENTAL_RESIZE_MIN_SIZE << endl;
+    cout << "total:    " << total << " ms" << endl;
+    cout << "p99.99:   " << latency[n - 1 - n / 10000] << " us" << endl;
+    cout << "max:      " << latency[n - 1] << " us" << endl;
+    // keeps the inserts from being optimized away
+    cout << "checksum: " << m.count() << endl;
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Per-operation cost of get and of insert + delete on the MultiHashMap of
+ * SC-generated code (mmap2.hpp), comparing virtual calls through index[]
+ * with calls through the static index types.
+ *
+ *   make && g++ -O3 -std=c++11 benchStaticIndex.cpp -I. -L. -ldbtoaster -lpthread -o benchStaticIndex
+ *   ./benchStaticIndex [entries] [operations]
+ */
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define SC_GENERATED
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct entry {
+    long _1; long _2; long _3;
+    entry* prv; entry* nxt; void* backPtrs[3];
+
+    entry() : _1(0), _2(0), _3(0), prv(nullptr), nxt(nullptr) {}
+    entry(long a, long b, long c) : _1(a), _2(b), _3(c), prv(nullptr), nxt(nullptr) {}
+
+    FORCE_INLINE entry* copy() const {
+        entry* ptr = (entry*) malloc(sizeof(entry));
+        new(ptr) entry(_1, _2, _3);
+        return ptr;
+    }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e._1); return h; }
+    FORCE_INLINE static char cmp(const entry& x, const entry& y) { return x._1 != y._1; }
+};
+
+struct group_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e._2); return h; }
+    FORCE_INLINE static char cmp(const entry& x, const entry& y) { return x._2 != y._2; }
+};
+
+typedef HashIndex<entry, char, key_idxfn, true> key_index;
+typedef HashIndex<entry, char, group_idxfn, false> group_index;
+typedef MultiHashMap<entry, char, key_index, group_index> bench_map;
+
+// The bodies of insert_nocheck and del before the static dispatch.
+void insert_virtual(bench_map& m, const entry& e) {
+    entry* cur = m.copyIntoPool(e);
+    for (size_t i = 0; i < 2; ++i) m.index[i]->add(cur);
+}
+
+void del_virtual(bench_map& m, entry* e) {
+    for (size_t i = 0; i < 2; ++i) m.index[i]->del(e);
+    m.pool.del(e);
+}
+
+typedef chrono::high_resolution_clock bench_clock;
+
+// Shortest of 'trials' runs of f, per operation.
+template<typename F>
+double ns_per_op(size_t ops, size_t trials, F f) {
+    double best = 0;
+    for (size_t t = 0; t < trials; ++t) {
+        bench_clock::time_point t0 = bench_clock::now();
+        f();
+        double ns = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count() / ops;
+        if (t == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 100000;
+    size_t ops = argc > 2 ? atol(argv[2]) : 10000000;
+    size_t trials = 5;
+
+    bench_map m;
+    for (size_t i = 0; i < n; ++i) m.insert_nocheck(entry(i, i / 16, i & 7));
+
+    vector<long> keys(ops);
+    mt19937_64 rng(42);
+    for (size_t i = 0; i < ops; ++i) keys[i] = rng() % n;
+
+    long sum_virtual = 0, sum_static = 0;
+    entry key;
+    double get_virtual = ns_per_op(ops, trials, [&]() {
+        for (size_t i = 0; i < ops; ++i) {
+            key._1 = keys[i];
+            sum_virtual += m.get(key, 0)->_3;
+        }
+    });
+    double get_static = ns_per_op(ops, trials, [&]() {
+        for (size_t i = 0; i < ops; ++i) {
+            key._1 = keys[i];
+            sum_static += m.get<0>(key)->_3;
+        }
+    });
+
+    // inserts a new entry and deletes it again, keeping the map at n entries
+    double churn_virtual = ns_per_op(ops, trials, [&]() {
+        for (size_t i = 0; i < ops; ++i) {
+            entry e(n + i, keys[i] / 16, 1);
+            insert_virtual(m, e);
+            del_virtual(m, m.get(e, 0));
+        }
+    });
+    double churn_static = ns_per_op(ops, trials, [&]() {
+        for (size_t i = 0; i < ops; ++i) {
+            entry e(n + i, keys[i] / 16, 1);
+            m.insert_nocheck(e);
+            m.del(m.get<0>(e));
+        }
+    });
+
+    cout << n << " entries, " << ops << " operations" << endl;
+    cout << "get, virtual:             " << get_virtual << " ns/op" << endl;
+    cout << "get, static:              " << get_static << " ns/op" << endl;
+    cout << "insert + delete, virtual: " << churn_virtual << " ns/op" << endl;
+    cout << "insert + delete, static:  " << churn_static << " ns/op" << endl;
+    // keeps the lookups from being optimized away
+    cout << "checksum: " << sum_virtual << " " << sum_static << " " << m.count() << endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Per-operation cost of getValueOrDefault and addOrDelOnZero on a map with a
+ * handful of entries, as an aggregate view with few groups, stored in a
+ * MultiHashMap, a FlatHashMap and a TinyMap, and the cost of clearing such a
+ * map and filling it again.
+ *
+ *   make && g++ -O3 -std=c++11 benchTinyMap.cpp -I. -L. -ldbtoaster -lpthread -o benchTinyMap
+ *   ./benchTinyMap [groups] [operations]
+ */
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct entry {
+    long A; long B; long __av;
+
+    entry() {}
+    entry(long a, long b, long v) : A(a), B(b), __av(v) {}
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e.A); hash_combine(h, e.B); return h; }
+    FORCE_INLINE static bool equals(const entry& x, const entry& y) { return x.A == y.A && x.B == y.B; }
+};
+
+typedef MultiHashMap<entry, long, PrimaryHashIndex<entry, key_idxfn> > multi_map;
+typedef FlatHashMap<entry, long, key_idxfn> flat_map;
+typedef TinyMap<entry, long, key_idxfn, multi_map> tiny_map;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+// Shortest of 'trials' runs of f, per operation.
+template<typename F>
+double ns_per_op(size_t ops, size_t trials, F f) {
+    double best = 0;
+    for (size_t t = 0; t < trials; ++t) {
+        bench_clock::time_point t0 = bench_clock::now();
+        f();
+        double ns = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count() / ops;
+        if (t == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+template<typename MAP>
+void run(const char* name, const vector<long>& keys, size_t trials) {
+    MAP m;
+    entry e;
+    e.B = 1;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        e.A = keys[i];
+        m.addOrDelOnZero(e, 1L);
+    }
+    long sum = 0;
+    double get = ns_per_op(keys.size(), trials, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            e.A = keys[i];
+            sum += m.getValueOrDefault(e);
+        }
+    });
+    // the groups stay in the map: every other update takes back the one before
+    double update = ns_per_op(keys.size(), trials, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            e.A = keys[i];
+            m.addOrDelOnZero(e, (i & 1) ? -1L : 1L);
+        }
+    });
+    // a map cleared and filled again for every batch of 'per_map' updates, 
+    // as a temporary view of a trigger
+    size_t per_map = 16;
+    MAP temp;
+    double refill = ns_per_op(keys.size(), trials, [&]() {
+        for (size_t i = 0; i + per_map <= keys.size(); i += per_map) {
+            temp.clear();
+            for (size_t j = i; j < i + per_map; ++j) {
+                e.A = keys[j];
+                temp.addOrDelOnZero(e, 1L);
+            }
+            sum += temp.count();
+        }
+    });
+    // keeps the lookups from being optimized away
+    cout << name << "get: " << get << " ns/op, addOrDelOnZero: " << update << " ns/op, "
+         << "clear + refill: " << refill << " ns/update (checksum " << sum + (long) m.count() << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+    size_t groups = argc > 1 ? atol(argv[1]) : 4;
+    size_t ops = argc > 2 ? atol(argv[2]) : 10000000;
+    size_t trials = 5;
+
+    // groups 0..groups-1, each picked twice in a row
+    vector<long> keys(ops);
+    mt19937_64 rng(42);
+    for (size_t i = 0; i < ops; i += 2) keys[i] = rng() % groups;
+    for (size_t i = 1; i < ops; i += 2) keys[i] = keys[i - 1];
+
+    cout << groups << " groups, " << ops << " operations" << endl;
+    run<multi_map>("MultiHashMap: ", keys, trials);
+    run<flat_map>("FlatHashMap:  ", keys, trials);
+    run<tiny_map>("TinyMap:      ", keys, trials);
+    return 0;
+}
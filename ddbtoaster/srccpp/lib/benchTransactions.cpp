@@ -0,0 +1,97 @@
+/*
+ * Throughput of TransactionManager::begin and validateAndCommit against the
+ * number of threads, for read-only transactions and for transactions with a
+ * one-version write set and no predicates, as the concurrent TPC-C driver
+ * runs them: no table work, only the timestamps and the commit list.
+ *
+ *   make && g++ -O3 -std=c++11 -DNUMTHREADS=8 benchTransactions.cpp -I. -L. -ldbtoaster -lpthread -o benchTransactions
+ *   ./benchTransactions [transactions per thread] [max threads]
+ *
+ * Needs libcuckoo on the include path, as the concurrent runtime does. Threads
+ * spin on commitLock: run with at most one thread per core.
+ */
+#include <cstdlib>
+#include <bitset>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define SC_GENERATED 1
+#define CONCURRENT 1
+#include "mmap/mmap.hpp"
+#include "TransactionManager.h"
+
+using namespace std;
+
+TransactionManager xactManager;
+TransactionManager& Transaction::tm(xactManager);
+
+// A table and versions that are never read: commit only summarizes the
+// versions and stamps them with the commit timestamp.
+struct DummyTable : public MBase {
+    void removeEntry(void* o, void* emv) {}
+    void undo(VBase* v) {}
+    void summarize(VBase* v, WriteSummary& s) { s.addTable(this); }
+};
+
+DummyTable table;
+EBase entry(&table);
+
+struct DummyVersion : public VBase {
+    DummyVersion(Transaction& x) : VBase(x) { e = &entry; }
+    void retireOlderVersions(RetireList& rl) {}
+    void removeFromVersionChain(RetireList& rl) {}
+};
+
+typedef aligned_storage<sizeof(DummyVersion), alignof(DummyVersion)>::type VersionSlot;
+
+// Transactions of a thread are reused round robin. A committed transaction
+// is unlinked by garbageCollect() long before it comes around again.
+const size_t XACTS_PER_THREAD = 4096;
+
+void worker(uint8_t tid, size_t n, bool readOnly, vector<Transaction>* xacts, vector<VersionSlot>* versions) {
+    for (size_t i = 0; i < n; ++i) {
+        Transaction& x = (*xacts)[i % XACTS_PER_THREAD];
+        x.reset();
+        xactManager.begin(x, tid);
+        if (!readOnly) {
+            x.undoBufferHead = new (&(*versions)[i % XACTS_PER_THREAD]) DummyVersion(x);
+        }
+        xactManager.validateAndCommit(x, tid);
+    }
+}
+
+typedef chrono::high_resolution_clock bench_clock;
+
+// Transactions per microsecond with 'threads' threads running 'n' each.
+double run(size_t threads, size_t n, bool readOnly) {
+    xactManager.committedXactsTail = nullptr;
+    memset(xactManager.activeXactStartTS, 0xff, sizeof(xactManager.activeXactStartTS[0]) * numThreads);
+    vector<vector<Transaction> > xacts(threads, vector<Transaction>(XACTS_PER_THREAD));
+    vector<vector<VersionSlot> > versions(threads, vector<VersionSlot>(XACTS_PER_THREAD));
+
+    vector<thread> workers;
+    bench_clock::time_point t0 = bench_clock::now();
+    for (size_t t = 0; t < threads; ++t)
+        workers.push_back(thread(worker, (uint8_t) t, n, readOnly, &xacts[t], &versions[t]));
+    for (size_t t = 0; t < threads; ++t)
+        workers[t].join();
+    double us = chrono::duration_cast<chrono::duration<double, micro> >(bench_clock::now() - t0).count();
+    return threads * n / us;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t maxThreads = argc > 2 ? min<size_t>(atol(argv[2]), numThreads) : numThreads;
+
+    cout << "threads, read-only Mtx/s, update Mtx/s (" << thread::hardware_concurrency() << " hardware threads)" << endl;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double ro = run(threads, n, true);
+        double rw = run(threads, n, false);
+        cout << threads << ", " << ro << ", " << rw << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Cost of validating a transaction's get predicates against recently
+ * committed transactions that wrote other keys of the same table, with the
+ * write summaries of the committed transactions and with full scans of
+ * their undo buffers (summaries not built). A round validates the transaction
+ * against all committed ones.
+ *
+ *   make && g++ -O3 -std=c++11 benchValidation.cpp -I. -L. -ldbtoaster -lpthread -o benchValidation
+ *   ./benchValidation [predicates] [committed transactions] [versions per transaction]
+ *
+ * Needs libcuckoo on the include path, as the concurrent runtime does.
+ */
+#include <cstdlib>
+#include <bitset>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#define SC_GENERATED 1
+#define CONCURRENT 1
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+#include "TransactionManager.h"
+
+using namespace std;
+
+TransactionManager xactManager;
+TransactionManager& Transaction::tm(xactManager);
+
+struct row {
+    long _1; long _2; bool isInvalid;
+
+    row() : _1(0), _2(0), isInvalid(false) {}
+    row(long a, long b) : _1(a), _2(b), isInvalid(false) {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const row& e) { size_t h = 0; hash_combine(h, e._1); return h; }
+    FORCE_INLINE static char cmp(const row& x, const row& y) { return x._1 != y._1; }
+};
+
+const size_t TABLE_SIZE = 1024;
+typedef MultiHashMapMV<row, ConcurrentArrayIndex<row, key_idxfn, TABLE_SIZE> > bench_table;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+int main(int argc, char** argv) {
+    size_t preds = argc > 1 ? atol(argv[1]) : 20;
+    size_t committers = argc > 2 ? atol(argv[2]) : 8;
+    size_t versions = argc > 3 ? atol(argv[3]) : 30;
+    size_t rounds = 100000;
+
+    bench_table* table = aligned_malloc(bench_table);
+    new(table) bench_table();
+    MBase* tbl = (MBase*) table->index[0]->mmapmv;
+
+    // committed transactions write keys 0.. and the validating one reads keys from -1 down
+    vector<Transaction> committed(committers);
+    long next = 0;
+    for (size_t c = 0; c < committers; ++c) {
+        for (size_t v = 0; v < versions; ++v, ++next) {
+            Version<row>* dv = aligned_malloc(Version<row>);
+            new(dv) Version<row>(row(next, 0), committed[c]);
+            EntryMV<row>* e = aligned_malloc(EntryMV<row>);
+            new(e) EntryMV<row>(tbl, dv->obj, dv);
+            dv->e = e;
+            committed[c].undoBufferHead = dv;
+        }
+    }
+    Transaction xact;
+    for (size_t p = 0; p < preds; ++p) {
+        GetPred<row, key_idxfn>* pred = (GetPred<row, key_idxfn>*) malloc(sizeof(GetPred<row, key_idxfn>));
+        new(pred) GetPred<row, key_idxfn>(row(-1 - (long) p, 0), xact.predicateHead, tbl, col_type(-1));
+        xact.predicateHead = pred;
+    }
+
+    size_t valid = 0;
+    double ns[2];
+    for (int summarized = 0; summarized < 2; ++summarized) {
+        for (size_t c = 0; c < committers; ++c) {
+            if (summarized) xactManager.summarizeWrites(committed[c]);
+            else committed[c].writeSummary.valid = false;
+        }
+        bench_clock::time_point t0 = bench_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t c = 0; c < committers; ++c)
+                valid += xactManager.validate(xact, &committed[c], 0);
+        }
+        ns[summarized] = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count() / rounds;
+    }
+
+    cout << preds << " predicates, " << committers << " committed transactions of " << versions << " versions" << endl;
+    cout << "scan undo buffers: " << ns[0] << " ns per validation round" << endl;
+    cout << "write summaries:   " << ns[1] << " ns per validation round" << endl;
+    // keeps the validations from being optimized away
+    cout << "checksum: " << valid << endl;
+    return 0;
+}
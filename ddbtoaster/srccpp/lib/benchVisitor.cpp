@@ -0,0 +1,117 @@
+/*
+ * Per-element cost of foreach and slice on the MultiHashMap of SC-generated
+ * code (mmap2.hpp), comparing a lambda passed through the virtual Index
+ * methods, which wrap it in a std::function, with the templated visitors.
+ *
+ *   make && g++ -O3 -std=c++11 benchVisitor.cpp -I. -L. -ldbtoaster -lpthread -o benchVisitor
+ *   ./benchVisitor [entries] [group size]
+ */
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#define SC_GENERATED
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct entry {
+    long _1; long _2; long _3;
+    entry* prv; entry* nxt; void* backPtrs[3];
+
+    entry() : _1(0), _2(0), _3(0), prv(nullptr), nxt(nullptr) {}
+    entry(long a, long b, long c) : _1(a), _2(b), _3(c), prv(nullptr), nxt(nullptr) {}
+
+    FORCE_INLINE entry* copy() const {
+        entry* ptr = (entry*) malloc(sizeof(entry));
+        new(ptr) entry(_1, _2, _3);
+        return ptr;
+    }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {}
+};
+
+struct key_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e._1); return h; }
+    FORCE_INLINE static char cmp(const entry& x, const entry& y) { return x._1 != y._1; }
+};
+
+struct group_idxfn {
+    FORCE_INLINE static size_t hash(const entry& e) { size_t h = 0; hash_combine(h, e._2); return h; }
+    FORCE_INLINE static char cmp(const entry& x, const entry& y) { return x._2 != y._2; }
+};
+
+typedef HashIndex<entry, char, key_idxfn, true> key_index;
+typedef HashIndex<entry, char, group_idxfn, false> group_index;
+typedef MultiHashMap<entry, char, key_index, group_index> bench_map;
+
+typedef chrono::high_resolution_clock bench_clock;
+
+// Shortest of 'trials' runs of f, per element visited.
+template<typename F>
+double ns_per_element(size_t elements, size_t trials, F f) {
+    double best = 0;
+    for (size_t t = 0; t < trials; ++t) {
+        bench_clock::time_point t0 = bench_clock::now();
+        f();
+        double ns = chrono::duration_cast<chrono::duration<double, nano> >(bench_clock::now() - t0).count() / elements;
+        if (t == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 10000;
+    size_t group = argc > 2 ? atol(argv[2]) : 100;
+    size_t rounds = max<size_t>(1, 10000000 / n);
+    size_t trials = 5;
+
+    bench_map m;
+    for (size_t i = 0; i < n; ++i) {
+        entry e(i, i / group, i & 7);
+        m.insert_nocheck(e);
+    }
+    Index<entry, char>* primary = m.index[0];
+    Index<entry, char>* secondary = m.index[1];
+    size_t groups = (n + group - 1) / group;
+    long sum_virtual = 0, sum_template = 0;
+    entry key;
+
+    double foreach_virtual = ns_per_element(n * rounds, trials, [&]() {
+        for (size_t r = 0; r < rounds; ++r)
+            primary->foreach([&](entry* e) { sum_virtual += e->_3; });
+    });
+    double foreach_template = ns_per_element(n * rounds, trials, [&]() {
+        for (size_t r = 0; r < rounds; ++r)
+            m.foreach([&](entry* e) { sum_template += e->_3; });
+    });
+    double slice_virtual = ns_per_element(n * rounds, trials, [&]() {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t g = 0; g < groups; ++g) {
+                key._2 = g;
+                secondary->slice(&key, [&](entry* e) { sum_virtual += e->_3; });
+            }
+        }
+    });
+    double slice_template = ns_per_element(n * rounds, trials, [&]() {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t g = 0; g < groups; ++g) {
+                key._2 = g;
+                m.slice<1>(key, [&](entry* e) { sum_template += e->_3; });
+            }
+        }
+    });
+
+    cout << n << " entries, slices of " << group << endl;
+    cout << "foreach, virtual + std::function: " << foreach_virtual << " ns/element" << endl;
+    cout << "foreach, templated visitor:       " << foreach_template << " ns/element" << endl;
+    cout << "slice, virtual + std::function:   " << slice_virtual << " ns/element" << endl;
+    cout << "slice, templated visitor:         " << slice_template << " ns/element" << endl;
+    // keeps the visitors from being optimized away
+    cout << "checksum: " << sum_virtual << " " << sum_template << endl;
+    return 0;
+}
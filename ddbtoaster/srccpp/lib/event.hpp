@@ -27,8 +27,21 @@ enum event_type {
     system_ready_event 
 };
 
+const int num_event_types = system_ready_event + 1;
+
 typedef int relation_id_t;
-typedef std::vector<std::shared_ptr<void>> event_args_t;
+
+/**
+ * Events refer to their tuple as a flat record of typed fields laid out in
+ * schema order (see tuple.hpp). The memory is owned by the event producer.
+ */
+typedef const char* event_args_t;
+
+struct tuple_layout;
+
+// The data of a batch_update event points to an event_batch_t, which holds
+// the tuples of the batch column by column (see tuple.hpp).
+struct event_batch_t;
 
 extern std::string event_name[];
 
@@ -43,13 +56,14 @@ struct event_t
     relation_id_t id;
     unsigned int event_order;
     event_args_t data;
+    const tuple_layout* layout;     // describes 'data', if known
 
     event_t(const event_t& other)
-    : type(other.type), id(other.id), event_order(other.event_order), data(other.data)
+    : type(other.type), id(other.id), event_order(other.event_order), data(other.data), layout(other.layout)
     {}
 
-    event_t(event_type t, relation_id_t i, unsigned int ord, event_args_t& d)
-    : type(t), id(i), event_order(ord), data(d)
+    event_t(event_type t, relation_id_t i, unsigned int ord, event_args_t d, const tuple_layout* l = nullptr)
+    : type(t), id(i), event_order(ord), data(d), layout(l)
     {}
 };
 
@@ -27,4 +27,9 @@
 //global operators
 #ifdef USE_POOL
 CharPool<> PString::pool_;
-#endif //USE_POOL
\ No newline at end of file
+#endif //USE_POOL
+
+std::ostream &operator<<(std::ostream &o, PString const &str) {
+    if (str.c_str() != nullptr) o << str.c_str();
+    return o;
+}
@@ -5,41 +5,116 @@ namespace dbtoaster {
 
 /**
  * Executes the program by launching the virtual method 'process_streams()'.
- * @param async If 'true' the execution is performed in a separate thread.
+ * @param async If 'true' the execution is performed in a separate thread
+ *              and this function returns immediately. wait() must then
+ *              be called before the program is destroyed.
  */
 void IProgram::run( bool async ) {
 	if( async )
 	{
-		std::packaged_task<void()> pt([this]() {
-			this->run(false);
+		// Mark the program as running before the thread is launched, so that
+		// snapshot requests issued right after run() returns are served by
+		// the executing thread.
+		start_running();
+		worker = std::thread([this]() {
+			process_streams();
+			stop_running();
 		});
-		pt();
 	}
 	else
 	{
 		start_running();
 		process_streams();
-		finished = true;
 		stop_running();
 	}
 }
 
+/**
+ * Blocks until a program started in asynchronous mode has finished.
+ */
+void IProgram::wait() {
+	if( worker.joinable() )
+		worker.join();
+}
+
 /**
  * Obtains a snapshot of the results of the program. If the program is
  * currently running in asynchronous mode, it will make sure that the
- * snapshot is consistent.
- * @return A snapshot of the 'TLQ_T' data-structure representing 
+ * snapshot is consistent and taken after this call was made.
+ * @return A snapshot of the 'TLQ_T' data-structure representing
  *         the results of the program.
  */
 IProgram::snapshot_t IProgram::get_snapshot()
 {
-	if( !is_finished() )
+	if( is_running() )
 	{
-		request_snapshot();
-		return wait_for_snapshot();
+		IProgram::snapshot_t result = wait_for_snapshot(request_snapshot());
+		if( result )
+			return result;
 	}
-	else
-		return take_snapshot();
+	return take_snapshot();
+}
+
+/**
+ * Returns the most recently published snapshot without waiting for the
+ * program to take a new one. The result may be stale, or empty if no
+ * snapshot has been published yet. Safe to call at high frequency.
+ * @return The last snapshot published by the executing thread.
+ */
+IProgram::snapshot_t IProgram::get_latest_snapshot()
+{
+	return std::atomic_load(&snapshot);
+}
+
+/**
+ * Obtains the entries of the top-level views that changed after the given
+ * epoch. If the program is running, the changes are collected by the
+ * executing thread between events.
+ * @param epoch The 'epoch' of the previous result, or 0.
+ * @return The changes, and the epoch to pass to the next call.
+ */
+IProgram::changes_t IProgram::get_changes_since(unsigned long epoch)
+{
+	change_request_t request;
+	request.since = epoch;
+	std::future<changes_t> result = request.result.get_future();
+	{
+		std::lock_guard<std::mutex> lock(change_lock);
+		if( !serving_changes )
+			return collect_changes(epoch);
+		change_requests.push_back(&request);
+		change_requests_pending.store(true, std::memory_order_release);
+	}
+	return result.get();
+}
+
+/**
+ * Collects the changes after epoch 'since' under a new epoch. Must be called
+ * with 'change_lock' held.
+ */
+IProgram::changes_t IProgram::collect_changes(unsigned long since)
+{
+	changes_t changes;
+	changes.epoch = ++change_epoch;
+	changes.data = take_changes(since, changes.epoch, changes.full);
+	return changes;
+}
+
+/**
+ * Serves the pending requests for changes. Gets executed only between
+ * the processing of events, like process_snapshot().
+ */
+void IProgram::process_change_requests()
+{
+	if( !change_requests_pending.load(std::memory_order_relaxed) )
+		return;
+
+	std::lock_guard<std::mutex> lock(change_lock);
+	for( size_t i = 0; i < change_requests.size(); i++ )
+		change_requests[i]->result.set_value(
+			collect_changes(change_requests[i]->since));
+	change_requests.clear();
+	change_requests_pending.store(false, std::memory_order_relaxed);
 }
 
 /**
@@ -54,26 +129,35 @@ IProgram::snapshot_t IProgram::get_snapshot()
 void IProgram::process_stream_event(const event_t& ev)
 {
 	process_snapshot();
-}  
+	process_change_requests();
+}
 
 /**
  * Signal the beginning of the execution of the program.
  */
 void IProgram::start_running()
 {
-	running_mtx.lock();
-	running = true;
-	running_mtx.unlock();
+	finished.store(false, std::memory_order_release);
+	running.store(true, std::memory_order_release);
+	std::lock_guard<std::mutex> lock(change_lock);
+	serving_changes = true;
 }
 /**
  * Signal the end of the execution of the program.
  */
 void IProgram::stop_running()
 {
-	running_mtx.lock();
 	process_snapshot();
-	running = false;
-	running_mtx.unlock();
+	{
+		// Requests queued from here on are served by their callers.
+		std::lock_guard<std::mutex> lock(change_lock);
+		serving_changes = false;
+	}
+	change_requests_pending.store(true, std::memory_order_relaxed);
+	process_change_requests();
+	finished.store(true, std::memory_order_release);
+	running.store(false, std::memory_order_release);
+	wake_snapshot_waiters();
 }
 
 /**
@@ -83,62 +167,75 @@ void IProgram::stop_running()
  */
 void IProgram::process_snapshot()
 {
-	if( snapshot_request )
+	unsigned long requested =
+		snapshot_request_epoch.load(std::memory_order_relaxed);
+	if( requested != snapshot_epoch.load(std::memory_order_relaxed) )
 	{
-		assert( snapshot_ready == false );
-		snapshot = take_snapshot();
-		snapshot_request = false;
-
-		{
-			std::lock_guard<std::mutex> lock(snapshot_ready_mtx);
-			snapshot_ready=true;
-		}
-		snapshot_ready_cond.notify_all();
+		std::atomic_store(&snapshot, take_snapshot());
+		snapshot_epoch.store(requested, std::memory_order_release);
+		wake_snapshot_waiters();
 	}
 }
 
 /*
  * Function for recording a request for a snapshot.
+ * @return The epoch the requested snapshot will be published under.
  */
-void IProgram::request_snapshot()
+unsigned long IProgram::request_snapshot()
 {
-	assert( snapshot_request == false );
-	assert( snapshot_ready == true );
-	if( snapshot_request || !snapshot_ready )   return;
+	return snapshot_request_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+}
 
-	running_mtx.lock();
-	if( is_running() )
+/**
+ * Function for waiting for a previously recorded snapshot request to
+ * complete.
+ * @param epoch The epoch returned by request_snapshot().
+ * @return The snapshot taken as a response of a previously recorded
+ *         request, or an empty pointer if the program stopped running
+ *         before serving it.
+ */
+IProgram::snapshot_t IProgram::wait_for_snapshot(unsigned long epoch)
+{
+	auto served = [this, epoch]() {
+		return snapshot_epoch.load(std::memory_order_acquire) >= epoch
+			|| !is_running();
+	};
+	bool ready = served();
+	for( int i = 0; !ready && i < SNAPSHOT_WAIT_SPIN_TRIES; ++i )
 	{
-		snapshot_ready = false;
-		snapshot_request = true;
+		std::this_thread::yield();
+		ready = served();
 	}
-	else
+	if( !ready )
 	{
-		snapshot = take_snapshot();
+		// The waiter is counted before 'served' is checked again, and the
+		// executing thread publishes before it checks for waiters, so one of
+		// the two sees the other.
+		std::unique_lock<std::mutex> lock(snapshot_lock);
+		snapshot_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while( !served() )
+			snapshot_published.wait(lock);
+		snapshot_waiters.fetch_sub(1, std::memory_order_relaxed);
 	}
-	running_mtx.unlock();
+	// The executing thread may have served the request on its way out;
+	// otherwise the caller takes the snapshot itself.
+	if( snapshot_epoch.load(std::memory_order_acquire) < epoch )
+		return IProgram::snapshot_t();
+	return std::atomic_load(&snapshot);
 }
 
 /**
- * Function for waiting for a previously recorded snapshot request to
- * complete.
- * @return The snapshot taken as a response of a previously recorded 
- *         request.
+ * Wakes the readers sleeping in wait_for_snapshot(), if any.
  */
-IProgram::snapshot_t IProgram::wait_for_snapshot()
+void IProgram::wake_snapshot_waiters()
 {
-	if( !snapshot_ready )
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if( snapshot_waiters.load(std::memory_order_relaxed) > 0 )
 	{
-		std::unique_lock<std::mutex> lock(snapshot_ready_mtx);
-		while(!snapshot_ready)
-		{
-			snapshot_ready_cond.wait(lock);
-		}
+		std::lock_guard<std::mutex> lock(snapshot_lock);
+		snapshot_published.notify_all();
 	}
-
-	IProgram::snapshot_t result = snapshot;
-	snapshot = snapshot_t();
-	return result;
 }
 
 }
@@ -9,13 +9,20 @@
 #define DBTOASTER_IPROGRAM_H
 
 #include <thread>
-#include <condition_variable>
-#include <mutex>
-#include <future>
+#include <exception>
+#include <atomic>
+#include <memory>
 #include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include <cassert>
 #include "serialization.hpp"
 
+// Tries of a reader waiting for a snapshot before it sleeps.
+#define SNAPSHOT_WAIT_SPIN_TRIES 64
+
 namespace dbtoaster {
 
 struct event_t;
@@ -34,13 +41,35 @@ class IProgram {
 public:
     typedef std::shared_ptr<tlq_t> snapshot_t;
 
+    /**
+     * The results of the program that changed between two epochs.
+     */
+    struct changes_t {
+        // The epoch these changes lead up to, to be passed to the next call
+        // of get_changes_since().
+        unsigned long epoch;
+        // If 'true', 'data' holds the complete results rather than changes.
+        bool full;
+        // The changed entries of the top-level views with their current
+        // values; entries that were removed have a zero value.
+        snapshot_t data;
+    };
+
     IProgram() :
         running(false)
         , finished(false)
-        , snapshot_ready(true)
-        , snapshot_request(false)
+        , snapshot_request_epoch(0)
+        , snapshot_epoch(0)
+        , snapshot_waiters(0)
+        , change_requests_pending(false)
+        , serving_changes(false)
+        , change_epoch(0)
     {}
+    // The derived program, whose maps the worker thread uses, is already
+    // destroyed here, so a program run asynchronously must be wait()ed for.
     virtual ~IProgram() {
+        if( worker.joinable() )
+            std::terminate();
     }
 
     /**
@@ -51,10 +80,17 @@ public:
 
     /**
      * Executes the program by launching the virtual method 'process_streams()'.
-     * @param async If 'true' the execution is performed in a separate thread.
+     * @param async If 'true' the execution is performed in a separate thread
+     *              and this function returns immediately. wait() must then
+     *              be called before the program is destroyed.
      */
     void run( bool async = false );
 
+    /**
+     * Blocks until a program started in asynchronous mode has finished.
+     */
+    void wait();
+
     /**
      * This function provides a way for testing whether the program has 
      * finished or not when run in asynchronous mode.
@@ -62,18 +98,37 @@ public:
      */
     bool is_finished()
     {
-        return finished;
+        return finished.load(std::memory_order_acquire);
     }
 
     /**
      * Obtains a snapshot of the results of the program. If the program is
      * currently running in asynchronous mode, it will make sure that the
-     * snapshot is consistent.
+     * snapshot is consistent and taken after this call was made.
      * @return A snapshot of the 'TLQ_T' data-structure representing 
      *         the results of the program.
      */
     snapshot_t get_snapshot();
 
+    /**
+     * Returns the most recently published snapshot without waiting for the
+     * program to take a new one. The result may be stale, or empty if no
+     * snapshot has been published yet. Safe to call at high frequency.
+     * @return The last snapshot published by the executing thread.
+     */
+    snapshot_t get_latest_snapshot();
+
+    /**
+     * Obtains the entries of the top-level views that changed after the 
+     * given epoch. Changes are only tracked from the first call on, which 
+     * should pass epoch 0 and receives the complete results. If the program
+     * is running in asynchronous mode, the changes are collected by the 
+     * executing thread between events.
+     * @param epoch The 'epoch' of the previous result, or 0.
+     * @return The changes, and the epoch to pass to the next call.
+     */
+    changes_t get_changes_since(unsigned long epoch);
+
 protected:
     /**
      * This should get overridden by a function that reads stream events and
@@ -99,11 +154,24 @@ protected:
      */
     virtual snapshot_t take_snapshot() = 0;
 
+    /**
+     * Virtual function that collects the entries of the top-level views
+     * that changed after epoch 'since' and closes epoch 'epoch'. Programs
+     * that do not track changes return a complete snapshot.
+     * @param full Set to 'true' if the result holds the complete results.
+     * @return The collected changes.
+     */
+    virtual snapshot_t take_changes(unsigned long /*since*/, unsigned long /*epoch*/,
+                                    bool& full) {
+        full = true;
+        return take_snapshot();
+    }
+
     /**
      * Tests the running state of the program.
      * @return 'true' if the program is currently being executed.
      */
-    bool is_running(){ return running; }
+    bool is_running(){ return running.load(std::memory_order_acquire); }
 
     /**
      * Signal the beginning of the execution of the program.
@@ -123,28 +191,59 @@ protected:
 
     /*
      * Function for recording a request for a snapshot.
+     * @return The epoch the requested snapshot will be published under.
      */
-    void request_snapshot();
+    unsigned long request_snapshot();
 
     /**
      * Function for waiting for a previously recorded snapshot request to
      * complete.
+     * @param epoch The epoch returned by request_snapshot().
      * @return The snapshot taken as a response of a previously recorded 
-     *         request.
+     *         request, or an empty pointer if the program stopped running
+     *         before serving it.
      */
-    snapshot_t wait_for_snapshot();
-
-private:
-    bool running;
-    bool finished;
-    std::mutex running_mtx;
+    snapshot_t wait_for_snapshot(unsigned long epoch);
 
-    std::condition_variable snapshot_ready_cond;
-    std::mutex snapshot_ready_mtx;
-    bool snapshot_ready;
+    /**
+     * Serves the pending requests for changes. Gets executed only between
+     * the processing of events, like process_snapshot().
+     */
+    void process_change_requests();
 
-    bool snapshot_request;
+private:
+    std::atomic<bool> running;
+    std::atomic<bool> finished;
+    std::thread worker;
+
+    // Snapshot requests are counted by readers; the executing thread serves
+    // them between events and publishes the result together with the epoch
+    // of the latest request it has seen. The executing thread only pays for
+    // a relaxed load per event. Readers that keep waiting for a snapshot
+    // sleep on 'snapshot_published', and are woken when one is published or
+    // the program stops.
+    std::atomic<unsigned long> snapshot_request_epoch;
+    std::atomic<unsigned long> snapshot_epoch;
     snapshot_t snapshot;
+    std::mutex snapshot_lock;
+    std::condition_variable snapshot_published;
+    std::atomic<int> snapshot_waiters;
+
+    void wake_snapshot_waiters();
+
+    // Requests for changes are queued for the executing thread while it is
+    // running, and served by the caller otherwise.
+    struct change_request_t {
+        unsigned long since;
+        std::promise<changes_t> result;
+    };
+    std::atomic<bool> change_requests_pending;
+    std::mutex change_lock;
+    bool serving_changes;
+    unsigned long change_epoch;
+    std::vector<change_request_t*> change_requests;
+
+    changes_t collect_changes(unsigned long since);
 };
 }
 
@@ -25,11 +25,14 @@ namespace dbtoaster {
       public:
 
         void process_streams() {
+            tuple_layout layout("ll");
+            tuple_arena arena;
             for (long i = 1; i <= 10; ++i) {
-                event_args_t ev_args;
-                ev_args.push_back(std::shared_ptr<long>(new long(i)));
-                ev_args.push_back(std::shared_ptr<long>(new long(i + 10)));
-                event_t ev(insert_tuple, get_relation_id("S"), 0, ev_args);
+                char* ev_args = arena.allocate(layout);
+                tuple_writer fields(ev_args);
+                fields.put<long>(i);
+                fields.put<long>(i + 10);
+                event_t ev(insert_tuple, get_relation_id("S"), 0, ev_args, &layout);
 
                 process_stream_event(ev);
             }
@@ -89,6 +92,7 @@ int main(int argc, char* argv[]) {
         snap = p.get_snapshot();
         DBT_SERIALIZATION_NVP_OF_PTR(cout, snap);
     }
+    p.wait();
 
     // if(!no_output) cout << "Printing final result:" << endl;
     if (!no_output) {
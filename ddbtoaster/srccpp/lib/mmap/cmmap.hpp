@@ -25,6 +25,15 @@ std::vector<void*> tempMem;
 #define DEFAULT_HEAP_SIZE 16
 #endif
 
+//Smallest initial capacity of the cuckoo tables, which grow on demand
+#ifndef CUCKOO_INITIAL_SIZE
+#define CUCKOO_INITIAL_SIZE 1024
+#endif
+
+FORCE_INLINE size_t cuckooInitialSize(size_t s) {
+    return s > CUCKOO_INITIAL_SIZE ? s : CUCKOO_INITIAL_SIZE;
+}
+
 FORCE_INLINE void clearTempMem() {
     for (auto ptr : tempMem)
         free(ptr);
@@ -94,13 +103,15 @@ struct CuckooIndex : public IndexMV<T> {
     typedef HE_<T, IDX_FN> HE;
     cuckoohash_map<T*, EntryMV<T>*, HE, HE, std::allocator<std::pair<T, EntryMV<T>*>>> index;
 
+    //foreach list, doubly linked so that removed entries are unlinked at once and can be reclaimed
     std::atomic<EntryMV<T>*> dataHead;
+    SpinLock listLock;
 
-    CuckooIndex(int s = 0) : index((1 << 25)) { //Constructor argument is ignored
+    CuckooIndex(size_t s = 0) : index(cuckooInitialSize(s)) {
         dataHead = nullptr;
     }
 
-    CuckooIndex(void* ptr, int s = 0) : index(1 << 25) { //Constructor argument is ignored
+    CuckooIndex(void* ptr, size_t s = 0) : index(cuckooInitialSize(s)) {
         dataHead = nullptr;
     }
 
@@ -163,15 +174,19 @@ struct CuckooIndex : public IndexMV<T> {
 
     FORCE_INLINE OperationReturnStatus add(Version<T>* newv) override {
         auto idxId = IndexMV<T>::idxId;
-        T* keyC = &newv->obj;
         EntryMV<T> *emv = (EntryMV<T>*) newv->e;
+        //the key lives as long as the entry, unlike the first version
+        T* keyC = (T*) &emv->key;
         if (index.insert(keyC, emv)) {
             if (idxId == 0) {
+                listLock.lock();
                 EntryMV<T>* dh = dataHead;
                 emv->nxt = dh;
-                while (!dataHead.compare_exchange_weak(dh, emv)) {
-                    emv->nxt = dh;
-                }
+                emv->prv = nullptr;
+                if (dh)
+                    dh->prv = emv;
+                dataHead = emv;
+                listLock.unlock();
             }
             return OP_SUCCESS;
         } else {
@@ -204,11 +219,19 @@ struct CuckooIndex : public IndexMV<T> {
     //    }
 
     FORCE_INLINE void removeEntry(T* obj, EntryMV<T>* emv) override {
-        EntryMV<T>* nxt = emv->nxt;
-        while (!emv->nxt.compare_exchange_strong(nxt, mark(nxt))); //removing from foreach list
-        //SBJ: TODO: Mark other fields as well???
+        if (IndexMV<T>::idxId == 0) {
+            //emv->nxt is left as is for foreach calls standing on emv
+            listLock.lock();
+            EntryMV<T>* nxt = emv->nxt, *prv = emv->prv;
+            if (prv)
+                prv->nxt = nxt;
+            else
+                dataHead = nxt;
+            if (nxt)
+                nxt->prv = prv;
+            listLock.unlock();
+        }
         index.erase(obj);
-        //SBJ: TODO:  free the memory for key store in cuckoo
     }
 
     FORCE_INLINE void undo(Version<T>* v) override {
@@ -248,7 +271,7 @@ struct CuckooIndex : public IndexMV<T> {
 
     FORCE_INLINE OperationReturnStatus foreach(FuncType f, Transaction& xact) override {
         EntryMV<T>* cur = dataHead;
-        ForEachPred<T>* pred = (ForEachPred<T>*) malloc(sizeof(ForEachPred<T>));
+        ForEachPred<T>* pred = (ForEachPred<T>*) xact.allocPredicate(sizeof(ForEachPred<T>));
         new(pred) ForEachPred<T>(xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
         xact.predicateHead = pred;
         while (cur) {
@@ -281,7 +304,7 @@ struct CuckooIndex : public IndexMV<T> {
             Version<T>* v = result->getCorrectVersion(xact);
             if (v->obj.isInvalid)
                 return nullptr;
-            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) malloc(sizeof(GetPred<T, IDX_FN>));
+            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) xact.allocPredicate(sizeof(GetPred<T, IDX_FN>));
             new(pred) GetPred<T, IDX_FN>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
             return &v->obj;
@@ -309,7 +332,7 @@ struct CuckooIndex : public IndexMV<T> {
                 return nullptr;
             }
 
-            Version<T> *newv = aligned_malloc(Version<T>);
+            Version<T> *newv = Version<T>::alloc(xact);
             new(newv) Version<T>(resV, xact);
 
             if (!result->versionHead.compare_exchange_strong(resV, newv)) {
@@ -318,12 +341,12 @@ struct CuckooIndex : public IndexMV<T> {
                     xact.failedBecauseOf = otherXact;
                 }
                 st = WW_VALUE;
-                free(newv);
+                Version<T>::release(newv, xact);
                 return nullptr;
             }
 
 
-            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) malloc(sizeof(GetPred<T, IDX_FN>));
+            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) xact.allocPredicate(sizeof(GetPred<T, IDX_FN>));
             new(pred) GetPred<T, IDX_FN>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
             xact.undoBufferHead = newv;
@@ -335,8 +358,10 @@ struct CuckooIndex : public IndexMV<T> {
         }
     }
 
+    //Every entry has its own key, so the pool size bounds the number of keys too
+
     FORCE_INLINE void prepareSize(size_t arrayS, size_t poolS) override {
-        index.reserve(arrayS);
+        index.reserve(arrayS > poolS ? arrayS : poolS);
     }
 
     //Assumption : primary key columns don't change. So do nothing
@@ -430,6 +455,7 @@ struct CuckooIndex : public IndexMV<T> {
 
 template <typename T, typename IDX_FN, size_t size>
 struct ConcurrentArrayIndex : public IndexMV<T> {
+    typedef HE_<T, IDX_FN> HE;
 
     template<typename A>
     struct ALIGN CacheAtomic {
@@ -498,7 +524,8 @@ struct ConcurrentArrayIndex : public IndexMV<T> {
     }
 
     void removeEntry(T* obj, EntryMV<T>* emv) override {
-
+        AlignedEntry* ca = (AlignedEntry*) emv->backptrs[IndexMV<T>::idxId];
+        ca->elem.compare_exchange_strong(emv, nullptr); //already cleared by del, unless an insert is rolled back
     }
 
     void undo(Version<T>* v) override {
@@ -547,7 +574,7 @@ struct ConcurrentArrayIndex : public IndexMV<T> {
         if (!v)
             return nullptr;
         else {
-            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) malloc(sizeof(GetPred<T, IDX_FN>));
+            GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) xact.allocPredicate(sizeof(GetPred<T, IDX_FN>));
             new(pred) GetPred<T, IDX_FN>(key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
             return &v->obj;
@@ -575,7 +602,7 @@ struct ConcurrentArrayIndex : public IndexMV<T> {
             s = WW_VALUE;
             return nullptr;
         }
-        Version<T>* newv = aligned_malloc(Version<T>);
+        Version<T>* newv = Version<T>::alloc(xact);
         new (newv) Version<T>(resV, xact);
         if (!e->versionHead.compare_exchange_strong(resV, newv)) {
             if (resV->xactid > initCommitTS) {
@@ -583,10 +610,10 @@ struct ConcurrentArrayIndex : public IndexMV<T> {
                 xact.failedBecauseOf = otherXact;
             }
             s = WW_VALUE;
-            free(newv);
+            Version<T>::release(newv, xact);
             return nullptr;
         }
-        GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) malloc(sizeof(GetPred<T, IDX_FN>));
+        GetPred<T, IDX_FN>* pred = (GetPred<T, IDX_FN>*) xact.allocPredicate(sizeof(GetPred<T, IDX_FN>));
         new(pred) GetPred<T, IDX_FN>(key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
         xact.predicateHead = pred;
         xact.undoBufferHead = newv;
@@ -1232,7 +1259,7 @@ struct VersionedAggregator : public IndexMV<T> {
 
     cuckoohash_map<T*, VersionedSlice*, HE, HE, std::allocator<std::pair<T*, VersionedSlice*>>> index;
 
-    VersionedAggregator(size_t s) : index(1 << 23) {
+    VersionedAggregator(size_t s) : index(cuckooInitialSize(s)) {
     }
 
     FORCE_INLINE OperationReturnStatus add(Version<T>* newv) override {
@@ -1314,7 +1341,7 @@ struct VersionedAggregator : public IndexMV<T> {
                 return nullptr;
             }
 
-            Version<T> *newv = aligned_malloc(Version<T>);
+            Version<T> *newv = Version<T>::alloc(xact);
             new(newv) Version<T>(resV, xact);
 
             if (!resE->versionHead.compare_exchange_strong(resV, newv)) {
@@ -1323,7 +1350,7 @@ struct VersionedAggregator : public IndexMV<T> {
                     xact.failedBecauseOf = otherXact;
                 }
                 st = WW_VALUE;
-                free(newv);
+                Version<T>::release(newv, xact);
                 return nullptr;
             }
             xact.undoBufferHead = newv;
@@ -1375,7 +1402,7 @@ struct MinHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, Heap<T, ID
         T* ret = Super::get_(key, xact);
         if (ret) {
             //            assert(ret->_4.data_);
-            MinSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MinSlicePred<T, IDX_FN1, IDX_FN2>*) malloc(sizeof(MinSlicePred<T, IDX_FN1, IDX_FN2>));
+            MinSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MinSlicePred<T, IDX_FN1, IDX_FN2>*) xact.allocPredicate(sizeof(MinSlicePred<T, IDX_FN1, IDX_FN2>));
             new(pred) MinSlicePred<T, IDX_FN1, IDX_FN2>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             pred->key = *ret;
             xact.predicateHead = pred;
@@ -1392,7 +1419,7 @@ struct MinHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, Heap<T, ID
         T* ret = Super::getForUpdate_(key, s, xact);
         if (ret) {
             //            assert(ret->_4.data_);
-            MinSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MinSlicePred<T, IDX_FN1, IDX_FN2>*) malloc(sizeof(MinSlicePred<T, IDX_FN1, IDX_FN2>));
+            MinSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MinSlicePred<T, IDX_FN1, IDX_FN2>*) xact.allocPredicate(sizeof(MinSlicePred<T, IDX_FN1, IDX_FN2>));
             new(pred) MinSlicePred<T, IDX_FN1, IDX_FN2>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             pred->key = *ret;
             xact.predicateHead = pred;
@@ -1417,7 +1444,7 @@ struct MaxHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, Heap<T, ID
     FORCE_INLINE T * get(const T* key, Transaction & xact) const override {
         T* ret = Super::get_(key, xact);
         if (ret) {
-            MaxSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MaxSlicePred<T, IDX_FN1, IDX_FN2>*) malloc(sizeof(MaxSlicePred<T, IDX_FN1, IDX_FN2>));
+            MaxSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MaxSlicePred<T, IDX_FN1, IDX_FN2>*) xact.allocPredicate(sizeof(MaxSlicePred<T, IDX_FN1, IDX_FN2>));
             new(pred) MaxSlicePred<T, IDX_FN1, IDX_FN2>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             pred->key = *ret;
             xact.predicateHead = pred;
@@ -1433,7 +1460,7 @@ struct MaxHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, Heap<T, ID
     FORCE_INLINE T * getForUpdate(const T* key, OperationReturnStatus& s, Transaction & xact) {
         T* ret = Super::getForUpdate_(key, s, xact);
         if (ret) {
-            MaxSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MaxSlicePred<T, IDX_FN1, IDX_FN2>*) malloc(sizeof(MaxSlicePred<T, IDX_FN1, IDX_FN2>));
+            MaxSlicePred<T, IDX_FN1, IDX_FN2>* pred = (MaxSlicePred<T, IDX_FN1, IDX_FN2>*) xact.allocPredicate(sizeof(MaxSlicePred<T, IDX_FN1, IDX_FN2>));
             new(pred) MaxSlicePred<T, IDX_FN1, IDX_FN2>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             pred->key = *ret;
             xact.predicateHead = pred;
@@ -1458,7 +1485,7 @@ struct MedHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, MedianHeap
     FORCE_INLINE T * get(const T* key, Transaction & xact) const override {
         T* ret = Super::get_(key, xact);
         if (ret) {
-            SlicePred<T, IDX_FN1>* pred = (SlicePred<T, IDX_FN1>*) malloc(sizeof(SlicePred<T, IDX_FN1>));
+            SlicePred<T, IDX_FN1>* pred = (SlicePred<T, IDX_FN1>*) xact.allocPredicate(sizeof(SlicePred<T, IDX_FN1>));
             new(pred) SlicePred<T, IDX_FN1>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
 
@@ -1469,7 +1496,7 @@ struct MedHeapIndex : public VersionedAggregator<T, IDX_FN1, IDX_FN2, MedianHeap
     FORCE_INLINE T * getForUpdate(const T* key, OperationReturnStatus& s, Transaction & xact) {
         T* ret = Super::getForUpdate_(key, s, xact);
         if (ret) {
-            SlicePred<T, IDX_FN1>* pred = (SlicePred<T, IDX_FN1>*) malloc(sizeof(SlicePred<T, IDX_FN1>));
+            SlicePred<T, IDX_FN1>* pred = (SlicePred<T, IDX_FN1>*) xact.allocPredicate(sizeof(SlicePred<T, IDX_FN1>));
             new(pred) SlicePred<T, IDX_FN1>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
         }
@@ -1502,7 +1529,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
 
     cuckoohash_map<T*, Container*, HE, HE, std::allocator<std::pair<T*, Container*>>> index;
 
-    ConcurrentCuckooSecondaryIndex(size_t size = 100000) : index((1 << 25)) {
+    ConcurrentCuckooSecondaryIndex(size_t size = 0) : index(cuckooInitialSize(size)) {
     }
     // Inserts an entry into the secondary index.
     //Uses cuckoo hashmap as backend
@@ -1621,7 +1648,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
                     return WW_VALUE;
                 }
                 if (v && !v->obj.isInvalid) {
-                    Version<T> * newV = aligned_malloc(Version<T>);
+                    Version<T> * newV = Version<T>::alloc(xact);
                     new(newV) Version<T>(v, xact);
 
                     if (!cur->e->versionHead.compare_exchange_strong(v, newV)) {
@@ -1629,7 +1656,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
                             Transaction* otherXact = TStoPTR(v->xactid);
                             xact.failedBecauseOf = otherXact;
                         }
-                        free(newV);
+                        Version<T>::release(newV, xact);
                         return WW_VALUE;
                     }
                     xact.undoBufferHead = newV;
@@ -1641,7 +1668,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
                 prevNext = curNext;
                 cur = curNext;
             } while (cur);
-            SlicePred<T, IDX_FN>* pred = (SlicePred<T, IDX_FN>*) malloc(sizeof(SlicePred<T, IDX_FN>));
+            SlicePred<T, IDX_FN>* pred = (SlicePred<T, IDX_FN>*) xact.allocPredicate(sizeof(SlicePred<T, IDX_FN>));
             new(pred) SlicePred<T, IDX_FN>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
             return OP_SUCCESS;
@@ -1684,7 +1711,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
                 prevNext = curNext;
                 cur = curNext;
             } while (cur);
-            SlicePred<T, IDX_FN>* pred = (SlicePred<T, IDX_FN>*) malloc(sizeof(SlicePred<T, IDX_FN>));
+            SlicePred<T, IDX_FN>* pred = (SlicePred<T, IDX_FN>*) xact.allocPredicate(sizeof(SlicePred<T, IDX_FN>));
             new(pred) SlicePred<T, IDX_FN>(*key, xact.predicateHead, IndexMV<T>::mmapmv, col_type(-1));
             xact.predicateHead = pred;
             return OP_SUCCESS;
@@ -1729,6 +1756,7 @@ struct ConcurrentCuckooSecondaryIndex : public IndexMV<T> {
 struct MBase {
     virtual void removeEntry(void* o, void* emv) = 0;
     virtual void undo(VBase* v) = 0;
+    virtual void summarize(VBase* v, WriteSummary& s) = 0;
 };
 
 template<typename T, typename...INDEXES>
@@ -1755,6 +1783,13 @@ public:
         }
     }
 
+    //size is the expected number of entries, which sizes the primary index.
+    //The secondary indexes hold one key per slice, which it does not bound usefully, so they start small and grow
+
+    MultiHashMapMV(size_t size) : MultiHashMapMV() {
+        index[0]->prepareSize(size, size);
+    }
+
     MultiHashMapMV(const size_t* arrayLengths, const size_t* poolSizes) { // by defintion index 0 is always unique
         if (sizeof...(INDEXES) > MAX_IDXES_PER_TBL) {
             cerr << "The maximum indexes per table is configured to be " << MAX_IDXES_PER_TBL << " which is less than the required indexes" << endl;
@@ -1845,7 +1880,7 @@ public:
     FORCE_INLINE OperationReturnStatus add(T* elem, Transaction& xact) {
         T* cur = index[0]->get(elem);
         if (cur == nullptr) {
-            Version<T>* newV = aligned_malloc(Version<T>);
+            Version<T>* newV = Version<T>::alloc(xact);
             new(newV) Version<T>(*cur, xact);
             newV->xactid = PTRtoTS(xact);
             EntryMV<T> * newE = aligned_malloc(EntryMV<T>);
@@ -1857,7 +1892,7 @@ public:
                 return OP_SUCCESS;
             } else {
                 free(newE);
-                free(newV);
+                Version<T>::release(newV, xact);
                 return WW_VALUE;
             }
             xact.undoBufferHead = newV;
@@ -1888,7 +1923,7 @@ public:
     }
 
     FORCE_INLINE OperationReturnStatus insert_nocheck(const T* elem, Transaction& xact) {
-        Version<T>* newV = aligned_malloc(Version<T>);
+        Version<T>* newV = Version<T>::alloc(xact);
         new(newV) Version<T>(*elem, xact);
         EntryMV<T>* newE = aligned_malloc(EntryMV<T>);
         new(newE) EntryMV<T>(this, *elem, newV);
@@ -1901,7 +1936,7 @@ public:
             return OP_SUCCESS;
         } else {
             free(newE);
-            free(newV);
+            Version<T>::release(newV, xact);
             return WW_VALUE;
         }
     }
@@ -1918,6 +1953,21 @@ public:
             index[i]->undo((Version<T>*)v);
     }
 
+    //Adds the version and the one it replaced to the write summary, under the key function of every index (see Predicate.h)
+    FORCE_INLINE void summarize(VBase *v, WriteSummary& s) override {
+        Version<T>* dv = (Version<T>*) v;
+        Version<T>* dvOld = (Version<T>*) unmark(dv->oldV.load());
+        s.addTable(this);
+        summarizeKeys(dv->obj, s);
+        if (dvOld != nullptr)
+            summarizeKeys(dvOld->obj, s);
+    }
+
+    FORCE_INLINE void summarizeKeys(const T& obj, WriteSummary& s) {
+        int ignore[] = {0, (s.addKey(this, typename INDEXES::HE()(&obj)), 0)...};
+        (void) ignore;
+    }
+
     FORCE_INLINE void del(T* elem) {
         elem->isInvalid = true;
         Version<T>* v = (Version<T>*)VBase::getVersionFromT((char*) elem);
@@ -4,8 +4,21 @@
 #include <iostream>
 #include <functional>
 #include <string>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
 
 #include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "pool.hpp"
 #include "../serialization.hpp"
 #include "../hpds/pstring.hpp"
@@ -15,6 +28,21 @@ namespace dbtoaster {
 
 #define DEFAULT_CHUNK_SIZE 32   // 2^N
 
+#define BATCH_PREFETCH_DISTANCE 8   // entries ahead of a prefetching foreach loop
+
+// Hash indices with at least this many buckets are resized incrementally: 
+// inserts and deletes move INCREMENTAL_RESIZE_STEP buckets of the previous 
+// table each, instead of one operation rehashing the whole index.
+#ifndef INCREMENTAL_RESIZE_MIN_SIZE
+#define INCREMENTAL_RESIZE_MIN_SIZE (1 << 16)
+#endif
+#define INCREMENTAL_RESIZE_STEP 4
+
+// A MultiHashMap whose index has over CLEAR_SPARSE_RATIO buckets per entry 
+// clears the buckets of its entries rather than all of them, so that clearing 
+// a small delta left with the table of an earlier large batch stays cheap.
+#define CLEAR_SPARSE_RATIO 4
+
 #define HASH_RES_t size_t
 
 // #define DOUBLE_ZERO_APPROXIMATED
@@ -90,48 +118,89 @@ private:
     size_t threshold_;
     size_t count_;
 
+    // While resizing incrementally, the table before the resize. Its first
+    // 'migrated_' buckets have been moved to 'buckets_'.
+    IdxNode* old_buckets_;
+    size_t old_mask_;
+    size_t migrated_;
+
+    // the bucket that holds the elements with hash 'h'
+    FORCE_INLINE IdxNode* bucket_(const HASH_RES_t h) const {
+        if (old_buckets_ != nullptr && (h & old_mask_) >= migrated_) {
+            return old_buckets_ + (h & old_mask_);
+        }
+        return buckets_ + (h & index_mask_);
+    }
+
+    // moves the elements of bucket 'src' of the old table to the new one
+    void migrate_(IdxNode* src) {
+        bool pooled = false;
+        do {
+            if (src->obj != nullptr) {
+                IdxNode* dst = buckets_ + (src->hash & index_mask_);
+                if (dst->obj != nullptr) {
+                    IdxNode* new_node = pool_.add(); 
+                    new_node->obj = dst->obj;
+                    new_node->hash = dst->hash; 
+                    new_node->nxt = dst->nxt; 
+                    dst->obj = src->obj;
+                    dst->hash = src->hash; 
+                    dst->nxt = new_node;
+                } 
+                else {
+                    dst->obj = src->obj;
+                    dst->hash = src->hash;
+                    assert(dst->nxt == nullptr);
+                }
+            }
+            if (pooled) {
+                IdxNode* tmp = src;
+                src = src->nxt;
+                pool_.del(tmp);
+            } 
+            else src = src->nxt;
+            pooled = true;
+        } 
+        while (src != nullptr);
+    }
+
+    // migrates up to 'n' more buckets of the old table
+    void migrate_step_(size_t n) {
+        size_t end = std::min(old_mask_ + 1, migrated_ + n);
+        for (; migrated_ < end; migrated_++) { migrate_(old_buckets_ + migrated_); }
+        if (migrated_ > old_mask_) {
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
+    }
+
     void resize_(size_t new_size) {
-        IdxNode* old_buckets = buckets_;
-        size_t old_size = size_;
+        if (old_buckets_ != nullptr) { migrate_step_(old_mask_ + 1); }
+
+        old_buckets_ = buckets_;
+        old_mask_ = size_ - 1;
+        migrated_ = 0;
 
-        buckets_ = new IdxNode[new_size];
-        memset(buckets_, 0, sizeof(IdxNode) * new_size);
+        // zeroed pages of large tables are only touched once used
+        buckets_ = static_cast<IdxNode*>(calloc(new_size, sizeof(IdxNode)));
         size_ = new_size;
         index_mask_ = size_ - 1;
         threshold_ = size_ * load_factor_;
 
-        for (size_t i = 0; i < old_size; i++) {
-            IdxNode* src = old_buckets + i;
-            bool pooled = false;
-            do {
-                if (src->obj != nullptr) {
-                    IdxNode* dst = buckets_ + (src->hash & index_mask_);
-                    if (dst->obj != nullptr) {
-                        IdxNode* new_node = pool_.add(); 
-                        new_node->obj = dst->obj;
-                        new_node->hash = dst->hash; 
-                        new_node->nxt = dst->nxt; 
-                        dst->obj = src->obj;
-                        dst->hash = src->hash; 
-                        dst->nxt = new_node;
-                    } 
-                    else {
-                        dst->obj = src->obj;
-                        dst->hash = src->hash;
-                        assert(dst->nxt == nullptr);
-                    }
-                }
-                if (pooled) {
-                    IdxNode* tmp = src;
-                    src = src->nxt;
-                    pool_.del(tmp);
-                } 
-                else src = src->nxt;
-                pooled = true;
-            } 
-            while (src != nullptr);
+        if (old_buckets_ != nullptr && old_mask_ + 1 < INCREMENTAL_RESIZE_MIN_SIZE) { 
+            migrate_step_(old_mask_ + 1); 
+        }
+    }
+
+    void clear_(IdxNode* buckets, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            buckets[i].obj = nullptr;
+            buckets[i].hash = 0;
+            if (buckets[i].nxt != nullptr) {
+                pool_.delete_all(buckets[i].nxt);
+                buckets[i].nxt = nullptr;
+            }
         }
-        if (old_buckets != nullptr) delete[] old_buckets;
     }
 
 public:
@@ -141,28 +210,38 @@ public:
         size_ = 0;
         load_factor_ = load_factor;
         count_ = 0;
+        old_buckets_ = nullptr;
         resize_(size);
     }
 
     virtual ~PrimaryHashIndex() {
         pool_.clear();
         if (buckets_ != nullptr) {
-            delete[] buckets_;
+            free(buckets_);
             buckets_ = nullptr;
         }        
+        if (old_buckets_ != nullptr) {
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
     }
 
     FORCE_INLINE size_t count() const { 
         return count_; 
     }    
 
+    // the number of buckets that clear() visits
+    FORCE_INLINE size_t buckets() const { 
+        return size_ + (old_buckets_ != nullptr ? old_mask_ + 1 - migrated_ : 0); 
+    }
+
     FORCE_INLINE HASH_RES_t computeHash(const T& key) { 
         return IDX_FN::hash(key); 
     }
 
     // returns the first matching element or nullptr if not found
     FORCE_INLINE T* get(const T& key, const HASH_RES_t h) const {
-        IdxNode* n = buckets_ + (h & index_mask_);
+        IdxNode* n = bucket_(h);
         do {
             if (n->obj && h == n->hash && IDX_FN::equals(key, *n->obj)) {
                 return n->obj;
@@ -175,13 +254,19 @@ public:
         return get(key, IDX_FN::hash(key));
     }
 
+    // prefetches the bucket of a later get with hash 'h'
+    FORCE_INLINE void prefetchBucket(const HASH_RES_t h) const {
+        __builtin_prefetch(bucket_(h));
+    }
+
     // inserts regardless of whether element already exists
     FORCE_INLINE void insert(T* obj, const HASH_RES_t h) {
         assert(obj != nullptr);
 
         if (count_ > threshold_) { resize_(size_ << 1); }
+        else if (old_buckets_ != nullptr) { migrate_step_(INCREMENTAL_RESIZE_STEP); }
 
-        IdxNode* dst = buckets_ + (h & index_mask_);
+        IdxNode* dst = bucket_(h);
         if (dst->obj != nullptr) {
             IdxNode* new_node = pool_.add();
             new_node->obj = obj;
@@ -205,7 +290,9 @@ public:
     FORCE_INLINE void del(const T* obj, const HASH_RES_t h) {
         assert(obj != nullptr);
 
-        IdxNode *dst = buckets_ + (h & index_mask_);
+        if (old_buckets_ != nullptr) { migrate_step_(INCREMENTAL_RESIZE_STEP); }
+
+        IdxNode *dst = bucket_(h);
         IdxNode *prev = nullptr;
         IdxNode *next;
 
@@ -235,6 +322,17 @@ public:
         } while ((dst = next));
     }
 
+    // replaces the pointer to an element that moves from 'from' to 'to'
+    FORCE_INLINE void relocate(const T* from, T* to, const HASH_RES_t h) {
+        IdxNode* n = bucket_(h);
+        do {
+            if (n->obj == from) {
+                n->obj = to;
+                return;
+            }
+        } while ((n = n->nxt));
+    }
+
     FORCE_INLINE void del(const T* obj) {
         if (obj != nullptr) { del(obj, IDX_FN::hash(*obj)); }
     }
@@ -242,16 +340,481 @@ public:
     FORCE_INLINE void clear() {
         if (count_ == 0) return;
 
+        if (old_buckets_ != nullptr) {
+            clear_(old_buckets_ + migrated_, old_mask_ + 1 - migrated_);
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
+        clear_(buckets_, size_);
+        count_ = 0;
+    }
+
+    // empties the bucket of 'obj', dropping any other element in it
+    FORCE_INLINE void clearBucket(const T* obj) {
+        IdxNode* dst = bucket_(IDX_FN::hash(*obj));
+        if (dst->obj == nullptr) return;
+
+        IdxNode* n = dst;
+        do { count_--; } while ((n = n->nxt));
+        clear_(dst, 1);
+    }
+};
+
+#define SWISS_GROUP_SLOTS 14
+#define SWISS_GROUP_MASK ((1u << SWISS_GROUP_SLOTS) - 1)
+#define SWISS_EMPTY ((int8_t) -128)
+#define SWISS_DELETED ((int8_t) -2)
+
+// Bitmask of the control bytes among the 16 at 'ctrl' (16-byte aligned) that equal 'c'
+FORCE_INLINE unsigned swiss_match(const int8_t* ctrl, int8_t c) {
+#ifdef __SSE2__
+    __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < 16; i++)
+        mask |= (unsigned) (ctrl[i] == c) << i;
+    return mask;
+#endif
+}
+
+// Bitmask of the empty or deleted control bytes (the ones with the sign bit set)
+FORCE_INLINE unsigned swiss_match_free(const int8_t* ctrl) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(ctrl)));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < 16; i++)
+        mask |= (unsigned) (ctrl[i] < 0) << i;
+    return mask;
+#endif
+}
+
+// Generated hash functions leave the high bits of small keys almost
+// constant; tags and probe positions are taken from a remixed hash instead.
+FORCE_INLINE HASH_RES_t swiss_mix(HASH_RES_t h) {
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 33);
+}
+
+/**
+ * Open-addressing alternative to PrimaryHashIndex. Slots come in groups of
+ * 14 that fill two cache lines: 16 control bytes, one per slot (the last
+ * two are unused), followed by the element pointers. A control byte is
+ * either SWISS_EMPTY, SWISS_DELETED or a 7-bit tag of the hash of the
+ * slot's element. A lookup loads both lines of a group together, compares
+ * all of its tags at once (with SSE2 where available) and dereferences only
+ * the elements whose tag matches, so a hit costs about as many cache misses
+ * as finding an element at the head of a chain, without the chain. Groups
+ * are probed in triangular order, and a probe sequence ends at the first
+ * group with an empty slot.
+ */
+template <typename T, typename IDX_FN = T>
+class SwissPrimaryHashIndex {
+private:
+    struct Group {
+        int8_t ctrl[16];
+        T* obj[SWISS_GROUP_SLOTS];
+
+        FORCE_INLINE unsigned match(int8_t c) const {
+            return swiss_match(ctrl, c) & SWISS_GROUP_MASK;
+        }
+
+        FORCE_INLINE unsigned match_free() const {
+            return swiss_match_free(ctrl) & SWISS_GROUP_MASK;
+        }
+    };
+
+    char* memory_;
+    Group* groups_;
+
+    size_t group_mask_;
+    double load_factor_;
+    size_t threshold_;      // bound on count_ + deleted_
+    size_t count_;
+    size_t deleted_;
+
+    FORCE_INLINE static int8_t tag(HASH_RES_t m) { 
+        return (int8_t) (m & 0x7F); 
+    }
+
+    // Places 'obj' in the first free slot of its probe sequence
+    FORCE_INLINE void place_(T* obj, HASH_RES_t m) {
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            Group& grp = groups_[g];
+            unsigned free = grp.match_free();
+            if (free) {
+                unsigned s = __builtin_ctz(free);
+                if (grp.ctrl[s] == SWISS_DELETED) { deleted_--; }
+                grp.ctrl[s] = tag(m);
+                grp.obj[s] = obj;
+                return;
+            }
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    void resize_(size_t num_groups) {
+        char* old_memory = memory_;
+        Group* old_groups = groups_;
+        size_t old_num_groups = (old_groups != nullptr ? group_mask_ + 1 : 0);
+
+        // groups are aligned to pairs of cache lines
+        memory_ = new char[num_groups * sizeof(Group) + 128];
+        groups_ = reinterpret_cast<Group*>((reinterpret_cast<size_t>(memory_) + 127) & ~(size_t) 127);
+        for (size_t i = 0; i < num_groups; i++)
+            memset(groups_[i].ctrl, SWISS_EMPTY, sizeof(groups_[i].ctrl));
+        group_mask_ = num_groups - 1;
+        size_t capacity = num_groups * SWISS_GROUP_SLOTS;
+        threshold_ = std::min(capacity - 1, (size_t) (capacity * load_factor_));
+        deleted_ = 0;
+
+        for (size_t i = 0; i < old_num_groups; i++) {
+            const Group& src = old_groups[i];
+            for (unsigned full = ~src.match_free() & SWISS_GROUP_MASK; full; full &= full - 1) {
+                T* obj = src.obj[__builtin_ctz(full)];
+                place_(obj, swiss_mix(IDX_FN::hash(*obj)));
+            }
+        }
+        if (old_memory != nullptr) delete[] old_memory;
+    }
+
+public:
+
+    SwissPrimaryHashIndex(size_t size = DEFAULT_CHUNK_SIZE, double load_factor = 0.875) {
+        memory_ = nullptr;
+        groups_ = nullptr;
+        load_factor_ = load_factor;
+        count_ = 0;
+        deleted_ = 0;
+        size_t num_groups = 1;
+        while (num_groups * SWISS_GROUP_SLOTS * load_factor_ < size) num_groups <<= 1;
+        resize_(num_groups);
+    }
+
+    virtual ~SwissPrimaryHashIndex() {
+        if (memory_ != nullptr) {
+            delete[] memory_;
+            memory_ = nullptr;
+            groups_ = nullptr;
+        }
+    }
+
+    FORCE_INLINE size_t count() const { 
+        return count_; 
+    }
+
+    // the number of groups that clear() visits
+    FORCE_INLINE size_t buckets() const { 
+        return group_mask_ + 1; 
+    }
+
+    FORCE_INLINE HASH_RES_t computeHash(const T& key) { 
+        return IDX_FN::hash(key); 
+    }
+
+    // returns the first matching element or nullptr if not found
+    FORCE_INLINE T* get(const T& key, const HASH_RES_t h) const {
+        HASH_RES_t m = swiss_mix(h);
+        int8_t t = tag(m);
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            const Group& grp = groups_[g];
+            __builtin_prefetch(grp.obj + SWISS_GROUP_SLOTS - 1);
+            for (unsigned hit = grp.match(t); hit; hit &= hit - 1) {
+                T* obj = grp.obj[__builtin_ctz(hit)];
+                if (IDX_FN::equals(key, *obj)) return obj;
+            }
+            if (grp.match(SWISS_EMPTY)) return nullptr;
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    FORCE_INLINE T* get(const T& key) const {
+        return get(key, IDX_FN::hash(key));
+    }
+
+    // prefetches both lines of the first group probed by a get with hash 'h'
+    FORCE_INLINE void prefetchBucket(const HASH_RES_t h) const {
+        const Group* grp = groups_ + ((swiss_mix(h) >> 7) & group_mask_);
+        __builtin_prefetch(grp);
+        __builtin_prefetch(grp->obj + SWISS_GROUP_SLOTS - 1);
+    }
+
+    // inserts regardless of whether element already exists
+    FORCE_INLINE void insert(T* obj, const HASH_RES_t h) {
+        assert(obj != nullptr);
+
+        if (count_ + deleted_ >= threshold_) {
+            // rehash in place when most of the load is tombstones
+            size_t num_groups = group_mask_ + 1;
+            resize_(deleted_ > count_ ? num_groups : num_groups << 1);
+        }
+        place_(obj, swiss_mix(h));
+        count_++;
+    }
+
+    FORCE_INLINE void insert(T* obj) {
+        if (obj != nullptr) { insert(obj, IDX_FN::hash(*obj)); }
+    }
+
+    // deletes an existing elements (equality by pointer comparison)
+    FORCE_INLINE void del(const T* obj, const HASH_RES_t h) {
+        assert(obj != nullptr);
+
+        HASH_RES_t m = swiss_mix(h);
+        int8_t t = tag(m);
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            Group& grp = groups_[g];
+            for (unsigned hit = grp.match(t); hit; hit &= hit - 1) {
+                unsigned s = __builtin_ctz(hit);
+                if (grp.obj[s] == obj) {
+                    // No probe sequence continues past a group that has an
+                    // empty slot, so the slot can become empty again.
+                    if (grp.match(SWISS_EMPTY)) {
+                        grp.ctrl[s] = SWISS_EMPTY;
+                    }
+                    else {
+                        grp.ctrl[s] = SWISS_DELETED;
+                        deleted_++;
+                    }
+                    count_--;
+                    return;
+                }
+            }
+            if (grp.match(SWISS_EMPTY)) return;
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    FORCE_INLINE void del(const T* obj) {
+        if (obj != nullptr) { del(obj, IDX_FN::hash(*obj)); }
+    }
+
+    // replaces the pointer to an element that moves from 'from' to 'to'
+    FORCE_INLINE void relocate(const T* from, T* to, const HASH_RES_t h) {
+        HASH_RES_t m = swiss_mix(h);
+        int8_t t = tag(m);
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            Group& grp = groups_[g];
+            for (unsigned hit = grp.match(t); hit; hit &= hit - 1) {
+                unsigned s = __builtin_ctz(hit);
+                if (grp.obj[s] == from) {
+                    grp.obj[s] = to;
+                    return;
+                }
+            }
+            if (grp.match(SWISS_EMPTY)) return;
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    FORCE_INLINE void clear() {
+        if (count_ == 0 && deleted_ == 0) return;
+
+        for (size_t i = 0; i <= group_mask_; i++)
+            memset(groups_[i].ctrl, SWISS_EMPTY, sizeof(groups_[i].ctrl));
+        count_ = 0;
+        deleted_ = 0;
+    }
+
+    // Deletes 'obj'. Probes for the other elements remain valid, and the 
+    // tombstones left are reclaimed by the next rehash in place.
+    FORCE_INLINE void clearBucket(const T* obj) {
+        del(obj);
+    }
+};
+
+// A DenseArrayIndex covers any key range of up to DENSE_INDEX_MIN_SPARSE_SLOTS
+// slots, and larger ranges with at most DENSE_INDEX_MAX_SLOTS_PER_ENTRY slots
+// per element; keys spread any wider move it to a PrimaryHashIndex.
+#define DENSE_INDEX_MIN_SLOTS 64   // 2^N
+#define DENSE_INDEX_MIN_SPARSE_SLOTS (1 << 16)
+#define DENSE_INDEX_MAX_SLOTS_PER_ENTRY 8
+
+/**
+ * Primary index for maps keyed by a single integer, IDX_FN::key(). Elements
+ * sit in an array of pointers at the offset of their key from the lowest key
+ * of the array, so a lookup is a subtraction, a bounds check and a load. The
+ * array doubles, towards lower or higher keys, to cover the keys inserted. 
+ * When the keys turn out to be sparse, or two elements share a key, the index 
+ * moves its elements into a PrimaryHashIndex and forwards to it from then on.
+ * Hashes passed to and returned by this index are the keys themselves while 
+ * the array is in use.
+ */
+template <typename T, typename IDX_FN = T>
+class DenseArrayIndex {
+private:
+    typedef PrimaryHashIndex<T, IDX_FN> SparseIndex;
+
+    T** slots_;
+    long base_;             // key of slots_[0]
+    size_t size_;
+    size_t min_size_;
+    size_t count_;
+    SparseIndex* sparse_;   // set once the keys are sparse
+
+    FORCE_INLINE size_t offset_(const HASH_RES_t h) const {
+        return (size_t) ((long) h - base_);
+    }
+
+    // Grows the array to cover 'key', or moves to the PrimaryHashIndex if
+    // that takes too many slots per element.
+    void grow_(long key) {
+        if (slots_ == nullptr) {
+            base_ = key;
+            size_ = min_size_;
+            slots_ = static_cast<T**>(calloc(size_, sizeof(T*)));
+            return;
+        }
+        long lo = std::min(key, base_);
+        long hi = std::max(key, base_ + (long) size_ - 1);
+        size_t range = (size_t) hi - (size_t) lo + 1;    // 0 if it wraps around
+        if (range == 0 || (range > DENSE_INDEX_MIN_SPARSE_SLOTS && 
+                           range > DENSE_INDEX_MAX_SLOTS_PER_ENTRY * (count_ + 1))) {
+            to_sparse_();
+            return;
+        }
+        size_t new_size = size_ << 1;
+        while (new_size < range) { new_size <<= 1; }
+        // the new slots go on the side of 'key'
+        long new_base = (key < base_ ? hi - (long) new_size + 1 : base_);
+        T** new_slots = static_cast<T**>(calloc(new_size, sizeof(T*)));
+        memcpy(new_slots + (base_ - new_base), slots_, size_ * sizeof(T*));
+        free(slots_);
+        slots_ = new_slots;
+        base_ = new_base;
+        size_ = new_size;
+    }
+
+    void to_sparse_() {
+        sparse_ = new SparseIndex(std::max(count_ * 2, (size_t) DEFAULT_CHUNK_SIZE));
         for (size_t i = 0; i < size_; i++) {
-            buckets_[i].obj = nullptr;
-            buckets_[i].hash = 0;
-            if (buckets_[i].nxt != nullptr) {
-                pool_.delete_all(buckets_[i].nxt);
-                buckets_[i].nxt = nullptr;
+            if (slots_[i] != nullptr) { sparse_->insert(slots_[i]); }
+        }
+        free(slots_);
+        slots_ = nullptr;
+        size_ = 0;
+    }
+
+public:
+
+    DenseArrayIndex(size_t size = DEFAULT_CHUNK_SIZE) {
+        slots_ = nullptr;
+        base_ = 0;
+        size_ = 0;
+        min_size_ = DENSE_INDEX_MIN_SLOTS;
+        while (min_size_ < size) { min_size_ <<= 1; }
+        count_ = 0;
+        sparse_ = nullptr;
+    }
+
+    virtual ~DenseArrayIndex() {
+        if (slots_ != nullptr) {
+            free(slots_);
+            slots_ = nullptr;
+        }
+        if (sparse_ != nullptr) {
+            delete sparse_;
+            sparse_ = nullptr;
+        }
+    }
+
+    FORCE_INLINE size_t count() const { 
+        return (sparse_ == nullptr ? count_ : sparse_->count()); 
+    }
+
+    // the number of slots that clear() visits
+    FORCE_INLINE size_t buckets() const { 
+        return (sparse_ == nullptr ? size_ : sparse_->buckets()); 
+    }
+
+    FORCE_INLINE HASH_RES_t computeHash(const T& key) const { 
+        return (sparse_ == nullptr ? (HASH_RES_t) IDX_FN::key(key) : IDX_FN::hash(key)); 
+    }
+
+    // returns the element with the key of 'key' or nullptr if not found
+    FORCE_INLINE T* get(const T& key, const HASH_RES_t h) const {
+        if (sparse_ != nullptr) { return sparse_->get(key, h); }
+        size_t i = offset_(h);
+        return (i < size_ ? slots_[i] : nullptr);
+    }
+
+    FORCE_INLINE T* get(const T& key) const {
+        return get(key, computeHash(key));
+    }
+
+    FORCE_INLINE void prefetchBucket(const HASH_RES_t h) const {
+        if (sparse_ != nullptr) { sparse_->prefetchBucket(h); return; }
+        size_t i = offset_(h);
+        if (i < size_) { __builtin_prefetch(slots_ + i); }
+    }
+
+    FORCE_INLINE void insert(T* obj, const HASH_RES_t h) {
+        assert(obj != nullptr);
+
+        if (sparse_ == nullptr) {
+            size_t i = offset_(h);
+            if (i >= size_) {
+                grow_((long) h);
+                i = offset_(h);
+            }
+            if (sparse_ == nullptr) {
+                if (slots_[i] == nullptr) {
+                    slots_[i] = obj;
+                    count_++;
+                    return;
+                }
+                to_sparse_();   // a second element with the same key
             }
         }
+        // 'h' is a key rather than a hash if the index has just moved
+        sparse_->insert(obj);
+    }
+
+    FORCE_INLINE void insert(T* obj) {
+        if (obj != nullptr) { insert(obj, computeHash(*obj)); }
+    }
+
+    // deletes an existing elements (equality by pointer comparison)
+    FORCE_INLINE void del(const T* obj, const HASH_RES_t h) {
+        assert(obj != nullptr);
+
+        if (sparse_ != nullptr) { sparse_->del(obj, h); return; }
+        size_t i = offset_(h);
+        if (i < size_ && slots_[i] == obj) {
+            slots_[i] = nullptr;
+            count_--;
+        }
+    }
+
+    FORCE_INLINE void del(const T* obj) {
+        if (obj != nullptr) { del(obj, computeHash(*obj)); }
+    }
+
+    // replaces the pointer to an element that moves from 'from' to 'to'
+    FORCE_INLINE void relocate(const T* from, T* to, const HASH_RES_t h) {
+        if (sparse_ != nullptr) { sparse_->relocate(from, to, h); return; }
+        size_t i = offset_(h);
+        if (i < size_ && slots_[i] == from) { slots_[i] = to; }
+    }
+
+    // keeps the array, and the PrimaryHashIndex once sparse
+    FORCE_INLINE void clear() {
+        if (sparse_ != nullptr) { sparse_->clear(); return; }
+        if (count_ == 0) return;
+
+        memset(slots_, 0, size_ * sizeof(T*));
         count_ = 0;
     }
+
+    FORCE_INLINE void clearBucket(const T* obj) {
+        if (sparse_ != nullptr) { sparse_->clearBucket(obj); return; }
+        del(obj);
+    }
 };
 
 template <typename T> 
@@ -259,12 +822,24 @@ class SecondaryIndex {
   public:
     virtual const SecondaryIdxNode<T>* slice(const T& key) const = 0;
 
+    // prefetches the bucket of a later slice(key)
+    virtual void prefetch(const T& key) const = 0;
+
     virtual void insert(T* obj) = 0;
 
     virtual void del(const T* obj) = 0;
 
+    // replaces the pointer to an element that moves from 'from' to 'to'
+    virtual void relocate(const T* from, T* to) = 0;
+
     virtual void clear() = 0;
 
+    // the number of buckets that clear() visits
+    virtual size_t buckets() const = 0;
+
+    // empties the bucket of 'obj', dropping any other element in it
+    virtual void clearBucket(const T* obj) = 0;
+
     virtual ~SecondaryIndex() { }
 };
 
@@ -283,78 +858,135 @@ private:
     size_t threshold_;
     size_t count_;
 
+    // incremental resize, as in PrimaryHashIndex
+    IdxNode* old_buckets_;
+    size_t old_mask_;
+    size_t migrated_;
+
+    FORCE_INLINE IdxNode* bucket_(const HASH_RES_t h) const {
+        if (old_buckets_ != nullptr && (h & old_mask_) >= migrated_) {
+            return old_buckets_ + (h & old_mask_);
+        }
+        return buckets_ + (h & index_mask_);
+    }
+
+    void migrate_(IdxNode* src) {
+        bool pooled = false;
+        do {
+            if (src->obj != nullptr) {
+                IdxNode* dst = buckets_ + (src->hash & index_mask_);
+                if (dst->obj != nullptr) {
+                    IdxNode* new_node = pool_.add();
+                    new_node->obj = dst->obj;
+                    new_node->hash = dst->hash; 
+                    new_node->nxt = dst->nxt; 
+                    new_node->child = dst->child;
+                    dst->obj = src->obj;
+                    dst->hash = src->hash; 
+                    dst->nxt = new_node;
+                    dst->child = src->child;
+                } 
+                else {
+                    dst->obj = src->obj;
+                    dst->hash = src->hash;
+                    assert(dst->nxt == nullptr);
+                    dst->child = src->child;
+                }
+            }
+            if (pooled) {
+                IdxNode* tmp = src;
+                src = src->nxt;
+                pool_.del(tmp);
+            } 
+            else src = src->nxt;
+            pooled = true;
+        } 
+        while (src != nullptr);
+    }
+
+    void migrate_step_(size_t n) {
+        size_t end = std::min(old_mask_ + 1, migrated_ + n);
+        for (; migrated_ < end; migrated_++) { migrate_(old_buckets_ + migrated_); }
+        if (migrated_ > old_mask_) {
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
+    }
+
     void resize_(size_t new_size) {
-        IdxNode* old_buckets = buckets_;
-        size_t old_size = size_;
+        if (old_buckets_ != nullptr) { migrate_step_(old_mask_ + 1); }
 
-        buckets_ = new IdxNode[new_size];
-        memset(buckets_, 0, sizeof(IdxNode) * new_size);
+        old_buckets_ = buckets_;
+        old_mask_ = size_ - 1;
+        migrated_ = 0;
+
+        buckets_ = static_cast<IdxNode*>(calloc(new_size, sizeof(IdxNode)));
         size_ = new_size;
         index_mask_ = size_ - 1;
         threshold_ = size_ * load_factor_;
 
-        for (size_t i = 0; i < old_size; i++) {
-            IdxNode* src = old_buckets + i;
-            bool pooled = false;
-            do {
-                if (src->obj != nullptr) {
-                    IdxNode* dst = buckets_ + (src->hash & index_mask_);
-                    if (dst->obj != nullptr) {
-                        IdxNode* new_node = pool_.add();
-                        new_node->obj = dst->obj;
-                        new_node->hash = dst->hash; 
-                        new_node->nxt = dst->nxt; 
-                        new_node->child = dst->child;
-                        dst->obj = src->obj;
-                        dst->hash = src->hash; 
-                        dst->nxt = new_node;
-                        dst->child = src->child;
-                    } 
-                    else {
-                        dst->obj = src->obj;
-                        dst->hash = src->hash;
-                        assert(dst->nxt == nullptr);
-                        dst->child = src->child;
-                    }
-                }
-                if (pooled) {
-                    IdxNode* tmp = src;
-                    src = src->nxt;
-                    pool_.del(tmp);
-                } 
-                else src = src->nxt;
-                pooled = true;
-            } 
-            while (src != nullptr);
+        if (old_buckets_ != nullptr && old_mask_ + 1 < INCREMENTAL_RESIZE_MIN_SIZE) { 
+            migrate_step_(old_mask_ + 1); 
         }
-        if (old_buckets != nullptr) delete[] old_buckets;
     }    
 
-public:
-
-    SecondaryHashIndex(size_t size = DEFAULT_CHUNK_SIZE, double load_factor = 0.75) {
-        buckets_ = nullptr;
-        size_ = 0;
-        load_factor_ = load_factor;
-        count_ = 0;
-        resize_(size);        
-    }
-
+    void clear_(IdxNode* buckets, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            buckets[i].obj = nullptr;
+            buckets[i].hash = 0;
+            if (buckets[i].nxt != nullptr) {                
+                // Delete all children
+                IdxNode* dst = buckets[i].nxt;
+                do {
+                    if (dst->child != nullptr) {
+                        pool_.delete_all(dst->child);
+                        // dst->child = nullptr;
+                    }
+                } while ((dst = dst->nxt));
+                pool_.delete_all(buckets[i].nxt);
+                buckets[i].nxt = nullptr;
+            }
+            if (buckets[i].child != nullptr) {
+                pool_.delete_all(buckets[i].child);
+                buckets[i].child = nullptr;
+            }
+        }
+    }
+
+public:
+
+    SecondaryHashIndex(size_t size = DEFAULT_CHUNK_SIZE, double load_factor = 0.75) {
+        buckets_ = nullptr;
+        size_ = 0;
+        load_factor_ = load_factor;
+        count_ = 0;
+        old_buckets_ = nullptr;
+        resize_(size);        
+    }
+
     virtual ~SecondaryHashIndex() {
         pool_.clear();
         if (buckets_ != nullptr) {
-            delete[] buckets_;
+            free(buckets_);
             buckets_ = nullptr;
         }        
+        if (old_buckets_ != nullptr) {
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
     }
 
     FORCE_INLINE size_t count() const { 
         return count_; 
+    }
+
+    FORCE_INLINE size_t buckets() const { 
+        return size_ + (old_buckets_ != nullptr ? old_mask_ + 1 - migrated_ : 0); 
     }    
 
     // returns the first matching node or nullptr if not found
     FORCE_INLINE IdxNode* slice(const T& key, const HASH_RES_t h) const {
-        IdxNode* n = buckets_ + (h & index_mask_);
+        IdxNode* n = bucket_(h);
         do {
             if (n->obj && h == n->hash && IDX_FN::equals(key, *n->obj)) {
                 return n;
@@ -367,13 +999,18 @@ public:
         return slice(key, IDX_FN::hash(key));
     }
 
+    FORCE_INLINE void prefetch(const T& key) const {
+        __builtin_prefetch(bucket_(IDX_FN::hash(key)));
+    }
+
     // inserts regardless of whether element already exists
     FORCE_INLINE void insert(T* obj, const HASH_RES_t h) {
         assert(obj != nullptr);
 
         if (count_ > threshold_) { resize_(size_ << 1); }
+        else if (old_buckets_ != nullptr) { migrate_step_(INCREMENTAL_RESIZE_STEP); }
 
-        IdxNode* dst = buckets_ + (h & index_mask_);
+        IdxNode* dst = bucket_(h);
     
         if (dst->obj == nullptr) {
             dst->obj = obj;
@@ -407,274 +1044,1194 @@ public:
         }
     }
 
-    FORCE_INLINE void insert(T* obj) {
-        if (obj != nullptr) insert(obj, IDX_FN::hash(*obj));
+    FORCE_INLINE void insert(T* obj) {
+        if (obj != nullptr) insert(obj, IDX_FN::hash(*obj));
+    }
+
+    // deletes an existing elements (equality by pointer comparison)
+    FORCE_INLINE void del(const T* obj, const HASH_RES_t h) {
+        assert(obj != nullptr);
+
+        if (old_buckets_ != nullptr) { migrate_step_(INCREMENTAL_RESIZE_STEP); }
+
+        IdxNode* dst = bucket_(h);
+        IdxNode* prev = nullptr;
+        IdxNode* next;
+
+        do {
+            next = dst->nxt;
+            if (dst->obj && h == dst->hash && IDX_FN::equals(*obj, *dst->obj)) {
+
+                // pointer comparison is sufficient as all objects are stored in pool
+                if (dst->obj == obj) {
+                    // delete the first element of slice
+                    IdxNode* child = dst->child;
+                    if (child != nullptr) {
+                        dst->obj = child->obj;
+                        dst->hash = child->hash;
+                        // dst->nxt remains unchanged
+                        dst->child = child->nxt;
+                        assert(child->child == nullptr);
+                        pool_.del(child);
+                    }
+                    else {
+                        if (prev != nullptr) {  // element in linked list (and not in bucket itself)
+                            prev->nxt = next;
+                            pool_.del(dst);
+                        }
+                        else if (next != nullptr) {  // element in bucket, and there are other elements in linked list
+                            dst->obj = next->obj;
+                            dst->hash = next->hash;
+                            dst->nxt = next->nxt;
+                            dst->child = next->child;
+                            pool_.del(next);
+                        }
+                        else {   // the only element in bucket
+                            dst->obj = nullptr;
+                            dst->hash = 0;
+                            dst->nxt = nullptr;
+                            dst->child = nullptr;
+                        }
+                        count_--;
+                    }
+                }
+                else {
+                    IdxNode* head = dst;
+                    prev = dst;
+                    dst = dst->child;
+                    while (dst != nullptr) {
+                        if (dst->obj == obj) {
+                            if (prev == head) { head->child = dst->nxt; }
+                            else { prev->nxt = dst->nxt; }
+                            pool_.del(dst);
+                            return;
+                        }
+                        prev = dst;
+                        dst = dst->nxt;
+                    }
+                }
+                return;
+            }
+            prev = dst;
+        } while ((dst = next));
+    }
+
+    // replaces the pointer to an element that moves from 'from' to 'to'
+    FORCE_INLINE void relocate(const T* from, T* to) {
+        IdxNode* n = slice(*from, IDX_FN::hash(*from));
+        if (n == nullptr) return;
+        if (n->obj == from) {
+            n->obj = to;
+            return;
+        }
+        for (n = n->child; n != nullptr; n = n->nxt) {
+            if (n->obj == from) {
+                n->obj = to;
+                return;
+            }
+        }
+    }
+
+    FORCE_INLINE void del(const T* obj) {
+        if (obj != nullptr) { del(obj, IDX_FN::hash(*obj)); }
+    }
+
+    FORCE_INLINE void clear() {
+        if (count_ == 0) return;
+
+        if (old_buckets_ != nullptr) {
+            clear_(old_buckets_ + migrated_, old_mask_ + 1 - migrated_);
+            free(old_buckets_);
+            old_buckets_ = nullptr;
+        }
+        clear_(buckets_, size_);
+        count_ = 0;
+    }
+
+    // empties the bucket of 'obj', dropping any other element in it
+    FORCE_INLINE void clearBucket(const T* obj) {
+        IdxNode* dst = bucket_(IDX_FN::hash(*obj));
+        if (dst->obj == nullptr) return;
+
+        IdxNode* n = dst;
+        do { count_--; } while ((n = n->nxt));
+        clear_(dst, 1);
+    }
+};
+
+#define SLOT_PAGE_BYTES (1 << 16)   // 2^N
+
+/**
+ * Dense storage of the entries of a MultiHashMap: n entries occupy slots
+ * 0..n-1, PER_PAGE slots per page. Removing an entry moves the entry of the
+ * last slot into its place. Pages are aligned to their size and start with 
+ * their number, so that the slot of an entry follows from its address.
+ */
+template <typename T>
+class SlotArray {
+  public:
+    static const size_t HEADER = (alignof(T) > 64 ? alignof(T) : 64);
+    static const size_t PER_PAGE = (SLOT_PAGE_BYTES - HEADER) / sizeof(T);
+
+  private:
+    std::vector<char*> pages_;
+    size_t count_;
+
+    FORCE_INLINE static T* slots_of(const char* page) { 
+        return reinterpret_cast<T*>(const_cast<char*>(page) + HEADER); 
+    }
+
+    FORCE_INLINE static const char* page_of(const T* elem) {
+        return reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(elem) & ~(uintptr_t) (SLOT_PAGE_BYTES - 1));
+    }
+
+    void add_page() {
+        void* page;
+        if (posix_memalign(&page, SLOT_PAGE_BYTES, SLOT_PAGE_BYTES) != 0) { throw std::bad_alloc(); }
+        *static_cast<size_t*>(page) = pages_.size();
+        pages_.push_back(static_cast<char*>(page));
+    }
+
+    SlotArray(const SlotArray&) = delete;
+    SlotArray& operator=(const SlotArray&) = delete;
+
+  public:
+
+    SlotArray() : count_(0) { 
+        static_assert(PER_PAGE > 0, "entry does not fit into a page");
+    }
+
+    ~SlotArray() {
+        clear();
+        for (size_t p = 0; p < pages_.size(); p++) { free(pages_[p]); }
+    }
+
+    FORCE_INLINE size_t count() const { 
+        return count_; 
+    }
+
+    // number of slots, used or not
+    FORCE_INLINE size_t capacity() const { 
+        return pages_.size() * PER_PAGE; 
+    }
+
+    FORCE_INLINE T* at(size_t slot) const {
+        return slots_of(pages_[slot / PER_PAGE]) + slot % PER_PAGE;
+    }
+
+    FORCE_INLINE static size_t slot(const T* elem) {
+        const char* page = page_of(elem);
+        return *reinterpret_cast<const size_t*>(page) * PER_PAGE + (elem - slots_of(page));
+    }
+
+    // the entry of the last slot, or nullptr
+    FORCE_INLINE T* last() const {
+        return (count_ > 0 ? at(count_ - 1) : nullptr);
+    }
+
+    // the entry of the slot before that of 'elem', or nullptr
+    FORCE_INLINE T* prev(const T* elem) const {
+        const char* page = page_of(elem);
+        if (elem != slots_of(page)) { return const_cast<T*>(elem) - 1; }
+        size_t p = *reinterpret_cast<const size_t*>(page);
+        return (p > 0 ? slots_of(pages_[p - 1]) + PER_PAGE - 1 : nullptr);
+    }
+
+    FORCE_INLINE T* add(const T& elem) {
+        if (count_ == capacity()) { add_page(); }
+        return new (at(count_++)) T(elem);
+    }
+
+    FORCE_INLINE void remove(T* elem) {
+        T* moved = at(--count_);
+        elem->~T();
+        if (moved != elem) {
+            new (elem) T(std::move(*moved));
+            moved->~T();
+        }
+    }
+
+    // calls f on the entries of slots [from, to)
+    template <typename F>
+    void scan(size_t from, size_t to, F f) const {
+        for (size_t i = from, end = std::min(to, count_); i < end; i++) { f(*at(i)); }
+    }
+
+    void clear() {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = 0; i < count_; i++) { at(i)->~T(); }
+        }
+        count_ = 0;
+    }
+};
+
+#define SNAPSHOT_PAGE_SIZE 256
+
+/**
+ * Immutable copy of the entries of a MultiHashMap, shared between the map
+ * and the snapshots taken from it. Entries are grouped into pages by their
+ * slot, so that a new image shares all pages with the previous one except
+ * those written in between.
+ */
+template <typename T>
+struct SnapshotImage {
+    typedef std::vector<T> Page;
+
+    std::vector<std::shared_ptr<const Page>> pages;
+    size_t count;
+
+    SnapshotImage() : count(0) { }
+};
+
+template <typename T, typename V, typename PRIMARY_INDEX, typename... SECONDARY_INDEXES> 
+class MultiHashMap {
+  private:
+    typedef SnapshotImage<T> Image;
+    typedef MultiHashMap<T, V, PRIMARY_INDEX> KeySet;
+
+    SlotArray<T> entries;
+    PRIMARY_INDEX* primary_index;
+    SecondaryIndex<T>** secondary_indexes;
+
+    const V Zero = ZeroValue<V>().get();
+
+    // Live map: the image handed to the last snapshot and the pages written
+    // since then. Tracking starts with the first snapshot of the map.
+    mutable std::shared_ptr<const Image> image;
+    mutable std::vector<bool> dirty;
+    mutable std::vector<size_t> dirty_pages;
+    mutable bool tracking;
+
+    // Snapshot: entries stay in the shared image until the map is accessed
+    // through anything other than serialize() and count().
+    std::shared_ptr<const Image> frozen_image;
+    std::atomic<bool> frozen;
+    std::mutex thaw_lock;
+
+    // Change log (see log_changes): the keys written in the current epoch
+    // and, for each closed epoch, the keys written during it.
+    std::unique_ptr<KeySet> changed_keys;
+    std::deque<std::pair<unsigned long, std::unique_ptr<KeySet>>> change_history;
+    size_t change_history_keys;
+    unsigned long change_log_start;
+
+    // Records a write to 'elem' for snapshots and the change log.
+    FORCE_INLINE void touch(const T* elem) const {
+        if (tracking) { mark_dirty(SlotArray<T>::slot(elem) / SNAPSHOT_PAGE_SIZE); }
+        if (changed_keys != nullptr) { log_change(*elem); }
+    }
+
+    void log_change(const T& key) const {
+        if (changed_keys->get(key) == nullptr) { changed_keys->insert(key); }
+    }
+
+    void mark_dirty(size_t page) const {
+        if (page >= dirty.size()) { dirty.resize(page + 1, false); }
+        if (!dirty[page]) {
+            dirty[page] = true;
+            dirty_pages.push_back(page);
+        }
+    }
+
+    void mark_all_dirty() const {
+        size_t pages = (entries.capacity() + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+        for (size_t p = 0; p < pages; p++) { mark_dirty(p); }
+    }
+
+    // Returns an image of the current entries, rebuilding only dirty pages.
+    std::shared_ptr<const Image> take_image() const {
+        if (!tracking) {
+            tracking = true;
+            mark_all_dirty();
+        }
+        if (image != nullptr && dirty_pages.empty()) { return image; }
+
+        Image* img = (image != nullptr ? new Image(*image) : new Image());
+        size_t pages = (entries.capacity() + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+        if (img->pages.size() < pages) { img->pages.resize(pages); }
+
+        for (size_t i = 0; i < dirty_pages.size(); i++) {
+            size_t p = dirty_pages[i];
+            typename Image::Page* page = new typename Image::Page();
+            entries.scan(p * SNAPSHOT_PAGE_SIZE, (p + 1) * SNAPSHOT_PAGE_SIZE, 
+                         [page](const T& e) { page->push_back(e); });
+            img->pages[p].reset(page->empty() ? (delete page, nullptr) : page);
+            dirty[p] = false;
+        }
+        dirty_pages.clear();
+        img->count = count();
+        image.reset(img);
+        return image;
+    }
+
+    // Moves the entries of a snapshot's image into the map itself.
+    FORCE_INLINE void thaw() const {
+        if (frozen.load(std::memory_order_acquire)) {
+            const_cast<MultiHashMap*>(this)->thaw_slow();
+        }
+    }
+
+    void thaw_slow() {
+        std::lock_guard<std::mutex> lock(thaw_lock);
+        if (!frozen.load(std::memory_order_relaxed)) return;
+
+        const std::vector<std::shared_ptr<const typename Image::Page>>& pages = frozen_image->pages;
+        for (size_t p = 0; p < pages.size(); p++) {
+            if (pages[p] == nullptr) continue;
+            for (size_t i = 0; i < pages[p]->size(); i++) {
+                const T& e = (*pages[p])[i];
+                insert(e, primary_index->computeHash(e));
+            }
+        }
+        frozen_image.reset();
+        frozen.store(false, std::memory_order_release);
+    }
+
+    FORCE_INLINE void insert(const T& elem, HASH_RES_t h) {
+        T *cur = entries.add(elem);
+        touch(cur);
+
+        primary_index->insert(cur, h);
+        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
+            secondary_indexes[i]->insert(cur);
+    }
+
+
+    FORCE_INLINE void del(T* elem, HASH_RES_t h) { // assume the element is already in the map and mainIdx=0
+        assert(elem != nullptr);    // and elem is in the map
+
+        touch(elem);
+        primary_index->del(elem, h);
+        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
+            secondary_indexes[i]->del(elem);
+
+        // the last entry moves into the slot of 'elem'
+        T* moved = entries.last();
+        if (moved != elem) {
+            if (tracking) { mark_dirty(SlotArray<T>::slot(moved) / SNAPSHOT_PAGE_SIZE); }
+            primary_index->relocate(moved, elem, primary_index->computeHash(*moved));
+            for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
+                secondary_indexes[i]->relocate(moved, elem);
+        }
+        entries.remove(elem);
+    }    
+
+  public:
+
+    MultiHashMap() : tracking(false), frozen(false), change_history_keys(0), change_log_start(0) { 
+        primary_index = new PRIMARY_INDEX();
+        secondary_indexes = new SecondaryIndex<T>*[sizeof...(SECONDARY_INDEXES)] { new SECONDARY_INDEXES()...};
+    }
+
+    MultiHashMap(size_t init_capacity) : tracking(false), frozen(false), change_history_keys(0), change_log_start(0) {
+        primary_index = new PRIMARY_INDEX(init_capacity);
+        secondary_indexes = new SecondaryIndex<T>*[sizeof...(SECONDARY_INDEXES)] { new SECONDARY_INDEXES(init_capacity)...};
+    }
+
+    // Takes a snapshot of 'other'. The copy shares an image of the entries
+    // with 'other' (see SnapshotImage) and costs time proportional to the
+    // pages written since the previous snapshot. The entries are inserted
+    // into the copy only once it is used as a map.
+    MultiHashMap(const MultiHashMap &other) : MultiHashMap() {
+        if (other.frozen.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(const_cast<MultiHashMap&>(other).thaw_lock);
+            frozen_image = other.frozen_image;
+        }
+        if (frozen_image == nullptr) { frozen_image = other.take_image(); }
+        frozen.store(true, std::memory_order_relaxed);
+    }
+
+    virtual ~MultiHashMap() {
+        if (primary_index != nullptr) {
+            delete primary_index;
+            primary_index = nullptr;    
+        }
+        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++) {
+            if (secondary_indexes[i] != nullptr) {
+                delete secondary_indexes[i];
+            }            
+        }
+        delete[] secondary_indexes;
+        secondary_indexes = nullptr;
+    }
+
+    FORCE_INLINE size_t count() const {
+        if (frozen.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(const_cast<MultiHashMap*>(this)->thaw_lock);
+            if (frozen_image != nullptr) { return frozen_image->count; }
+        }
+        return primary_index->count();
+    }
+
+    // The first entry of the map; the others follow through next(). Scans go
+    // from the last slot to the first, so that entries inserted during a scan 
+    // are not visited, and deleting the current entry moves an entry that
+    // has already been visited into its slot.
+    FORCE_INLINE T* first() const {
+        thaw();
+        return entries.last();
+    }
+
+    FORCE_INLINE T* next(const T* elem) const {
+        return entries.prev(elem);
+    }
+
+    FORCE_INLINE const T* get(const T& key) const {
+        thaw();
+        return primary_index->get(key);
+    }
+
+    FORCE_INLINE const V& getValueOrDefault(const T& key) const {
+        thaw();
+        T* elem = primary_index->get(key);
+        return (elem != nullptr ? elem->__av : Zero);
+    }
+
+    FORCE_INLINE const SecondaryIdxNode<T>* slice(const T& k, size_t idx) {
+        thaw();
+        return secondary_indexes[idx]->slice(k);
+    }    
+
+    // Prefetches the bucket of a later get(key), so that the lookup overlaps
+    // with other work, e.g., the processing of the preceding entries of a batch.
+    FORCE_INLINE void prefetch(const T& key) const {
+        thaw();
+        primary_index->prefetchBucket(primary_index->computeHash(key));
+    }
+
+    FORCE_INLINE void prefetchSlice(const T& key, size_t idx) const {
+        thaw();
+        secondary_indexes[idx]->prefetch(key);
+    }
+    
+    FORCE_INLINE void del(const T& k) {
+        thaw();
+        HASH_RES_t h = primary_index->computeHash(k);
+        T *elem = primary_index->get(k, h);
+        if (elem != nullptr) { del(elem, h); }
+    }
+
+    FORCE_INLINE void insert(const T& k) {
+        thaw();
+        insert(k, primary_index->computeHash(k));
+    }
+
+    FORCE_INLINE void add(T& k, const V& v) {
+        if (ZeroValue<V>().isZero(v)) { return; }
+        thaw();
+
+        HASH_RES_t h = primary_index->computeHash(k);
+        T* elem = primary_index->get(k, h);
+        if (elem != nullptr) { 
+            elem->__av += v; 
+            touch(elem);
+        }
+        else {
+            k.__av = v;
+            insert(k, h);
+        }
+    }
+
+    FORCE_INLINE void addOrDelOnZero(T& k, const V& v) {
+        if (ZeroValue<V>().isZero(v)) { return; }
+        thaw();
+
+        HASH_RES_t h = primary_index->computeHash(k);
+        T* elem = primary_index->get(k, h);
+        if (elem != nullptr) {
+            elem->__av += v;
+            if (ZeroValue<V>().isZero(elem->__av)) { del(elem, h); }
+            else { touch(elem); }
+        }
+        else {
+            k.__av = v;
+            insert(k, h);
+        }
+    }
+
+    FORCE_INLINE void setOrDelOnZero(T& k, const V& v) {
+        thaw();
+        HASH_RES_t h = primary_index->computeHash(k);
+        T* elem = primary_index->get(k, h);
+        if (elem != nullptr) {
+            if (ZeroValue<V>().isZero(v)) { del(elem, h); }
+            else { 
+                elem->__av = v; 
+                touch(elem);
+            }
+        }
+        else if (!ZeroValue<V>().isZero(v)) {
+            k.__av = v;
+            insert(k, h);
+        }
+    }
+
+    FORCE_INLINE void clear() {
+        thaw();
+        if (primary_index->count() == 0) return;
+
+        if (tracking) { mark_all_dirty(); }
+        if (changed_keys != nullptr) {
+            for (T* elem = first(); elem != nullptr; elem = next(elem)) { touch(elem); }
+        }
+        // clearing the buckets of all entries clears an index as well
+        size_t n = entries.count();
+        if (n * CLEAR_SPARSE_RATIO < primary_index->buckets()) {
+            PRIMARY_INDEX* idx = primary_index;
+            entries.scan(0, n, [idx](const T& e) { idx->clearBucket(&e); });
+        }
+        else { primary_index->clear(); }
+        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++) {
+            SecondaryIndex<T>* idx = secondary_indexes[i];
+            if (n * CLEAR_SPARSE_RATIO < idx->buckets()) {
+                entries.scan(0, n, [idx](const T& e) { idx->clearBucket(&e); });
+            }
+            else { idx->clear(); }
+        }
+        entries.clear();
+    }
+
+    /**
+     * Closes the changes of the current epoch under the number 'epoch' and
+     * starts a new one. The first call starts the change log; changes are
+     * known for epochs after that point, until the log grows past twice the
+     * size of the map and its oldest epochs are dropped.
+     */
+    void log_changes(unsigned long epoch) {
+        thaw();
+        if (changed_keys == nullptr) {
+            changed_keys.reset(new KeySet());
+            change_log_start = epoch;
+            return;
+        }
+        unsigned long last = (change_history.empty() ? change_log_start : change_history.back().first);
+        if (epoch <= last) return;
+
+        change_history_keys += changed_keys->count();
+        change_history.push_back(std::make_pair(epoch, std::move(changed_keys)));
+        changed_keys.reset(new KeySet());
+
+        size_t limit = 2 * std::max(count(), (size_t) 1024);
+        while (change_history_keys > limit) {
+            change_history_keys -= change_history.front().second->count();
+            change_log_start = change_history.front().first;
+            change_history.pop_front();
+        }
+    }
+
+    // Whether the changes made after epoch 'since' are all in the log.
+    FORCE_INLINE bool has_changes_since(unsigned long since) const {
+        return (changed_keys != nullptr && since >= change_log_start);
+    }
+
+    /**
+     * Inserts into 'out' the entries whose keys were written after epoch
+     * 'since' (up to the last closed epoch), with their current values;
+     * removed entries have a zero value. Inserts all entries if these
+     * changes are not in the log.
+     */
+    void get_changes_since(unsigned long since, MultiHashMap& out) const {
+        thaw();
+        if (!has_changes_since(since)) {
+            for (T* elem = first(); elem != nullptr; elem = next(elem)) { out.insert(*elem); }
+            return;
+        }
+        for (size_t b = change_history.size(); b-- > 0 && change_history[b].first > since; ) {
+            const KeySet& keys = *change_history[b].second;
+            for (T* key = keys.first(); key != nullptr; key = keys.next(key)) {
+                if (out.get(*key) != nullptr) continue;
+                T* elem = primary_index->get(*key);
+                if (elem != nullptr) { 
+                    out.insert(*elem); 
+                }
+                else {
+                    T removed(*key);
+                    removed.__av = Zero;
+                    out.insert(removed);
+                }
+            }
+        }
+    }
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int version) const {
+        std::shared_ptr<const Image> img;
+        if (frozen.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(const_cast<MultiHashMap*>(this)->thaw_lock);
+            img = frozen_image;
+        }
+        if (img != nullptr) {
+            // pages in reverse, as in a scan of the map
+            ar << "\n\t\t";
+            dbtoaster::serialize_nvp(ar, "count", img->count);
+            for (size_t p = img->pages.size(); p-- > 0; ) {
+                if (img->pages[p] == nullptr) continue;
+                const typename Image::Page& page = *img->pages[p];
+                for (size_t i = page.size(); i-- > 0; ) {
+                    ar << "\n";
+                    dbtoaster::serialize_nvp_tabbed(ar, "item", page[i], "\t\t");
+                }
+            }
+            return;
+        }
+        ar << "\n\t\t";
+        dbtoaster::serialize_nvp(ar, "count", count());
+        for (const T* elem = first(); elem != nullptr; elem = next(elem)) {
+            ar << "\n";
+            dbtoaster::serialize_nvp_tabbed(ar, "item", *elem, "\t\t");
+        }
+    }
+};
+
+/**
+ * Map that stores its entries inline, in the slots of an open-addressing
+ * table, instead of allocating them from a pool and indexing them by
+ * pointer. Meant for maps whose entries are small and of fixed size and
+ * that have no secondary indices: a lookup touches a group of control
+ * bytes (as in SwissPrimaryHashIndex, 16 per group) and the entry itself,
+ * and iteration walks the slots in memory order. Entries need no nxt/prv
+ * links; iterate with first() and next(). Entries move when the table
+ * grows, so pointers returned by get(), first() and next() are valid only
+ * until the next insertion.
+ */
+template <typename T, typename V, typename IDX_FN = T>
+class FlatHashMap {
+  private:
+    char* memory_;
+    int8_t* ctrl_;          // 16-byte aligned, one byte per slot
+    T* slots_;
+
+    size_t group_mask_;
+    double load_factor_;
+    size_t threshold_;      // bound on count_ + deleted_
+    size_t count_;
+    size_t deleted_;
+
+    FORCE_INLINE size_t capacity() const {
+        return (group_mask_ + 1) * 16;
+    }
+
+    // The slot holding an entry equal to 'key', or nullptr
+    FORCE_INLINE T* find_(const T& key, HASH_RES_t m) const {
+        int8_t t = (int8_t) (m & 0x7F);
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            const int8_t* ctrl = ctrl_ + g * 16;
+            for (unsigned hit = swiss_match(ctrl, t); hit; hit &= hit - 1) {
+                T* elem = slots_ + g * 16 + __builtin_ctz(hit);
+                if (IDX_FN::equals(key, *elem)) return elem;
+            }
+            if (swiss_match(ctrl, SWISS_EMPTY)) return nullptr;
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    // Copies 'elem' into the first free slot of its probe sequence
+    FORCE_INLINE T* place_(const T& elem, HASH_RES_t m) {
+        size_t g = (m >> 7) & group_mask_;
+        for (size_t i = 1; ; i++) {
+            unsigned free = swiss_match_free(ctrl_ + g * 16);
+            if (free) {
+                size_t s = g * 16 + __builtin_ctz(free);
+                if (ctrl_[s] == SWISS_DELETED) { deleted_--; }
+                ctrl_[s] = (int8_t) (m & 0x7F);
+                return new (slots_ + s) T(elem);
+            }
+            g = (g + i) & group_mask_;
+        }
+    }
+
+    void allocate_(size_t num_groups) {
+        size_t capacity = num_groups * 16;
+        memory_ = new char[capacity + 16 + capacity * sizeof(T) + alignof(T)];
+        ctrl_ = reinterpret_cast<int8_t*>((reinterpret_cast<size_t>(memory_) + 15) & ~(size_t) 15);
+        slots_ = reinterpret_cast<T*>((reinterpret_cast<size_t>(ctrl_ + capacity) + alignof(T) - 1) & ~(alignof(T) - 1));
+        memset(ctrl_, SWISS_EMPTY, capacity);
+        group_mask_ = num_groups - 1;
+        threshold_ = std::min(capacity - 1, (size_t) (capacity * load_factor_));
+        deleted_ = 0;
+    }
+
+    void resize_(size_t num_groups) {
+        char* old_memory = memory_;
+        const int8_t* old_ctrl = ctrl_;
+        T* old_slots = slots_;
+        size_t old_capacity = capacity();
+
+        allocate_(num_groups);
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] >= 0) { 
+                place_(old_slots[i], swiss_mix(IDX_FN::hash(old_slots[i]))); 
+                old_slots[i].~T();
+            }
+        }
+        delete[] old_memory;
+    }
+
+    void destroy_all_() {
+        if (std::is_trivially_destructible<T>::value) return;
+        for (T* elem = first(); elem != nullptr; elem = next(elem)) { elem->~T(); }
+    }
+
+    FORCE_INLINE void insert(const T& elem, HASH_RES_t h) {
+        if (count_ + deleted_ >= threshold_) {
+            // rehash in place when most of the load is tombstones
+            resize_(deleted_ > count_ ? group_mask_ + 1 : (group_mask_ + 1) << 1);
+        }
+        place_(elem, swiss_mix(h));
+        count_++;
+    }
+
+    FORCE_INLINE void del(T* elem) {
+        size_t s = elem - slots_;
+        elem->~T();
+        // No probe sequence continues past a group that has an empty
+        // slot, so the slot can become empty again.
+        if (swiss_match(ctrl_ + (s & ~(size_t) 15), SWISS_EMPTY)) {
+            ctrl_[s] = SWISS_EMPTY;
+        }
+        else {
+            ctrl_[s] = SWISS_DELETED;
+            deleted_++;
+        }
+        count_--;
+    }
+
+    // The first occupied slot at or after slot 'i', or nullptr
+    FORCE_INLINE T* from_(size_t i) const {
+        size_t g = i & ~(size_t) 15;
+        if (g > group_mask_ * 16) return nullptr;
+        unsigned full = ~swiss_match_free(ctrl_ + g) & (0xFFFFu << (i - g)) & 0xFFFF;
+        return (full ? slots_ + g + __builtin_ctz(full) : from_group_(g + 16));
+    }
+
+    T* from_group_(size_t g) const {
+        for (size_t end = capacity(); g < end; g += 16) {
+            unsigned full = ~swiss_match_free(ctrl_ + g) & 0xFFFF;
+            if (full) return slots_ + g + __builtin_ctz(full);
+        }
+        return nullptr;
+    }
+
+  public:
+
+    const V Zero = ZeroValue<V>().get();
+
+    FlatHashMap(size_t init_capacity = DEFAULT_CHUNK_SIZE, double load_factor = 0.875) 
+            : load_factor_(load_factor), count_(0) {
+        size_t num_groups = 1;
+        while (num_groups * 16 * load_factor_ < init_capacity) num_groups <<= 1;
+        allocate_(num_groups);
+    }
+
+    FlatHashMap(const FlatHashMap& other) : load_factor_(other.load_factor_), count_(other.count_) {
+        allocate_(other.group_mask_ + 1);
+        memcpy(ctrl_, other.ctrl_, capacity());
+        for (const T* elem = other.first(); elem != nullptr; elem = other.next(elem)) {
+            new (slots_ + (elem - other.slots_)) T(*elem);
+        }
+        deleted_ = other.deleted_;
+    }
+
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    virtual ~FlatHashMap() {
+        destroy_all_();
+        delete[] memory_;
     }
 
-    // deletes an existing elements (equality by pointer comparison)
-    FORCE_INLINE void del(const T* obj, const HASH_RES_t h) {
-        assert(obj != nullptr);
+    FORCE_INLINE size_t count() const {
+        return count_;
+    }
 
-        IdxNode* dst = buckets_ + (h & index_mask_);
-        IdxNode* prev = nullptr;
-        IdxNode* next;
+    // The first entry of the map; the others follow through next().
+    FORCE_INLINE T* first() const {
+        return from_(0);
+    }
 
-        do {
-            next = dst->nxt;
-            if (dst->obj && h == dst->hash && IDX_FN::equals(*obj, *dst->obj)) {
+    FORCE_INLINE T* next(const T* elem) const {
+        size_t i = elem - slots_ + 1;
+        // the next slot is usually occupied
+        return ((i & 15) != 0 && ctrl_[i] >= 0 ? slots_ + i : from_(i));
+    }
 
-                // pointer comparison is sufficient as all objects are stored in pool
-                if (dst->obj == obj) {
-                    // delete the first element of slice
-                    IdxNode* child = dst->child;
-                    if (child != nullptr) {
-                        dst->obj = child->obj;
-                        dst->hash = child->hash;
-                        // dst->nxt remains unchanged
-                        dst->child = child->nxt;
-                        assert(child->child == nullptr);
-                        pool_.del(child);
-                    }
-                    else {
-                        if (prev != nullptr) {  // element in linked list (and not in bucket itself)
-                            prev->nxt = next;
-                            pool_.del(dst);
-                        }
-                        else if (next != nullptr) {  // element in bucket, and there are other elements in linked list
-                            dst->obj = next->obj;
-                            dst->hash = next->hash;
-                            dst->nxt = next->nxt;
-                            dst->child = next->child;
-                            pool_.del(next);
-                        }
-                        else {   // the only element in bucket
-                            dst->obj = nullptr;
-                            dst->hash = 0;
-                            dst->nxt = nullptr;
-                            dst->child = nullptr;
-                        }
-                        count_--;
-                    }
-                }
-                else {
-                    IdxNode* head = dst;
-                    prev = dst;
-                    dst = dst->child;
-                    while (dst != nullptr) {
-                        if (dst->obj == obj) {
-                            if (prev == head) { head->child = dst->nxt; }
-                            else { prev->nxt = dst->nxt; }
-                            pool_.del(dst);
-                            return;
-                        }
-                        prev = dst;
-                        dst = dst->nxt;
-                    }
-                }
-                return;
-            }
-            prev = dst;
-        } while ((dst = next));
+    FORCE_INLINE const T* get(const T& key) const {
+        return find_(key, swiss_mix(IDX_FN::hash(key)));
     }
 
-    FORCE_INLINE void del(const T* obj) {
-        if (obj != nullptr) { del(obj, IDX_FN::hash(*obj)); }
+    FORCE_INLINE const V& getValueOrDefault(const T& key) const {
+        T* elem = find_(key, swiss_mix(IDX_FN::hash(key)));
+        return (elem != nullptr ? elem->__av : Zero);
     }
 
-    FORCE_INLINE void clear() {
-        if (count_ == 0) return;
+    // Prefetches the control bytes and the first slots of the group probed
+    // first by a later get(key).
+    FORCE_INLINE void prefetch(const T& key) const {
+        size_t g = (swiss_mix(IDX_FN::hash(key)) >> 7) & group_mask_;
+        __builtin_prefetch(ctrl_ + g * 16);
+        __builtin_prefetch(slots_ + g * 16);
+    }
 
-        for (size_t i = 0; i < size_; i++) {
-            buckets_[i].obj = nullptr;
-            buckets_[i].hash = 0;
-            if (buckets_[i].nxt != nullptr) {                
-                // Delete all children
-                IdxNode* dst = buckets_[i].nxt;
-                do {
-                    if (dst->child != nullptr) {
-                        pool_.delete_all(dst->child);
-                        // dst->child = nullptr;
-                    }
-                } while ((dst = dst->nxt));
-                pool_.delete_all(buckets_[i].nxt);
-                buckets_[i].nxt = nullptr;
-            }
-            if (buckets_[i].child != nullptr) {
-                pool_.delete_all(buckets_[i].child);
-                buckets_[i].child = nullptr;
-            }
+    FORCE_INLINE void del(const T& k) {
+        T* elem = find_(k, swiss_mix(IDX_FN::hash(k)));
+        if (elem != nullptr) { del(elem); }
+    }
+
+    FORCE_INLINE void insert(const T& k) {
+        insert(k, IDX_FN::hash(k));
+    }
+
+    FORCE_INLINE void add(T& k, const V& v) {
+        if (ZeroValue<V>().isZero(v)) { return; }
+
+        HASH_RES_t h = IDX_FN::hash(k);
+        T* elem = find_(k, swiss_mix(h));
+        if (elem != nullptr) { 
+            elem->__av += v; 
+        }
+        else {
+            k.__av = v;
+            insert(k, h);
+        }
+    }
+
+    FORCE_INLINE void addOrDelOnZero(T& k, const V& v) {
+        if (ZeroValue<V>().isZero(v)) { return; }
+
+        HASH_RES_t h = IDX_FN::hash(k);
+        T* elem = find_(k, swiss_mix(h));
+        if (elem != nullptr) {
+            elem->__av += v;
+            if (ZeroValue<V>().isZero(elem->__av)) { del(elem); }
+        }
+        else {
+            k.__av = v;
+            insert(k, h);
+        }
+    }
+
+    FORCE_INLINE void setOrDelOnZero(T& k, const V& v) {
+        HASH_RES_t h = IDX_FN::hash(k);
+        T* elem = find_(k, swiss_mix(h));
+        if (elem != nullptr) {
+            if (ZeroValue<V>().isZero(v)) { del(elem); }
+            else { elem->__av = v; }
+        }
+        else if (!ZeroValue<V>().isZero(v)) {
+            k.__av = v;
+            insert(k, h);
         }
+    }
+
+    FORCE_INLINE void clear() {
+        if (count_ == 0 && deleted_ == 0) return;
+
+        destroy_all_();
+        memset(ctrl_, SWISS_EMPTY, capacity());
         count_ = 0;
+        deleted_ = 0;
+    }
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int version) const {
+        ar << "\n\t\t";
+        dbtoaster::serialize_nvp(ar, "count", count());
+        for (const T* elem = first(); elem != nullptr; elem = next(elem)) {
+            ar << "\n";
+            dbtoaster::serialize_nvp_tabbed(ar, "item", *elem, "\t\t");
+        }
     }
 };
 
-template <typename T, typename V, typename PRIMARY_INDEX, typename... SECONDARY_INDEXES> 
-class MultiHashMap {
+#define TINY_MAP_CAPACITY 8
+
+/**
+ * Map for views with a handful of entries, e.g., aggregates grouped by a few
+ * flags. Up to N (at most 16) entries are stored inline, one after another,
+ * each with a 7-bit tag of its hash in a group of control bytes as in 
+ * SwissPrimaryHashIndex. A lookup compares the tags of all entries at once 
+ * and calls IDX_FN::equals only on the entries whose tag matches, without
+ * allocating or branching on every entry. Inserting one more entry moves all entries into a map of type LARGE (a MultiHashMap 
+ * or a FlatHashMap of the same entries), which serves all operations from 
+ * then on. As in MultiHashMap, scans go from the last entry to the first and 
+ * deleting an entry moves the last one into its place.
+ */
+template <typename T, typename V, typename IDX_FN, typename LARGE, size_t N = TINY_MAP_CAPACITY>
+class TinyMap {
   private:
-    Pool<T> pool;
-    PRIMARY_INDEX* primary_index;
-    SecondaryIndex<T>** secondary_indexes;
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    static_assert(N <= 16, "the tags of a TinyMap fit one control group");
+
+    alignas(16) int8_t tags_[16];   // SWISS_EMPTY past the last entry
+    Storage entries_[N];
+    size_t count_;
+    LARGE* large_;          // set once the map outgrows the inline entries
+
+    // Change log of the inline entries (see log_changes): the keys removed 
+    // since the log started, each with the epoch that closed its removal 
+    // (0 for the current epoch).
+    bool logging_;
+    unsigned long log_start_;
+    std::vector<std::pair<unsigned long, T>> removed_;
 
     const V Zero = ZeroValue<V>().get();
 
-    FORCE_INLINE void insert(const T& elem, HASH_RES_t h) {
-        T *cur = pool.add();
-        new (cur) T(elem);
+    FORCE_INLINE T* at_(size_t i) const {
+        return reinterpret_cast<T*>(const_cast<Storage*>(entries_ + i));
+    }
 
-        cur->prv = nullptr;
-        cur->nxt = head;
-        if (head != nullptr) { head->prv = cur; }
-        head = cur;
+    // the low bits of generated hashes differ among a few small keys already
+    FORCE_INLINE static int8_t tag_(const T& key) {
+        HASH_RES_t h = IDX_FN::hash(key);
+        return (int8_t) ((h ^ (h >> 7) ^ (h >> 14)) & 0x7F);
+    }
 
-        primary_index->insert(cur, h);
-        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
-            secondary_indexes[i]->insert(cur);
+    FORCE_INLINE T* find_(const T& key, int8_t tag) const {
+        for (unsigned hit = swiss_match(tags_, tag); hit; hit &= hit - 1) {
+            T* elem = at_(__builtin_ctz(hit));
+            if (IDX_FN::equals(key, *elem)) return elem;
+        }
+        return nullptr;
     }
 
+    void promote_() {
+        logging_ = false;
+        removed_.clear();
+        large_ = new LARGE();
+        for (size_t i = 0; i < count_; i++) {
+            large_->insert(*at_(i));
+            at_(i)->~T();
+        }
+        memset(tags_, SWISS_EMPTY, sizeof(tags_));
+        count_ = 0;
+    }
 
-    FORCE_INLINE void del(T* elem, HASH_RES_t h) { // assume the element is already in the map and mainIdx=0
-        assert(elem != nullptr);    // and elem is in the map
+    FORCE_INLINE void insert_(const T& elem, int8_t tag) {
+        if (count_ == N) {
+            promote_();
+            large_->insert(elem);
+        }
+        else { 
+            tags_[count_] = tag;
+            new (at_(count_++)) T(elem); 
+        }
+    }
 
-        T* elemPrv = elem->prv;
-        T* elemNxt = elem->nxt;
+    void log_removal_(const T& key) {
+        for (size_t i = 0; i < removed_.size(); i++) {
+            if (IDX_FN::equals(key, removed_[i].second)) {
+                removed_[i].first = 0;
+                return;
+            }
+        }
+        // at most N removals are kept: the oldest epoch goes first and, if all
+        // are from the current epoch, the log starts again at the next one
+        if (removed_.size() == N) {
+            unsigned long oldest = 0;
+            for (size_t i = 0; i < N; i++) {
+                unsigned long e = removed_[i].first;
+                if (e != 0 && (oldest == 0 || e < oldest)) { oldest = e; }
+            }
+            if (oldest == 0) {
+                logging_ = false;
+                removed_.clear();
+                return;
+            }
+            removed_.erase(std::remove_if(removed_.begin(), removed_.end(),
+                [oldest](const std::pair<unsigned long, T>& r) { return r.first == oldest; }), removed_.end());
+            log_start_ = oldest;
+        }
+        removed_.push_back(std::make_pair(0UL, key));
+    }
 
-        if (elemPrv) { elemPrv->nxt = elemNxt; }
-        if (elemNxt) { elemNxt->prv = elemPrv; }
-        if (elem == head) { head = elemNxt; }
-        elem->nxt = nullptr;
-        elem->prv = nullptr;
+    FORCE_INLINE void del_(T* elem) {
+        if (logging_) { log_removal_(*elem); }
+        T* last = at_(count_ - 1);
+        if (elem != last) { 
+            *elem = std::move(*last); 
+            tags_[elem - at_(0)] = tags_[count_ - 1];
+        }
+        last->~T();
+        tags_[count_ - 1] = SWISS_EMPTY;
+        count_--;
+    }
 
-        primary_index->del(elem, h);
-        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
-            secondary_indexes[i]->del(elem);
-        pool.del(elem);
-    }    
+    void destroy_all_() {
+        for (size_t i = 0; i < count_; i++) { at_(i)->~T(); }
+        memset(tags_, SWISS_EMPTY, sizeof(tags_));
+        count_ = 0;
+    }
 
   public:
 
-    T *head;
-
-    MultiHashMap() : head(nullptr) { 
-        primary_index = new PRIMARY_INDEX();
-        secondary_indexes = new SecondaryIndex<T>*[sizeof...(SECONDARY_INDEXES)] { new SECONDARY_INDEXES()...};
+    TinyMap() : count_(0), large_(nullptr), logging_(false), log_start_(0) { 
+        memset(tags_, SWISS_EMPTY, sizeof(tags_));
     }
 
-    MultiHashMap(size_t init_capacity) : head(nullptr) {
-        primary_index = new PRIMARY_INDEX(init_capacity);
-        secondary_indexes = new SecondaryIndex<T>*[sizeof...(SECONDARY_INDEXES)] { new SECONDARY_INDEXES(init_capacity)...};
+    TinyMap(const TinyMap& other) 
+        : count_(other.count_), large_(nullptr), logging_(other.logging_),
+          log_start_(other.log_start_), removed_(other.removed_) {
+        if (other.large_ != nullptr) { large_ = new LARGE(*other.large_); }
+        memcpy(tags_, other.tags_, sizeof(tags_));
+        for (size_t i = 0; i < count_; i++) { new (at_(i)) T(*other.at_(i)); }
     }
 
-    MultiHashMap(const MultiHashMap &other) : MultiHashMap() {
-        T *tmp = other.head;
-        while (tmp) {
-            insert(*tmp);
-            tmp = tmp->nxt;
-        }
-    }
+    TinyMap& operator=(const TinyMap&) = delete;
 
-    virtual ~MultiHashMap() {
-        pool.clear();
-        if (primary_index != nullptr) {
-            delete primary_index;
-            primary_index = nullptr;    
-        }
-        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++) {
-            if (secondary_indexes[i] != nullptr) {
-                delete secondary_indexes[i];
-            }            
+    virtual ~TinyMap() {
+        destroy_all_();
+        if (large_ != nullptr) {
+            delete large_;
+            large_ = nullptr;
         }
-        delete[] secondary_indexes;
-        secondary_indexes = nullptr;
     }
 
     FORCE_INLINE size_t count() const {
-        return primary_index->count();
+        return (large_ == nullptr ? count_ : large_->count());
+    }
+
+    // The first entry of the map; the others follow through next().
+    FORCE_INLINE T* first() const {
+        if (large_ != nullptr) { return large_->first(); }
+        return (count_ > 0 ? at_(count_ - 1) : nullptr);
+    }
+
+    FORCE_INLINE T* next(const T* elem) const {
+        if (large_ != nullptr) { return large_->next(elem); }
+        return (elem != at_(0) ? const_cast<T*>(elem) - 1 : nullptr);
     }
 
     FORCE_INLINE const T* get(const T& key) const {
-      return primary_index->get(key);
+        return (large_ == nullptr ? find_(key, tag_(key)) : large_->get(key));
     }
 
     FORCE_INLINE const V& getValueOrDefault(const T& key) const {
-        T* elem = primary_index->get(key);
+        if (large_ != nullptr) { return large_->getValueOrDefault(key); }
+        T* elem = find_(key, tag_(key));
         return (elem != nullptr ? elem->__av : Zero);
     }
 
-    FORCE_INLINE const SecondaryIdxNode<T>* slice(const T& k, size_t idx) {
-        return secondary_indexes[idx]->slice(k);
-    }    
-    
+    // the inline entries are in cache already
+    FORCE_INLINE void prefetch(const T& key) const {
+        if (large_ != nullptr) { large_->prefetch(key); }
+    }
+
     FORCE_INLINE void del(const T& k) {
-        HASH_RES_t h = primary_index->computeHash(k);
-        T *elem = get(k, h);
-        if (elem != nullptr) { del(elem, h); }
+        if (large_ != nullptr) { large_->del(k); return; }
+        T* elem = find_(k, tag_(k));
+        if (elem != nullptr) { del_(elem); }
     }
 
     FORCE_INLINE void insert(const T& k) {
-        insert(k, primary_index->computeHash(k));
+        if (large_ != nullptr) { large_->insert(k); return; }
+        insert_(k, tag_(k));
     }
 
     FORCE_INLINE void add(T& k, const V& v) {
+        if (large_ != nullptr) { large_->add(k, v); return; }
         if (ZeroValue<V>().isZero(v)) { return; }
 
-        HASH_RES_t h = primary_index->computeHash(k);
-        T* elem = primary_index->get(k, h);
+        int8_t tag = tag_(k);
+        T* elem = find_(k, tag);
         if (elem != nullptr) { 
             elem->__av += v; 
         }
         else {
             k.__av = v;
-            insert(k, h);
+            insert_(k, tag);
         }
     }
 
     FORCE_INLINE void addOrDelOnZero(T& k, const V& v) {
+        if (large_ != nullptr) { large_->addOrDelOnZero(k, v); return; }
         if (ZeroValue<V>().isZero(v)) { return; }
 
-        HASH_RES_t h = primary_index->computeHash(k);
-        T* elem = primary_index->get(k, h);
+        int8_t tag = tag_(k);
+        T* elem = find_(k, tag);
         if (elem != nullptr) {
             elem->__av += v;
-            if (ZeroValue<V>().isZero(elem->__av)) { del(elem, h); }
+            if (ZeroValue<V>().isZero(elem->__av)) { del_(elem); }
         }
         else {
             k.__av = v;
-            insert(k, h);
+            insert_(k, tag);
         }
     }
 
     FORCE_INLINE void setOrDelOnZero(T& k, const V& v) {
-        HASH_RES_t h = primary_index->computeHash(k);
-        T* elem = primary_index->get(k, h);
+        if (large_ != nullptr) { large_->setOrDelOnZero(k, v); return; }
+
+        int8_t tag = tag_(k);
+        T* elem = find_(k, tag);
         if (elem != nullptr) {
-            if (ZeroValue<V>().isZero(v)) { del(elem, h); }
+            if (ZeroValue<V>().isZero(v)) { del_(elem); }
             else { elem->__av = v; }
         }
         else if (!ZeroValue<V>().isZero(v)) {
             k.__av = v;
-            insert(k, h);
+            insert_(k, tag);
         }
     }
 
+    // keeps LARGE once the map has moved there
     FORCE_INLINE void clear() {
-        if (primary_index->count() == 0) return;
+        if (large_ != nullptr) { large_->clear(); return; }
+        if (logging_) {
+            for (size_t i = 0; i < count_ && logging_; i++) { log_removal_(*at_(i)); }
+        }
+        destroy_all_();
+    }
+
+    /**
+     * Change log as in MultiHashMap, for a LARGE that has one. While the 
+     * entries are inline, only removals are logged and all entries count as 
+     * changed; the log of LARGE starts at the first epoch after promotion.
+     */
+    void log_changes(unsigned long epoch) {
+        if (large_ != nullptr) { large_->log_changes(epoch); return; }
+        if (!logging_) {
+            logging_ = true;
+            log_start_ = epoch;
+            return;
+        }
+        for (size_t i = 0; i < removed_.size(); i++) {
+            if (removed_[i].first == 0) { removed_[i].first = epoch; }
+        }
+    }
 
-        primary_index->clear();
-        for (size_t i = 0; i < sizeof...(SECONDARY_INDEXES); i++)
-            secondary_indexes[i]->clear();
-        pool.delete_all(head);
-        head = nullptr;
+    FORCE_INLINE bool has_changes_since(unsigned long since) const {
+        if (large_ != nullptr) { return large_->has_changes_since(since); }
+        return (logging_ && since >= log_start_);
+    }
+
+    void get_changes_since(unsigned long since, TinyMap& out) const {
+        if (large_ != nullptr) {
+            if (out.large_ == nullptr) { out.promote_(); }
+            large_->get_changes_since(since, *out.large_);
+            return;
+        }
+        for (size_t i = 0; i < count_; i++) { out.insert(*at_(i)); }
+        if (!has_changes_since(since)) return;
+        for (size_t i = 0; i < removed_.size(); i++) {
+            if (removed_[i].first <= since || out.get(removed_[i].second) != nullptr) continue;
+            T removed(removed_[i].second);
+            removed.__av = Zero;
+            out.insert(removed);
+        }
     }
 
     template <class Archive>
     void serialize(Archive &ar, const unsigned int version) const {
+        if (large_ != nullptr) { 
+            large_->serialize(ar, version); 
+            return;
+        }
         ar << "\n\t\t";
         dbtoaster::serialize_nvp(ar, "count", count());
-        T* elem = head;
-        while (elem) {
+        for (const T* elem = first(); elem != nullptr; elem = next(elem)) {
             ar << "\n";
             dbtoaster::serialize_nvp_tabbed(ar, "item", *elem, "\t\t");
-            elem = elem->nxt;
         }
     }
 };
@@ -988,7 +2545,8 @@ class HashIndex : public Index<T, V>
       } while ((n = next));
     }
 
-    inline virtual void foreach (std::function<void(const T &)> f) const {
+    template <typename F>
+    FORCE_INLINE void foreach (F f) const {
       for (size_t b = 0; b < size_; ++b) {
         IdxNode *n = &buckets_[b];
         do {
@@ -998,7 +2556,12 @@ class HashIndex : public Index<T, V>
       }
     }
 
-    inline virtual void slice(const T &key, std::function<void(const T &)> f) {
+    inline virtual void foreach (std::function<void(const T &)> f) const {
+      foreach<std::function<void(const T &)> >(f);
+    }
+
+    template <typename F>
+    FORCE_INLINE void slice(const T &key, F f) {
       HASH_RES_t h = IDX_FN::hash(key);
       IdxNode *n = &(buckets_[h & mask_]);
       do {
@@ -1012,6 +2575,10 @@ class HashIndex : public Index<T, V>
       } while ((n = n->nxt));
     }
 
+    inline virtual void slice(const T &key, std::function<void(const T &)> f) {
+      slice<std::function<void(const T &)> >(key, f);
+    }
+
     inline virtual void clear() {
       if (allocated_from_pool_) {
         IdxNode *head = nullptr;
@@ -1147,6 +2714,18 @@ class MultiHashMap {
   private:
     Pool<T> pool;
 
+    template <size_t I, typename F>
+    FORCE_INLINE typename std::enable_if<(I < sizeof...(INDEXES))>::type 
+    slice_(int idx, const T &key, F f) {
+      typedef typename std::tuple_element<I, std::tuple<INDEXES...> >::type IDX;
+      if (idx == (int)I) { static_cast<IDX *>(index[I])->slice(key, f); }
+      else { slice_<I + 1>(idx, key, f); }
+    }
+
+    template <size_t I, typename F>
+    FORCE_INLINE typename std::enable_if<(I == sizeof...(INDEXES))>::type 
+    slice_(int idx, const T &key, F f) { }
+
   public:
     Index<T, V> **index;
     T *head;
@@ -1286,8 +2865,8 @@ class MultiHashMap {
       pool.del(elem);
     }
 
-    inline void foreach (std::function<void(const T &)> f) const {
-      // index[0]->foreach(f);
+    template <typename F>
+    FORCE_INLINE void foreach (F f) const {
       T *tmp = head;
       while (tmp) {
         f(*tmp);
@@ -1295,8 +2874,11 @@ class MultiHashMap {
       }
     }
 
-    void slice(int idx, const T &key, std::function<void(const T &)> f) {
-      index[idx]->slice(key, f);
+    // The lambda is inlined into the slice of the index at 'idx', cast to its 
+    // type in INDEXES; for a constant idx the other comparisons fold away.
+    template <typename F>
+    FORCE_INLINE void slice(int idx, const T &key, F f) {
+      slice_<0>(idx, key, f);
     }
 
     FORCE_INLINE size_t count() const { return index[0]->count(); }
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <assert.h>
 #include <functional>
+#include <tuple>
+#include <type_traits>
 #include <string.h>
 #include "../serialization.hpp"
 #include "../hpds/pstring.hpp"
@@ -212,6 +214,10 @@ public:
 };
 #endif
 
+/*
+ * Index implementations are final: a call through the type of the index 
+ * itself, rather than through Index<T, V>, is not virtual and can be inlined.
+ */
 template<typename T, typename V>
 class Index {
 public:
@@ -255,7 +261,7 @@ public:
 };
 
 template<typename T, typename V, typename IDX_FN = T/* = GenericIndexFn<T>*/, bool is_unique = true >
-class HashIndex : public Index<T, V> {
+class HashIndex final : public Index<T, V> {
 public:
     typedef IDX_FN IFN;
 
@@ -494,11 +500,13 @@ public:
         return nullptr;
     }
 
-    FORCE_INLINE void sliceResMap(const T* key, FuncType f, T* obj) {
+    template<typename F>
+    FORCE_INLINE void sliceResMap(const T* key, F f, T* obj) {
         sliceResMap(*key, f, obj);
     }
 
-    FORCE_INLINE void sliceResMap(const T& key, FuncType f, T* obj) {
+    template<typename F>
+    FORCE_INLINE void sliceResMap(const T& key, F f, T* obj) {
         //Can't rely on primaryidx hash for slice
         std::vector<T*> entries;
         entries.push_back(obj);
@@ -513,11 +521,13 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceResMapNoUpd(const T* key, FuncType f, T* obj) {
+    template<typename F>
+    FORCE_INLINE void sliceResMapNoUpd(const T* key, F f, T* obj) {
         sliceResMapNoUpd(*key, f, obj);
     }
 
-    FORCE_INLINE void sliceResMapNoUpd(const T& key, FuncType f, T* obj) {
+    template<typename F>
+    FORCE_INLINE void sliceResMapNoUpd(const T& key, F f, T* obj) {
         //Can't rely on primaryidx hash for slice
         f(obj);
         while ((obj = obj->nxt)) {
@@ -532,7 +542,8 @@ public:
         return dataHead;
     }
 
-    FORCE_INLINE void foreachResMap(FuncType f, T * cur) {
+    template<typename F>
+    FORCE_INLINE void foreachResMap(F f, T * cur) {
         while (cur) {
             f(cur);
             cur = cur->nxt;
@@ -697,7 +708,8 @@ public:
         del(orig);
     }
 
-    FORCE_INLINE void foreach(FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void foreach(F f) {
         T* cur = dataHead;
         while (cur) {
             f(cur);
@@ -705,7 +717,12 @@ public:
         }
     }
 
-    FORCE_INLINE void foreachCopy(FuncType f) override {
+    FORCE_INLINE void foreach(FuncType f) override {
+        foreach<FuncType>(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void foreachCopy(F f) {
         std::vector<T*> entries;
         T* cur = dataHead;
         while (cur) {
@@ -718,7 +735,12 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceNoUpdate(const T* key, FuncType f) {
+    FORCE_INLINE void foreachCopy(FuncType f) override {
+        foreachCopy<FuncType>(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceNoUpdate(const T* key, F f) {
         //Can't rely on primaryidx hash for slice
         T* obj = dataHead;
         while (obj) {
@@ -729,7 +751,8 @@ public:
         }
     }
 
-    FORCE_INLINE void slice(const T* key, FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void slice(const T* key, F f) {
         //Can't rely on primaryidx hash for slice
         T* obj = dataHead;
         std::vector<T*> entries;
@@ -744,7 +767,12 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+    FORCE_INLINE void slice(const T* key, FuncType f) override {
+        slice<FuncType>(key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T* key, F f) {
         //Can't rely on primaryidx hash for slice
         std::vector<T*> entries;
         T* obj = dataHead;
@@ -761,6 +789,10 @@ public:
         }
     }
 
+    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+        sliceCopy<FuncType>(key, f);
+    }
+
     FORCE_INLINE void update(T * elem) override {
         del(elem);
         add(elem);
@@ -855,19 +887,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -881,7 +917,7 @@ public:
 //Partial specialization for non-unique HashIndex
 
 template<typename T, typename V, typename IDX_FN >
-class HashIndex<T, V, IDX_FN, false> : public Index<T, V> {
+class HashIndex<T, V, IDX_FN, false> final : public Index<T, V> {
 public:
     typedef IDX_FN IFN;
     struct IdxEquivNode;
@@ -1132,11 +1168,13 @@ public:
         return nullptr;
     }
 
-    FORCE_INLINE void sliceResMap(const T* key, FuncType f, IdxEquivNode* n) {
+    template<typename F>
+    FORCE_INLINE void sliceResMap(const T* key, F f, IdxEquivNode* n) {
         sliceResMap(*key, f, n);
     }
 
-    FORCE_INLINE void sliceResMap(const T& key, FuncType f, IdxEquivNode* e) {
+    template<typename F>
+    FORCE_INLINE void sliceResMap(const T& key, F f, IdxEquivNode* e) {
         IdxN *n = &e->head;
         std::vector<T*> entries;
         do {
@@ -1147,18 +1185,21 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceResMapNoUpd(const T* key, FuncType f, IdxEquivNode* e) {
+    template<typename F>
+    FORCE_INLINE void sliceResMapNoUpd(const T* key, F f, IdxEquivNode* e) {
         sliceResMapNoUpd(*key, f, e);
     }
 
-    FORCE_INLINE void sliceResMapNoUpd(const T& key, FuncType f, IdxEquivNode* e) {
+    template<typename F>
+    FORCE_INLINE void sliceResMapNoUpd(const T& key, F f, IdxEquivNode* e) {
         IdxN *n = &e->head;
         do {
             f(n->obj);
         } while ((n = n->nxt));
     }
 
-    FORCE_INLINE void sliceNoUpdate(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceNoUpdate(const T* key, F f) {
         HASH_RES_t h = IDX_FN::hash(*key);
         IdxEquivNode* e = &(buckets_[h % size_]);
         if (e->head.obj)
@@ -1292,7 +1333,8 @@ public:
         throw std::logic_error("Not implemented");
     }
 
-    FORCE_INLINE void slice(const T* key, FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void slice(const T* key, F f) {
         HASH_RES_t h = IDX_FN::hash(*key);
         IdxEquivNode* e = &(buckets_[h % size_]);
         std::vector<T*> entries;
@@ -1311,7 +1353,12 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+    FORCE_INLINE void slice(const T* key, FuncType f) override {
+        slice<FuncType>(key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T* key, F f) {
         HASH_RES_t h = IDX_FN::hash(*key);
         std::vector<T*> entries;
         IdxEquivNode* e = &(buckets_[h % size_]);
@@ -1331,6 +1378,10 @@ public:
         }
     }
 
+    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+        sliceCopy<FuncType>(key, f);
+    }
+
     FORCE_INLINE void update(T* elem) override {
         del(elem);
         add(elem);
@@ -1438,23 +1489,28 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceNoUpdate(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceNoUpdate(const T& key, F f) {
         sliceNoUpdate(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -1466,7 +1522,7 @@ public:
 };
 
 template<typename T, typename V, typename IDX_FN1, typename IDX_FN2, bool is_max>
-class SlicedHeapIndex : public Index<T, V> {
+class SlicedHeapIndex final : public Index<T, V> {
 public:
 
     struct __IdxHeapNode {
@@ -1875,19 +1931,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -1897,7 +1957,7 @@ public:
 };
 
 template<typename T, typename V, typename IDX_FN1, typename IDX_FN2>
-class SlicedMedHeapIndex : public Index<T, V> {
+class SlicedMedHeapIndex final : public Index<T, V> {
     struct __IdxNode;
 
     template<bool is_max>
@@ -2347,19 +2407,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -2369,7 +2433,7 @@ public:
 };
 
 template<typename T, typename V, typename IDX_FN1, typename IDX_FN2, bool is_max>
-class TreeIndex : public Index<T, V> {
+class TreeIndex final : public Index<T, V> {
 public:
 
     typedef struct __IdxTreeNode {
@@ -2919,19 +2983,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -2942,7 +3010,7 @@ public:
 };
 
 template <typename T, typename V, typename IDX_FN, size_t size>
-class ArrayIndex : public Index<T, V> {
+class ArrayIndex final : public Index<T, V> {
     T* array[size];
     bool isUsed[size];
 public:
@@ -3016,14 +3084,20 @@ public:
         del(orig);
     }
 
-    FORCE_INLINE void foreach(FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void foreach(F f) {
         for (size_t b = 0; b < size; ++b) {
             if (isUsed[b])
                 f(array[b]);
         }
     }
 
-    FORCE_INLINE void foreachCopy(FuncType f) override {
+    FORCE_INLINE void foreach(FuncType f) override {
+        foreach<FuncType>(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void foreachCopy(F f) {
         std::vector<T*> entries;
         for (size_t b = 0; b < size; ++b) {
             if (isUsed[b])
@@ -3035,6 +3109,10 @@ public:
         }
     }
 
+    FORCE_INLINE void foreachCopy(FuncType f) override {
+        foreachCopy<FuncType>(f);
+    }
+
     FORCE_INLINE void slice(const T* key, FuncType f) override {
         throw std::logic_error("Not implemented");
     }
@@ -3117,19 +3195,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -3139,7 +3221,7 @@ public:
 };
 
 template <typename T, typename V, typename IDX_FN, bool is_unique>
-class ListIndex : public Index<T, V> {
+class ListIndex final : public Index<T, V> {
 
     struct Container {
         T* obj;
@@ -3295,7 +3377,8 @@ public:
         del(orig);
     }
 
-    FORCE_INLINE void foreach(FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void foreach(F f) {
         Container *cur = head;
         while (cur != nullptr) {
             f(cur->obj);
@@ -3303,7 +3386,12 @@ public:
         }
     }
 
-    FORCE_INLINE void foreachCopy(FuncType f) override {
+    FORCE_INLINE void foreach(FuncType f) override {
+        foreach<FuncType>(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void foreachCopy(F f) {
         Container *cur = head;
         std::vector<T*> entries;
         while (cur != nullptr) {
@@ -3316,7 +3404,12 @@ public:
         }
     }
 
-    FORCE_INLINE void sliceNoUpdate(const T* key, FuncType f) {
+    FORCE_INLINE void foreachCopy(FuncType f) override {
+        foreachCopy<FuncType>(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceNoUpdate(const T* key, F f) {
         Container *cur = head;
         while (cur != nullptr) {
             if (IDX_FN::cmp(*key, *cur->obj) == 0)
@@ -3325,7 +3418,8 @@ public:
         }
     }
 
-    FORCE_INLINE void slice(const T* key, FuncType f) override {
+    template<typename F>
+    FORCE_INLINE void slice(const T* key, F f) {
         std::vector<T*> entries;
         Container *cur = head;
         while (cur != nullptr) {
@@ -3337,7 +3431,12 @@ public:
             f(e);
     }
 
-    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+    FORCE_INLINE void slice(const T* key, FuncType f) override {
+        slice<FuncType>(key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T* key, F f) {
 
         std::vector<T*> entries;
         Container *cur = head;
@@ -3354,6 +3453,10 @@ public:
         }
     }
 
+    FORCE_INLINE void sliceCopy(const T* key, FuncType f) override {
+        sliceCopy<FuncType>(key, f);
+    }
+
     FORCE_INLINE void update(T* obj) override {
         del(obj);
         add(obj);
@@ -3440,19 +3543,23 @@ public:
             return nullptr;
     }
 
-    FORCE_INLINE void slice(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
         slice(&key, f);
     }
 
-    FORCE_INLINE void sliceCopy(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T* key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
         sliceCopy(key, f);
     }
 
-    FORCE_INLINE void sliceCopyDependent(const T& key, FuncType f) {
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
         sliceCopy(&key, f);
     }
 
@@ -3468,6 +3575,128 @@ class MultiHashMap {
 private:
 
     bool *modified;
+
+    template<size_t I>
+    using IndexType = typename std::tuple_element<I, std::tuple<INDEXES...> >::type;
+
+    struct SliceOp {
+        template<typename IDX, typename F>
+        FORCE_INLINE static void apply(IDX* idx, const T* key, F f) { idx->slice(key, f); }
+    };
+
+    struct SliceCopyOp {
+        template<typename IDX, typename F>
+        FORCE_INLINE static void apply(IDX* idx, const T* key, F f) { idx->sliceCopy(key, f); }
+    };
+
+    // applies OP to index 'idx', cast to its type in INDEXES
+    template<typename OP, size_t I = 0, typename F>
+    FORCE_INLINE typename std::enable_if<(I < sizeof...(INDEXES))>::type visitIndex_(int idx, const T* key, F f) {
+        if (idx == (int) I) { OP::apply(std::get<I>(indexes_), key, f); }
+        else { visitIndex_<OP, I + 1>(idx, key, f); }
+    }
+
+    template<typename OP, size_t I, typename F>
+    FORCE_INLINE typename std::enable_if<(I == sizeof...(INDEXES))>::type visitIndex_(int idx, const T* key, F f) { }
+
+    // index[], with the static type of each index
+    std::tuple<INDEXES*...> indexes_;
+
+    template<size_t I = 0>
+    FORCE_INLINE typename std::enable_if<(I < sizeof...(INDEXES))>::type bindIndexes_() {
+        std::get<I>(indexes_) = static_cast<IndexType<I>*>(index[I]);
+        bindIndexes_<I + 1>();
+    }
+
+    template<size_t I>
+    FORCE_INLINE typename std::enable_if<(I == sizeof...(INDEXES))>::type bindIndexes_() { }
+
+    struct AddOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* obj) { idx->add(obj); }
+    };
+
+    struct DelOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* obj) { idx->del(obj); }
+    };
+
+    struct DelCopyOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, const T* obj, Index<T, V>* primary) { idx->delCopy(obj, primary); }
+    };
+
+    struct DelIfHashDiffersOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* cur, const T* elem, bool* modified) {
+            if (idx->hashDiffers(*cur, *elem)) {
+                idx->del(cur);
+                modified[idx->idxId] = true;
+            }
+        }
+    };
+
+    struct AddIfModifiedOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* cur, bool* modified) {
+            if (modified[idx->idxId]) {
+                idx->add(cur);
+                modified[idx->idxId] = false;
+            }
+        }
+    };
+
+    struct UpdateOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* obj) { idx->update(obj); }
+    };
+
+    struct UpdateCopyOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* obj, Index<T, V>* primary) { idx->updateCopy(obj, primary); }
+    };
+
+    struct UpdateCopyDependentOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx, T* obj, T* elem) { idx->updateCopyDependent(obj, elem); }
+    };
+
+    struct ClearOp {
+        template<typename IDX>
+        FORCE_INLINE static void apply(IDX* idx) { idx->clear(); }
+    };
+
+    // applies OP to every index, from the first to the last
+    template<typename OP, size_t I = 0, typename... Args>
+    FORCE_INLINE typename std::enable_if<(I < sizeof...(INDEXES))>::type forEachIndex_(Args... args) {
+        OP::apply(std::get<I>(indexes_), args...);
+        forEachIndex_<OP, I + 1>(args...);
+    }
+
+    template<typename OP, size_t I, typename... Args>
+    FORCE_INLINE typename std::enable_if<(I == sizeof...(INDEXES))>::type forEachIndex_(Args... args) { }
+
+    // applies OP to every index, from the last to the first
+    template<typename OP, size_t I = sizeof...(INDEXES) - 1, typename... Args>
+    FORCE_INLINE typename std::enable_if<(I > 0)>::type forEachIndexDesc_(Args... args) {
+        OP::apply(std::get<I>(indexes_), args...);
+        forEachIndexDesc_<OP, I - 1>(args...);
+    }
+
+    template<typename OP, size_t I, typename... Args>
+    FORCE_INLINE typename std::enable_if<(I == 0)>::type forEachIndexDesc_(Args... args) {
+        OP::apply(std::get<0>(indexes_), args...);
+    }
+
+    FORCE_INLINE T* copyToTemp_(const T* obj) const {
+        if (obj) {
+            T* ptr = obj->copy();
+            tempMem.push_back(ptr);
+            return ptr;
+        } else
+            return nullptr;
+    }
+
 public:
     Pool<T> pool;
     Index<T, V>** index;
@@ -3481,6 +3710,7 @@ public:
             index[i]->idxId = i;
             modified[i] = false;
         }
+        bindIndexes_();
     }
 
     MultiHashMap(const size_t* arrayLengths, const size_t* poolSizes) : pool(poolSizes[0]) { // by defintion index 0 is always unique
@@ -3493,6 +3723,7 @@ public:
             index[i]->idxId = i;
             modified[i] = false;
         }
+        bindIndexes_();
     }
 
     MultiHashMap(const MultiHashMap& other) { // by defintion index 0 is always unique
@@ -3504,6 +3735,7 @@ public:
             index[i]->idxId = i;
             modified[i] = false;
         }
+        bindIndexes_();
         other.index[0]->foreach([this] (const T & e) {
             this->insert_nocheck(e); });
     }
@@ -3514,33 +3746,69 @@ public:
         delete[] modified;
     }
 
-    FORCE_INLINE MultiHashMap<T, V, INDEXES...>& filter(const std::function<bool (T*)>& filterFn) {
+    template<typename F>
+    FORCE_INLINE MultiHashMap<T, V, INDEXES...>& filter(F filterFn) {
         MultiHashMap<T, V, INDEXES...>* result = new MultiHashMap<T, V, INDEXES...>();
-        index[0]->foreach([&](T * entry) {
+        foreach([&](T * entry) {
             if (filterFn(entry))
                 result->insert_nocheck(entry); //SBJ: Insert with check?
         });
         return *result;
     }
 
-    template<typename U>
-    FORCE_INLINE U fold(U zero, const std::function<U(U, T*)>& foldFn) {
+    template<typename U, typename F>
+    FORCE_INLINE U fold(U zero, F foldFn) {
         U result = zero;
-        index[0]->foreach([&](T * entry) {
+        foreach([&](T * entry) {
             result = foldFn(result, entry);
         });
         return result;
     }
 
-    template<typename T2, typename... INDEXES2>
-    FORCE_INLINE MultiHashMap<T2, V, INDEXES2...>& map(const std::function<T2* (T*)>& mapFn) {
+    template<typename T2, typename... INDEXES2, typename F>
+    FORCE_INLINE MultiHashMap<T2, V, INDEXES2...>& map(F mapFn) {
         MultiHashMap<T2, V, INDEXES2...> *result = new MultiHashMap<T2, V, INDEXES2...>();
-        index[0]->foreach([&](T * entry) {
+        foreach([&](T * entry) {
             result->insert_nocheck(mapFn(entry)); //SBJ: Insert with check?
         });
         return *result;
     }
 
+    /*
+     * get<I>() and the other methods that take the index number as a template
+     * argument call index I through its own type; the overloads that take it
+     * as an argument go through the virtual Index methods.
+     */
+    template<size_t I>
+    FORCE_INLINE T* get(const T& key) const {
+        return std::get<I>(indexes_)->get(&key);
+    }
+
+    template<size_t I>
+    FORCE_INLINE T* get(const T* key) const {
+        return std::get<I>(indexes_)->get(key);
+    }
+
+    template<size_t I>
+    FORCE_INLINE T* getCopy(const T& key) const {
+        return copyToTemp_(std::get<I>(indexes_)->get(&key));
+    }
+
+    template<size_t I>
+    FORCE_INLINE T* getCopy(const T* key) const {
+        return copyToTemp_(std::get<I>(indexes_)->get(key));
+    }
+
+    template<size_t I>
+    FORCE_INLINE T* getCopyDependent(const T& key) const {
+        return copyToTemp_(std::get<I>(indexes_)->get(&key));
+    }
+
+    template<size_t I>
+    FORCE_INLINE T* getCopyDependent(const T* key) const {
+        return copyToTemp_(std::get<I>(indexes_)->get(key));
+    }
+
     FORCE_INLINE T* get(const T& key, const size_t idx = 0) const {
         return index[idx]->get(&key);
     }
@@ -3550,43 +3818,19 @@ public:
     }
 
     FORCE_INLINE T* getCopy(const T& key, const size_t idx = 0) const {
-        T* obj = index[idx]->get(&key);
-        if (obj) {
-            T* ptr = obj->copy();
-            tempMem.push_back(ptr);
-            return ptr;
-        } else
-            return nullptr;
+        return copyToTemp_(index[idx]->get(&key));
     }
 
     FORCE_INLINE T* getCopy(const T* key, const size_t idx = 0) const {
-        T* obj = index[idx]->get(key);
-        if (obj) {
-            T* ptr = obj->copy();
-            tempMem.push_back(ptr);
-            return ptr;
-        } else
-            return nullptr;
+        return copyToTemp_(index[idx]->get(key));
     }
 
     FORCE_INLINE T* getCopyDependent(const T* key, const size_t idx = 0) const {
-        T* obj = index[idx]->get(key);
-        if (obj) {
-            T* ptr = obj->copy();
-            tempMem.push_back(ptr);
-            return ptr;
-        } else
-            return nullptr;
+        return copyToTemp_(index[idx]->get(key));
     }
 
     FORCE_INLINE T* getCopyDependent(const T& key, const size_t idx = 0) const {
-        T* obj = index[idx]->get(&key);
-        if (obj) {
-            T* ptr = obj->copy();
-            tempMem.push_back(ptr);
-            return ptr;
-        } else
-            return nullptr;
+        return copyToTemp_(index[idx]->get(&key));
     }
 
     FORCE_INLINE T* copyIntoPool(const T* e) {
@@ -3606,27 +3850,17 @@ public:
     }
 
     FORCE_INLINE void add(const T* elem) {
-        T* cur = index[0]->get(elem);
+        T* cur = std::get<0>(indexes_)->get(elem);
         if (cur == nullptr) {
             cur = copyIntoPool(elem);
-            for (size_t i = 0; i<sizeof...(INDEXES); ++i) index[i]->add(cur);
+            forEachIndex_<AddOp>(cur);
         } else {
             // cur->~T();
             // *cur=std::move(*elem);
 
-            for (size_t i = 0; i<sizeof...(INDEXES); ++i) {
-                if (index[i]->hashDiffers(*cur, *elem)) {
-                    index[i]->del(cur);
-                    modified[i] = true;
-                }
-            }
+            forEachIndex_<DelIfHashDiffersOp>(cur, elem, modified);
             new(cur) T(*elem);
-            for (size_t i = 0; i<sizeof...(INDEXES); ++i) {
-                if (modified[i]) {
-                    index[i]->add(cur);
-                    modified[i] = false;
-                }
-            }
+            forEachIndex_<AddIfModifiedOp>(cur, modified);
         }
     }
 
@@ -3636,76 +3870,115 @@ public:
 
     FORCE_INLINE void insert_nocheck(const T* elem) {
         T* cur = copyIntoPool(elem);
-        for (size_t i = 0; i<sizeof...(INDEXES); ++i) index[i]->add(cur);
+        forEachIndex_<AddOp>(cur);
     }
 
     FORCE_INLINE void del(T* elem) { // assume that the element is already in the map
-        for (size_t i = 0; i<sizeof...(INDEXES); ++i) index[i]->del(elem);
+        forEachIndex_<DelOp>(elem);
         pool.del(elem);
     }
 
     FORCE_INLINE void delCopyDependent(T* obj) {
-        T* elem = index[0]->get(obj);
-        for (size_t i = 0; i<sizeof...(INDEXES); ++i) index[i]->del(elem);
+        T* elem = std::get<0>(indexes_)->get(obj);
+        forEachIndex_<DelOp>(elem);
         pool.del(elem);
     }
 
     FORCE_INLINE void delCopy(T* obj) {
-        T* elem = index[0]->get(obj);
-        for (size_t i = sizeof...(INDEXES) - 1; i != 0; --i)
-            index[i]->delCopy(obj, index[0]);
-        index[0]->delCopy(obj, index[0]);
+        T* elem = std::get<0>(indexes_)->get(obj);
+        forEachIndexDesc_<DelCopyOp>(obj, index[0]);
         pool.del(elem);
     }
 
-    FORCE_INLINE void foreach(FuncType f) {
-        index[0]->foreach(f);
+    /*
+     * Visitors are templates, so that a lambda passed by generated code is
+     * inlined into the loop over the entries of the concrete index, rather 
+     * than called through a std::function by the virtual Index methods. 
+     * slice<I>() picks the index at compile time; slice(idx, ...) compares 
+     * idx with each position of INDEXES, which folds away for a constant idx.
+     */
+    template<typename F>
+    FORCE_INLINE void foreach(F f) {
+        std::get<0>(indexes_)->foreach(f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void foreachCopy(F f) {
+        std::get<0>(indexes_)->foreachCopy(f);
+    }
+
+    template<size_t I, typename F>
+    FORCE_INLINE void slice(const T* key, F f) {
+        std::get<I>(indexes_)->slice(key, f);
+    }
+
+    template<size_t I, typename F>
+    FORCE_INLINE void slice(const T& key, F f) {
+        std::get<I>(indexes_)->slice(&key, f);
     }
 
-    FORCE_INLINE void foreachCopy(FuncType f) {
-        index[0]->foreachCopy(f);
+    template<size_t I, typename F>
+    FORCE_INLINE void sliceCopy(const T* key, F f) {
+        std::get<I>(indexes_)->sliceCopy(key, f);
     }
 
-    void slice(int idx, const T* key, FuncType f) {
-        index[idx]->slice(key, f);
+    template<size_t I, typename F>
+    FORCE_INLINE void sliceCopy(const T& key, F f) {
+        std::get<I>(indexes_)->sliceCopy(&key, f);
     }
 
-    void slice(int idx, const T& key, FuncType f) {
-        index[idx]->slice(&key, f);
+    template<size_t I, typename F>
+    FORCE_INLINE void sliceCopyDependent(const T* key, F f) {
+        sliceCopy<I>(key, f);
     }
 
-    void sliceCopy(int idx, const T* key, FuncType f) {
-        index[idx]->sliceCopy(key, f);
+    template<size_t I, typename F>
+    FORCE_INLINE void sliceCopyDependent(const T& key, F f) {
+        sliceCopy<I>(&key, f);
     }
 
-    void sliceCopy(int idx, const T& key, FuncType f) {
-        index[idx]->sliceCopy(&key, f);
+    template<typename F>
+    FORCE_INLINE void slice(int idx, const T* key, F f) {
+        visitIndex_<SliceOp>(idx, key, f);
     }
 
-    void sliceCopyDependent(int idx, const T* key, FuncType f) {
-        index[idx]->sliceCopy(key, f);
+    template<typename F>
+    FORCE_INLINE void slice(int idx, const T& key, F f) {
+        visitIndex_<SliceOp>(idx, &key, f);
     }
 
-    void sliceCopyDependent(int idx, const T& key, FuncType f) {
-        index[idx]->sliceCopy(&key, f);
+    template<typename F>
+    FORCE_INLINE void sliceCopy(int idx, const T* key, F f) {
+        visitIndex_<SliceCopyOp>(idx, key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopy(int idx, const T& key, F f) {
+        visitIndex_<SliceCopyOp>(idx, &key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(int idx, const T* key, F f) {
+        visitIndex_<SliceCopyOp>(idx, key, f);
+    }
+
+    template<typename F>
+    FORCE_INLINE void sliceCopyDependent(int idx, const T& key, F f) {
+        visitIndex_<SliceCopyOp>(idx, &key, f);
     }
 
     FORCE_INLINE void update(T* elem) {
         if (elem == nullptr)
             return;
-        for (size_t i = 0; i < sizeof...(INDEXES); ++i) {
-            index[i]->update(elem);
-        }
+        forEachIndex_<UpdateOp>(elem);
     }
 
     FORCE_INLINE void updateCopyDependent(T* obj2) {
         if (obj2 == nullptr)
             return;
-        T* elem = index[0]->get(obj2);
+        T* elem = std::get<0>(indexes_)->get(obj2);
         T* obj = copyIntoPool(obj2);
-        for (size_t i = 0; i < sizeof...(INDEXES); ++i) {
-            index[i]->updateCopyDependent(obj, elem);
-        }
+        forEachIndex_<UpdateCopyDependentOp>(obj, elem);
     }
 
     FORCE_INLINE void updateCopy(T* obj2) {
@@ -3713,21 +3986,15 @@ public:
             return;
 
         T* obj = copyIntoPool(obj2);
-        //i >= 0 cant be used with unsigned type
-        for (size_t i = sizeof...(INDEXES) - 1; i != 0; --i) {
-            index[i]->updateCopy(obj, index[0]);
-        }
-        index[0]->updateCopy(obj, index[0]);
+        forEachIndexDesc_<UpdateCopyOp>(obj, index[0]);
     }
 
     FORCE_INLINE size_t count() const {
-        return index[0]->count();
+        return std::get<0>(indexes_)->count();
     }
 
     FORCE_INLINE void clear() {
-        for (size_t i = sizeof...(INDEXES) - 1; i != 0; --i)
-            index[i]->clear();
-        index[0]->clear();
+        forEachIndexDesc_<ClearOp>();
     }
 
     template<class Archive>
@@ -2,6 +2,7 @@
 #define DBTOASTER_POOL_HPP
 
 #include <assert.h>
+#include <stdlib.h>
 
 namespace dbtoaster
 {
@@ -41,55 +42,69 @@ namespace dbtoaster
         ~ValueElem() { next = nullptr; }
     };
 
+    /*
+     * Chunks are zeroed memory, which is what Elem() initializes an element 
+     * to, and are handed out front to back through 'fresh_'. Adding a chunk 
+     * thus takes constant time, and its pages are only touched once used.
+     */
     template<typename T>
     class Pool 
     {
         private:
-            Elem<T>* free_;
+            Elem<T>* free_;         // elements returned to the pool
             Elem<T>* data_;
+            Elem<T>* fresh_;        // elements of the last chunk never handed out
+            Elem<T>* fresh_end_;
             size_t size_;
 
             void add_chunk(size_t new_size) 
             {   // precondition: no available elements
-                assert(free_ == nullptr);
+                assert(free_ == nullptr && fresh_ == fresh_end_);
 
                 size_ = new_size;
-                Elem<T>* chunk = new Elem<T>[size_ + 1];
-                for (size_t i = 0; i < size_ - 1; i++) 
-                {
-                    chunk[i].next = &chunk[i + 1];
-                }
-                chunk[size_ - 1].next = nullptr;
+                Elem<T>* chunk = static_cast<Elem<T>*>(calloc(size_ + 1, sizeof(Elem<T>)));
                 chunk[size_].next = data_;
                 data_ = chunk;
-                free_ = chunk;
+                fresh_ = chunk;
+                fresh_end_ = chunk + size_;
+            }
+
+            // end of the elements of 'chunk', of size 'sz', handed out so far
+            FORCE_INLINE Elem<T>* used_end(Elem<T>* chunk, size_t sz) const
+            {
+                return (chunk == data_ ? fresh_ : chunk + sz);
             }
 
         public:
-            Pool(size_t chunk_size = DEFAULT_POOL_CHUNK_SIZE) : free_(nullptr), data_(nullptr) 
+            Pool(size_t chunk_size = DEFAULT_POOL_CHUNK_SIZE) 
+                : free_(nullptr), data_(nullptr), fresh_(nullptr), fresh_end_(nullptr) 
             {
                 add_chunk(chunk_size);
             }
 
             ~Pool() {
+                Elem<T>* chunk = data_;
                 size_t sz = size_;
-                while (data_ != nullptr) 
+                while (chunk != nullptr) 
                 {
-                    Elem<T>* el = data_[sz].next;
-                    delete[] data_;
-                    data_ = el;
+                    Elem<T>* el = chunk[sz].next;
+                    for (Elem<T>* e = chunk, *end = used_end(chunk, sz); e < end; e++) { e->deactivate(); }
+                    free(chunk);
+                    chunk = el;
                     sz = sz >> 1;
                 } 
             }
 
             FORCE_INLINE T* add() 
             {
-                if (free_ == nullptr) { add_chunk(size_ << 1); }
-
                 Elem<T>* el = free_;
-                free_ = free_->next;
+                if (el != nullptr) { free_ = el->next; }
+                else 
+                {
+                    if (fresh_ == fresh_end_) { add_chunk(size_ << 1); }
+                    el = fresh_++;
+                }
                 el->used = true;
-                // el->next = nullptr;
                 return &(el->obj);
             }
 
@@ -119,60 +134,54 @@ namespace dbtoaster
                 free_ = reinterpret_cast<Elem<T>*>(current_data);
             }
 
+            // returns all elements handed out so far to the pool
             FORCE_INLINE void clear()
             {
-                Elem<T>* prevChunk = nullptr;
+                Elem<T>* head = nullptr;
                 Elem<T>* chunk = data_;
                 size_t sz = size_;
-                size_t doubleSz = sz << 1;
 
                 while (chunk != nullptr) 
                 {
-                    if (prevChunk != nullptr) 
-                    {
-                        prevChunk[doubleSz - 1].next = chunk;
-                    }
-                    for (size_t i = 0; i < sz - 1; i++) 
+                    for (Elem<T>* e = used_end(chunk, sz); e-- != chunk; ) 
                     {
-                        chunk[i].deactivate();
-                        chunk[i].next = &chunk[i + 1];
+                        e->deactivate();
+                        e->next = head;
+                        head = e;
                     }
-                    chunk[sz - 1].next = nullptr;                    
-                    prevChunk = chunk;
                     chunk = chunk[sz].next;
-                    doubleSz = sz;
                     sz = sz >> 1;
                 }
-                free_ = data_;
+                free_ = head;
             }
     };
 
+    // Chunks are handed out as in Pool.
     template<typename T>
     class ValuePool 
     {
         private:
             ValueElem<T>* free_;
             ValueElem<T>* data_;
+            ValueElem<T>* fresh_;
+            ValueElem<T>* fresh_end_;
             size_t size_;
 
             void add_chunk(size_t new_size) 
             {   // precondition: no available elements
-                assert(free_ == nullptr);
+                assert(free_ == nullptr && fresh_ == fresh_end_);
 
                 size_ = new_size;
-                ValueElem<T>* chunk = new ValueElem<T>[size_ + 1];
-                for (size_t i = 0; i < size_ - 1; i++) 
-                {
-                    chunk[i].next = &chunk[i + 1];
-                }
-                chunk[size_ - 1].next = nullptr;
+                ValueElem<T>* chunk = static_cast<ValueElem<T>*>(calloc(size_ + 1, sizeof(ValueElem<T>)));
                 chunk[size_].next = data_;
                 data_ = chunk;
-                free_ = chunk;
+                fresh_ = chunk;
+                fresh_end_ = chunk + size_;
             }
 
         public:
-            ValuePool(size_t chunk_size = DEFAULT_POOL_CHUNK_SIZE) : free_(nullptr), data_(nullptr) 
+            ValuePool(size_t chunk_size = DEFAULT_POOL_CHUNK_SIZE) 
+                : free_(nullptr), data_(nullptr), fresh_(nullptr), fresh_end_(nullptr) 
             {
                 add_chunk(chunk_size);
             }
@@ -182,7 +191,7 @@ namespace dbtoaster
                 while (data_ != nullptr) 
                 {
                     ValueElem<T>* el = data_[sz].next;
-                    delete[] data_;
+                    free(data_);
                     data_ = el;
                     sz = sz >> 1;
                 } 
@@ -190,11 +199,13 @@ namespace dbtoaster
 
             FORCE_INLINE T* add() 
             {
-                if (free_ == nullptr) { add_chunk(size_ << 1); }
-
                 ValueElem<T>* el = free_;
-                free_ = free_->next;
-                // el->next = nullptr;
+                if (el != nullptr) { free_ = el->next; }
+                else 
+                {
+                    if (fresh_ == fresh_end_) { add_chunk(size_ << 1); }
+                    el = fresh_++;
+                }
                 return &(el->obj);
             }
 
@@ -224,28 +235,21 @@ namespace dbtoaster
 
             FORCE_INLINE void clear()
             {
-                ValueElem<T>* prevChunk = nullptr;
+                ValueElem<T>* head = nullptr;
                 ValueElem<T>* chunk = data_;
                 size_t sz = size_;
-                size_t doubleSz = sz << 1;
 
                 while (chunk != nullptr) 
                 {
-                    if (prevChunk != nullptr) 
-                    {
-                        prevChunk[doubleSz - 1].next = chunk;
-                    }
-                    for (size_t i = 0; i < sz - 1; i++) 
+                    for (ValueElem<T>* e = (chunk == data_ ? fresh_ : chunk + sz); e-- != chunk; ) 
                     {
-                        chunk[i].next = &chunk[i + 1];
+                        e->next = head;
+                        head = e;
                     }
-                    chunk[sz - 1].next = nullptr;                    
-                    prevChunk = chunk;
                     chunk = chunk[sz].next;
-                    doubleSz = sz;
                     sz = sz >> 1;
                 }
-                free_ = data_;
+                free_ = head;
             }
     };
 
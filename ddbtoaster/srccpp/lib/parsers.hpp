@@ -0,0 +1,160 @@
+/*
+ * parsers.hpp
+ *
+ * Delimiter scanning and field parsers used by the stream adaptors.
+ *
+ * The scanner compares a whole vector of bytes against the delimiter and
+ * the string terminator at once (AVX2 when compiled with -mavx2, SSE2 on
+ * any x86-64 target, a byte loop otherwise). Loads are aligned, so they
+ * never cross into a page that does not contain part of the string.
+ *
+ * The numeric parsers take the bounds of a NUL-terminated field and fall
+ * back to the C library for anything outside their fast path, so they
+ * return the same values as atol/atof.
+ */
+
+#ifndef DBTOASTER_PARSERS_H
+#define DBTOASTER_PARSERS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hpds/macro.hpp"
+
+namespace dbtoaster {
+namespace parsers {
+
+/**
+ * Returns the first occurrence of 'c' in the NUL-terminated string 's', or
+ * the terminating NUL if 'c' does not occur.
+ */
+FORCE_INLINE char* find_char_or_end(char* s, char c) {
+#if defined(__AVX2__)
+    const uintptr_t misalign = reinterpret_cast<uintptr_t>(s) & 31;
+    const __m256i* p = reinterpret_cast<const __m256i*>(s - misalign);
+    const __m256i vc = _mm256_set1_epi8(c);
+    const __m256i vz = _mm256_setzero_si256();
+    __m256i x = _mm256_load_si256(p);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vz))));
+    mask &= ~0u << misalign;
+    while (mask == 0) {
+        x = _mm256_load_si256(++p);
+        mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vz))));
+    }
+    return const_cast<char*>(reinterpret_cast<const char*>(p)) + __builtin_ctz(mask);
+#elif defined(__SSE2__)
+    const uintptr_t misalign = reinterpret_cast<uintptr_t>(s) & 15;
+    const __m128i* p = reinterpret_cast<const __m128i*>(s - misalign);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vz = _mm_setzero_si128();
+    __m128i x = _mm_load_si128(p);
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vz))));
+    mask &= ~0u << misalign;
+    while (mask == 0) {
+        x = _mm_load_si128(++p);
+        mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vz))));
+    }
+    return const_cast<char*>(reinterpret_cast<const char*>(p)) + __builtin_ctz(mask);
+#else
+    while (*s != '\0' && *s != c) ++s;
+    return s;
+#endif
+}
+
+/**
+ * Returns the first occurrence of 'delim' in the NUL-terminated string 's',
+ * or the terminating NUL if there is none.
+ */
+FORCE_INLINE char* find_delimiter(char* s, const char* delim, size_t delim_size) {
+    if (delim_size == 0) return s + strlen(s);
+    while (true) {
+        s = find_char_or_end(s, delim[0]);
+        if (*s == '\0' || delim_size == 1 ||
+            strncmp(s + 1, delim + 1, delim_size - 1) == 0)
+            return s;
+        ++s;
+    }
+}
+
+FORCE_INLINE bool is_digit(char c) {
+    return static_cast<unsigned>(c - '0') < 10u;
+}
+
+/**
+ * Parses the integer in the NUL-terminated field [s, e).
+ */
+FORCE_INLINE long parse_long(const char* s, const char* e) {
+    const char* p = s;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+')) { neg = (*p == '-'); ++p; }
+    if (p == e || !is_digit(*p)) return atol(s);
+
+    unsigned long v = 0;
+    do {
+        v = v * 10 + static_cast<unsigned>(*p - '0');
+        ++p;
+    } while (p < e && is_digit(*p));
+    return neg ? -static_cast<long>(v) : static_cast<long>(v);
+}
+
+/**
+ * Parses the fixed-point decimal in the NUL-terminated field [s, e).
+ * Up to 15 significant digits are accumulated into an integer mantissa and
+ * scaled by a single division by an exact power of ten, which yields the
+ * correctly rounded result, i.e., the one atof returns. Exponents and longer
+ * mantissas are left to atof.
+ */
+FORCE_INLINE double parse_double(const char* s, const char* e) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15
+    };
+    const char* p = s;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+')) { neg = (*p == '-'); ++p; }
+
+    uint64_t m = 0;
+    int digits = 0;
+    int scale = 0;
+    for (; p < e && is_digit(*p); ++p, ++digits)
+        m = m * 10 + static_cast<unsigned>(*p - '0');
+    if (p < e && *p == '.') {
+        for (++p; p < e && is_digit(*p); ++p, ++digits, ++scale)
+            m = m * 10 + static_cast<unsigned>(*p - '0');
+    }
+    if (p != e || digits == 0 || digits > 15) return atof(s);
+
+    double v = static_cast<double>(m) / pow10[scale];
+    return neg ? -v : v;
+}
+
+/**
+ * Splits a date of the form YYYY-MM-DD in the field [s, e) into its
+ * components. Returns false if the field does not have this exact form.
+ */
+FORCE_INLINE bool parse_date(const char* s, const char* e, int& y, int& m, int& d) {
+    if (e - s != 10 || s[4] != '-' || s[7] != '-') return false;
+    if (!(is_digit(s[0]) & is_digit(s[1]) & is_digit(s[2]) & is_digit(s[3]) &
+          is_digit(s[5]) & is_digit(s[6]) & is_digit(s[8]) & is_digit(s[9])))
+        return false;
+    y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    m = (s[5] - '0') * 10 + (s[6] - '0');
+    d = (s[8] - '0') * 10 + (s[9] - '0');
+    return true;
+}
+
+}
+}
+
+#endif /* DBTOASTER_PARSERS_H */
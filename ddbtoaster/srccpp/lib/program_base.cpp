@@ -37,11 +37,8 @@ void ProgramBase::logger_t::log(string& relation_name, const event_t& evt) {
         (*log_stream) << relation_name << "|";
     if (log_event_type)
         (*log_stream) << evt.type << "|";
-//  (*log_stream) << setprecision(15) << evt.data << endl;  
-    for(size_t i = 0 ; i < evt.data.size(); ++i) {
-        (*log_stream) << std::setprecision(15) << evt.data[i];
-        if (i < evt.data.size() - 1) (*log_stream) << "|";
-    }
+    if (evt.layout)
+        evt.layout->print(*log_stream, evt.data, "|");
     (*log_stream) << endl;
 }
 
@@ -56,6 +53,20 @@ ProgramBase::trigger_t::trigger_t(
 			std::shared_ptr<ProgramBase::logger_t> t_logger) :
 	name(string(event_name[ev_type]) + "_" + r_name)
 	,fn(t_fn)
+	,call(nullptr)
+	,obj(nullptr)
+	,logger(t_logger)
+{}
+
+ProgramBase::trigger_t::trigger_t(
+			string r_name, 
+			event_type ev_type, 
+			ProgramBase::trigger_call_t t_call,
+			void* t_obj,
+			std::shared_ptr<ProgramBase::logger_t> t_logger) :
+	name(string(event_name[ev_type]) + "_" + r_name)
+	,call(t_call)
+	,obj(t_obj)
 	,logger(t_logger)
 {}
 
@@ -100,6 +111,12 @@ ProgramBase::relation_t::relation_t(
 /******************************************************************************
 	ProgramBase
 ******************************************************************************/
+namespace {
+	void call_function(void* fn, const event_args_t& ea) {
+		(*static_cast<ProgramBase::trigger_fn_t*>(fn))(ea);
+	}
+}
+
 
 relation_id_t ProgramBase::get_relation_id(string r_name) {
 	map<string, std::shared_ptr<relation_t> >::iterator it =
@@ -134,6 +151,7 @@ void ProgramBase::add_relation(
 				new ProgramBase::relation_t(r_name, is_table, id));
 	relations_by_name[r_name] = r;
 	relations_by_id[id] = r;
+	update_dispatch(*r);
 }
 
 void ProgramBase::add_trigger( 
@@ -147,7 +165,33 @@ void ProgramBase::add_trigger(
 		return;
 	}
 	ProgramBase::relation_ptr_t r = it->second;
+	set_trigger(r, ev_type, 
+		std::shared_ptr<ProgramBase::trigger_t>(
+			new ProgramBase::trigger_t(r->name, ev_type, fn,
+									   make_logger(r, ev_type))));
+}
+
+void ProgramBase::add_trigger( 
+			string r_name, 
+			event_type ev_type, 
+			ProgramBase::trigger_call_t call,
+			void* obj) {
+	map<string, ProgramBase::relation_ptr_t>::iterator it =
+			relations_by_name.find(r_name);
+	if (it == relations_by_name.end()) {
+		cerr << "Relation not found: " << r_name << endl;
+		return;
+	}
+	ProgramBase::relation_ptr_t r = it->second;
+	set_trigger(r, ev_type, 
+		std::shared_ptr<ProgramBase::trigger_t>(
+			new ProgramBase::trigger_t(r->name, ev_type, call, obj,
+									   make_logger(r, ev_type))));
+}
 
+std::shared_ptr<ProgramBase::logger_t> ProgramBase::make_logger(
+			ProgramBase::relation_ptr_t r, 
+			event_type ev_type) {
 	static std::shared_ptr<ProgramBase::logger_t> g_log = 
 			std::shared_ptr<ProgramBase::logger_t>();
 	std::shared_ptr<ProgramBase::logger_t> log = 
@@ -159,13 +203,15 @@ void ProgramBase::add_trigger(
 					new ProgramBase::logger_t(global_file, true, true));
 		}
 		log = g_log;
-	} else if (run_opts->logged_streams.find(r_name)
+	} else if (run_opts->logged_streams.find(r->name)
 			!= run_opts->logged_streams.end()) {
 		if (run_opts->unified()) {
 			event_type other_type =
 					ev_type == insert_tuple ? delete_tuple : insert_tuple;
 			std::shared_ptr<ProgramBase::logger_t> other_log = 
-					r->trigger[other_type]->logger;
+					r->trigger[other_type] ? 
+						r->trigger[other_type]->logger :
+						std::shared_ptr<ProgramBase::logger_t>();
 
 			if (other_log)
 				log = other_log;
@@ -181,10 +227,43 @@ void ProgramBase::add_trigger(
 								false, false));
 		}
 	}
+	return log;
+}
 
-	r->trigger[ev_type] = 
-		std::shared_ptr<ProgramBase::trigger_t>(
-			new ProgramBase::trigger_t(r->name, ev_type, fn, log));
+void ProgramBase::set_trigger(
+			ProgramBase::relation_ptr_t r, 
+			event_type ev_type, 
+			std::shared_ptr<ProgramBase::trigger_t> trig) {
+	r->trigger[ev_type] = trig;
+	update_dispatch(*r);
+}
+
+void ProgramBase::update_dispatch(const ProgramBase::relation_t& r) {
+	if (r.id < 0) return;   // not addressable, reported by process_event
+
+	size_t row = static_cast<size_t>(r.id);
+	if (row >= dispatch_relations) {
+		dispatch_relations = row + 1;
+		dispatch.resize(dispatch_relations * num_event_types);
+	}
+	for (int t = 0; t < num_event_types; ++t) {
+		ProgramBase::dispatch_t& d = dispatch[row * num_event_types + t];
+		ProgramBase::trigger_t* trig = r.trigger[t].get();
+		d = ProgramBase::dispatch_t();
+		if (!trig) continue;
+		if (trig->call) {
+			d.call = trig->call;
+			d.obj = trig->obj;
+		} else if (trig->fn) {
+			d.call = &call_function;
+			d.obj = &trig->fn;
+		} else {
+			continue;
+		}
+		d.relation = relations_by_id[r.id].get();
+		d.is_table = r.is_table;
+		d.is_logged = static_cast<bool>(trig->logger);
+	}
 }
 
 void ProgramBase::add_source(
@@ -199,6 +278,7 @@ ProgramBase::ProgramBase(int argc, char* argv[]) :
 	, stream_multiplexer(12345, 10)
 	, table_multiplexer(12345, 10)
 	, next_relation_id(0)
+	, dispatch_relations(0)
 	, tuple_count(0)
 	, log_count_every(run_opts->log_tuple_count_every)
 #ifdef DBT_PROFILE
@@ -216,6 +296,17 @@ ProgramBase::ProgramBase(int argc, char* argv[]) :
 }
 
 void ProgramBase::process_streams() {
+	if(stream_multiplexer.streaming) {
+		event_block_t* block;
+		while((block = stream_multiplexer.next_block()) != nullptr) {
+			std::list<event_t>::iterator it = block->events.begin();
+			std::list<event_t>::iterator it_end = block->events.end();
+			for(;it != it_end; ++it) {
+				process_stream_event(*it);
+			}
+			delete block;
+		}
+	}
 	if(!stream_multiplexer.eventList->empty()) {
 		std::list<event_t>::iterator it = stream_multiplexer.eventList->begin();
 		std::list<event_t>::iterator it_end = stream_multiplexer.eventList->end();
@@ -267,30 +358,25 @@ void ProgramBase::set_log_count_every(
 }
 
 void ProgramBase::process_event(const event_t& evt, const bool process_table) {
-	map<relation_id_t, 
-				 std::shared_ptr<ProgramBase::relation_t> >::iterator r_it =
-			relations_by_id.find(evt.id);
-	if( r_it != relations_by_id.end() &&
-		r_it->second->is_table == process_table )
-	{
-		if(r_it->second->trigger[evt.type]) {
-			std::shared_ptr<ProgramBase::trigger_t> trig = 
-				r_it->second->trigger[evt.type];
-
+	size_t row = static_cast<size_t>(static_cast<unsigned int>(evt.id));
+	if (row < dispatch_relations) {
+		const ProgramBase::dispatch_t& d = 
+				dispatch[row * num_event_types + evt.type];
+		if (d.call && d.is_table == process_table) {
 			#ifdef DBT_TRACE
-			cout << trig->name << ": " << evt.data << endl;
+			cout << d.relation->trigger[evt.type]->name << ": ";
+			if (evt.layout) evt.layout->print(cout, evt.data, ",");
+			cout << endl;
 			#endif // DBT_TRACE
-			trig->log(r_it->second->name, evt);
+			if (d.is_logged)
+				d.relation->trigger[evt.type]->log(d.relation->name, evt);
 
-			(trig->fn)(evt.data);
-		} else {
-			cerr << "Could not find " << event_name[evt.type]
-					<< " handler for relation " << evt.id << endl;
+			(d.call)(d.obj, evt.data);
+			return;
 		}
-	} else {
-		cerr << "Could not find " << event_name[evt.type]
-				<< " handler for relation " << evt.id << endl;
 	}
+	cerr << "Could not find " << event_name[evt.type]
+			<< " handler for relation " << evt.id << endl;
 }
 
 void ProgramBase::process_stream_event(const event_t& _evt) {
@@ -106,6 +106,18 @@ public:
 
     typedef std::function<void(const event_args_t&)> trigger_fn_t;
 
+    /**
+     * Plain trigger entry point: a function called with the object it was
+     * registered with. call_member<T, &T::f> calls the member function 'f'
+     * of a T directly, without the indirections of a trigger_fn_t.
+     */
+    typedef void (*trigger_call_t)(void* obj, const event_args_t& ea);
+
+    template<class T, void (T::*F)(const event_args_t&)>
+    static void call_member(void* obj, const event_args_t& ea) {
+        (static_cast<T*>(obj)->*F)(ea);
+    }
+
     struct logger_t {
         typedef ofstream file_stream_t;
 
@@ -120,10 +132,14 @@ public:
     struct trigger_t {
         string name;
         trigger_fn_t fn;
+        trigger_call_t call;
+        void* obj;
         std::shared_ptr<logger_t> logger;
 
         trigger_t(string r_name, event_type ev_type, trigger_fn_t t_fn,
                     std::shared_ptr<logger_t> t_logger);
+        trigger_t(string r_name, event_type ev_type, trigger_call_t t_call,
+                    void* t_obj, std::shared_ptr<logger_t> t_logger);
         void log(string& relation_name, const event_t& evt);
     };
 
@@ -132,7 +148,7 @@ public:
         bool is_table;
         relation_id_t id;
 
-        std::shared_ptr<trigger_t> trigger[3];
+        std::shared_ptr<trigger_t> trigger[num_event_types];
 
         relation_t(string r_name, bool r_is_table, relation_id_t r_id,
                 trigger_fn_t ins_trigger_fn = 0, 
@@ -163,6 +179,8 @@ public:
     void add_relation(string r_name, bool is_table = false, 
                       relation_id_t s_id = -1);
     void add_trigger(string r_name, event_type ev_type, trigger_fn_t fn);
+    void add_trigger(string r_name, event_type ev_type, 
+                     trigger_call_t call, void* obj);
     void add_source(std::shared_ptr<streams::source> source, 
                     bool is_table_source = false);
 
@@ -191,10 +209,33 @@ protected:
     map<relation_id_t, relation_ptr_t> relations_by_id;
     int next_relation_id;
 
+    /**
+     * Entry of the trigger dispatch table, which is indexed by
+     * [relation id][event type] and kept up to date by add_relation and
+     * add_trigger, so that process_event makes a single indirect call.
+     */
+    struct dispatch_t {
+        trigger_call_t call;
+        void* obj;
+        relation_t* relation;
+        bool is_table;
+        bool is_logged;
+
+        dispatch_t() : call(nullptr), obj(nullptr), relation(nullptr), 
+                       is_table(false), is_logged(false) {}
+    };
+    std::vector<dispatch_t> dispatch;
+    size_t dispatch_relations;
+
     unsigned int tuple_count;
     unsigned int log_count_every;
 
 private:
+    std::shared_ptr<logger_t> make_logger(relation_ptr_t r, event_type ev_type);
+    void set_trigger(relation_ptr_t r, event_type ev_type, 
+                     std::shared_ptr<trigger_t> trig);
+    void update_dispatch(const relation_t& r);
+
     void trace(const path& trace_file, bool debug);
     void trace(std::ostream &ofs, bool debug);
 
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <string>
 #include <sstream>
+#include <thread>
 
 /******************************************************************************
 	runtime_options
@@ -23,6 +24,13 @@ namespace dbtoaster {
 namespace runtime {
 
 bool runtime_options::_verbose = false;
+unsigned int runtime_options::_parse_threads = 0;
+
+unsigned int runtime_options::parse_threads() {
+	if (_parse_threads > 0) return _parse_threads;
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
 
 runtime_options::runtime_options(int argc, char* argv[]) :
   sample_size(0)
@@ -122,6 +130,9 @@ void runtime_options::process_options(int argc, char* argv[])
 			case NO_OUTPUT:
 				no_output = true;
 				break;
+			case PARSE_THREADS:
+				_parse_threads = std::atoi(opt.arg);
+				break;
 			case UNKNOWN:
 				// not possible because Arg::Unknown returns ARG_ILLEGAL
 				// which aborts the parse with an error
@@ -3,10 +3,12 @@
 
 #include "smhasher/MurmurHash2.hpp"
 #include "standard_adaptors.hpp"
+#include "parsers.hpp"
 #include "hpds/KDouble.hpp"
 
 #include "runtime.hpp"
 using namespace ::dbtoaster::runtime;
+using namespace ::dbtoaster::parsers;
 
 namespace dbtoaster {
 namespace adaptors {
@@ -119,19 +121,21 @@ void csv_adaptor::validate_schema() {
 		schema = std::string();
 		schema_size = 0;
 	}
+	layout = tuple_layout(schema);
 }
 
 // Interpret the schema.
 std::tuple<bool, bool, unsigned int, event_args_t> 
 csv_adaptor::interpret_event(char* data)
 {
-	bool ins; unsigned int event_order=0; int y,m,d; 
+	unsigned int event_order=0; int y,m,d; 
 	char* date_y_field;
 	char* date_m_field;
 	char* date_d_field;
+	char* date_rest;
 	
-	event_args_t tuple(schema_size);
-	size_t tupleIdx = 0;
+	char* tuple = arena->allocate(layout);
+	tuple_writer fields(tuple);
 	bool valid = true;
 
 	// Default to the adaptor's event type, and override with an event
@@ -142,48 +146,55 @@ csv_adaptor::interpret_event(char* data)
     size_t delimSize = delimiter.size();
     char* field_start=data;
     char* field_end=data;
+    bool more_fields;
 
 	std::string::iterator schema_it = schema.begin();
 	std::string::iterator schema_end = schema.end();
 	while(valid && (schema_it != schema_end)) {
-    	field_end = strstr(field_start,delim);
-        if(field_end) *field_end='\0';
+    	field_end = find_delimiter(field_start, delim, delimSize);
+    	more_fields = (*field_end != '\0');
+        *field_end='\0';
         // std::cout << "  handling schema => " << *schema_it << std::endl;
         switch (*schema_it) {
-			case 'e': ins=atoi(field_start); insert = ins; break;
-			case 'l': tuple[tupleIdx++]=std::shared_ptr<long>(new long(atol(field_start))); break;
-			case 'f': tuple[tupleIdx++]=std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(atof(field_start))); break;
-			case 'h': tuple[tupleIdx++]=std::shared_ptr<int>(new int(static_cast<int>(MurmurHash2(field_start,strlen(field_start)*sizeof(char),0))));
+			case 'e': insert = (parse_long(field_start, field_end) != 0); break;
+			case 'l': fields.put<long>(parse_long(field_start, field_end)); break;
+			case 'f': fields.put<DOUBLE_TYPE>(parse_double(field_start, field_end)); break;
+			case 'h': fields.put<int>(static_cast<int>(MurmurHash2(field_start,(field_end - field_start)*sizeof(char),0)));
 					  break;
 			case 'd': 
-				date_y_field = strtok (field_start,"-");
-				if(date_y_field != NULL) {
-					date_m_field = strtok (NULL,"-");
-					if(date_m_field != NULL) {
-						date_d_field = strtok (NULL,"-");
-						if(date_d_field != NULL) {
-							y = atoi(date_y_field);
-							m = atoi(date_m_field);
-							d = atoi(date_d_field);
-							if ( 0 < m && m < 13 && 0 < d && d <= 31) {
-								tuple[tupleIdx++]=std::shared_ptr<date>(new date(y*10000+m*100+d));
+				if(!parse_date(field_start, field_end, y, m, d)) {
+					// not in the YYYY-MM-DD form, e.g., without zero padding;
+					// strtok_r, as adaptors run on several parsing threads
+					valid = false;
+					date_y_field = strtok_r (field_start,"-",&date_rest);
+					if(date_y_field != NULL) {
+						date_m_field = strtok_r (NULL,"-",&date_rest);
+						if(date_m_field != NULL) {
+							date_d_field = strtok_r (NULL,"-",&date_rest);
+							if(date_d_field != NULL) {
+								y = atoi(date_y_field);
+								m = atoi(date_m_field);
+								d = atoi(date_d_field);
+								valid = true;
 							}
-        					// std::cout << "  date is => " << date(y*10000+m*100+d) << std::endl;
-						} else valid = false;
-					} else valid = false;
+						}
+					}
+				}
+				if ( valid && 0 < m && m < 13 && 0 < d && d <= 31) {
+					fields.put<date>(y*10000+m*100+d);
 				} else valid = false;
 			  break;
 			case 'o':
-				event_order=atoi(field_start);
+				event_order=parse_long(field_start, field_end);
 				break;
 			case 's': 
-			  tuple[tupleIdx++]=std::shared_ptr<STRING_TYPE>(new STRING_TYPE(field_start)); 
+			  arena->own(fields.put<STRING_TYPE>(field_start, field_end - field_start));
 			  break;
 			default: valid = false; break;
 		}
 
         ++schema_it;
-        if(field_end) {
+        if(more_fields) {
             field_end += delimSize;
             field_start = field_end;
         } else if(schema_it != schema_end){
@@ -191,7 +202,6 @@ csv_adaptor::interpret_event(char* data)
         	break;
         }
 	}
-    // std::cout << " tuples is ==> " << tuple << std::endl;
 	return std::make_tuple(valid, insert, event_order, tuple);
 }
 
@@ -203,7 +213,7 @@ void csv_adaptor::read_adaptor_events(char* data, std::shared_ptr<std::list<even
 	  bool insert = std::get<1>(evt);
 	  unsigned int event_order = std::get<2>(evt);
 	  if ( valid )  {
-		event_t e(insert? insert_tuple : delete_tuple, id, event_order, std::get<3>(evt));
+		event_t e(insert? insert_tuple : delete_tuple, id, event_order, std::get<3>(evt), &layout);
 		if(e.event_order == 0) {
 			eventList->push_back(e);
 		} else {
@@ -218,6 +228,17 @@ void csv_adaptor::read_adaptor_events(char* data, std::shared_ptr<std::list<even
 	}
 }
 
+
+bool csv_adaptor::has_event_order() {
+	return schema.find('o') != std::string::npos;
+}
+
+std::shared_ptr<stream_adaptor> csv_adaptor::clone() {
+	std::shared_ptr<csv_adaptor> a(new csv_adaptor(*this));
+	a->take_arena();
+	return a;
+}
+
 }
 
 namespace datasets
@@ -246,17 +267,15 @@ order_book_tuple& order_book_tuple::operator=(order_book_tuple& other) {
 	return *this;
 }
 
-void order_book_tuple::operator()(event_args_t& e) {
-	if (e.size() > 0) e[0] = std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(t)); 
-	else e.push_back(std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(t)));
-	if (e.size() > 1) e[1] = std::shared_ptr<long>(new long(id)); 
-	else e.push_back(std::shared_ptr<long>(new long(id)));
-	if (e.size() > 2) e[2] = std::shared_ptr<long>(new long(broker_id)); 
-	else e.push_back(std::shared_ptr<long>(new long(broker_id)));
-	if (e.size() > 3) e[3] = std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(volume)); 
-	else e.push_back(std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(volume)));
-	if (e.size() > 4) e[4] = std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(price)); 
-	else e.push_back(std::shared_ptr<DOUBLE_TYPE>(new DOUBLE_TYPE(price)));
+event_args_t order_book_tuple::operator()(tuple_arena& a, const tuple_layout& l) const {
+	char* tuple = a.allocate(l);
+	tuple_writer fields(tuple);
+	fields.put<DOUBLE_TYPE>(t);
+	fields.put<long>(id);
+	fields.put<long>(broker_id);
+	fields.put<DOUBLE_TYPE>(volume);
+	fields.put<DOUBLE_TYPE>(price);
+	return tuple;
 }
 
 /******************************************************************************
@@ -265,6 +284,7 @@ void order_book_tuple::operator()(event_args_t& e) {
 order_book_adaptor::order_book_adaptor(
 		relation_id_t bids_rel_sid, relation_id_t asks_rel_sid, int nb, order_book_type t)
           : bids_rel_id(bids_rel_sid), asks_rel_id(asks_rel_sid), num_brokers(nb), type(t)
+          , layout("fllff")
 {
 	bids = std::shared_ptr<order_book>(new order_book());
 	asks = std::shared_ptr<order_book>(new order_book());
@@ -274,6 +294,7 @@ order_book_adaptor::order_book_adaptor(
 
 order_book_adaptor::order_book_adaptor(relation_id_t bids_rel_sid, relation_id_t asks_rel_sid, int num_params,
 				   std::pair<std::string, std::string> params[])
+		: layout("fllff")
 {
 	bids_rel_id = bids_rel_sid;
 	asks_rel_id = asks_rel_sid;
@@ -406,9 +427,7 @@ void order_book_adaptor::process_message(const order_book_message& msg,
 		}
 	  }
 	  if ( x_valid && !insert_only ) {
-		event_args_t fields(5);
-		x(fields);
-		event_t y(delete_tuple, rel_id, event_order-1, fields);
+		event_t y(delete_tuple, rel_id, event_order-1, x(*arena, layout), &layout);
 		dest->push_back(y);
 	  }
 	  t = insert_tuple;
@@ -446,10 +465,8 @@ void order_book_adaptor::process_message(const order_book_message& msg,
 
 
 	if ( valid ) {
-	  event_args_t fields(5);
-	  r(fields);
 	  if ( !(t == delete_tuple && insert_only) ) {
-		event_t e(t, rel_id, event_order, fields);
+		event_t e(t, rel_id, event_order, r(*arena, layout), &layout);
 		dest->push_back(e);
 	  }
 	}
@@ -20,6 +20,7 @@ namespace dbtoaster {
       event_type type;
       string schema;
       size_t schema_size;
+      tuple_layout layout;
       std::string delimiter;
       
       std::shared_ptr<event_t> saved_event;
@@ -30,6 +31,8 @@ namespace dbtoaster {
                   const std::pair<std::string,std::string> params[]);
 
       void read_adaptor_events(char* data, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);
+      bool has_event_order();
+      std::shared_ptr<stream_adaptor> clone();
       void parse_params(int num_params, const std::pair<std::string, std::string> params[]);
       virtual std::string parse_schema(std::string s);
       void validate_schema();
@@ -72,7 +75,7 @@ namespace dbtoaster {
 
           order_book_tuple(const order_book_message& msg);
           order_book_tuple& operator=(order_book_tuple& other);
-          void operator()(event_args_t& e);
+          event_args_t operator()(tuple_arena& a, const tuple_layout& l) const;
       };
 
       typedef std::map<int, order_book_tuple> order_book;
@@ -86,13 +89,14 @@ namespace dbtoaster {
         std::shared_ptr<order_book> asks;
         bool deterministic;
         bool insert_only;
-
+        tuple_layout layout;
 
         order_book_adaptor(relation_id_t bids_rel_sid, relation_id_t asks_rel_sid, int nb, order_book_type t);
         order_book_adaptor(relation_id_t bids_rel_sid, relation_id_t asks_rel_sid, int num_params,
                            std::pair<std::string, std::string> params[]);
 
         void read_adaptor_events(char* data, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);						   
+        bool has_event_order() { return true; }
         bool parse_error(const char* data, int field);
 
         // Expected message format: t, id, action, volume, price
@@ -1,6 +1,10 @@
 #include "streams.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "runtime.hpp"
+#include "parsers.hpp"
 
 #include "filepath.hpp"
 
@@ -20,6 +24,7 @@ source::source(frame_descriptor& f, std::shared_ptr<stream_adaptor> a) : frame_i
 ******************************************************************************/
 dbt_file_source::dbt_file_source(
 		const std::string& path, frame_descriptor& f, std::shared_ptr<stream_adaptor> a): source(f,a)
+		, chunk_size(DEFAULT_SOURCE_CHUNK_SIZE), buffer(nullptr), buffer_capacity(0), buffer_length(0)
 {
 	if ( file_exists( path ) )
 	{
@@ -32,33 +37,88 @@ dbt_file_source::dbt_file_source(
 		std::cerr << "File not found: " << path << std::endl;
 }
 
+dbt_file_source::~dbt_file_source() {
+	delete[] buffer;
+}
+
 void dbt_file_source::read_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) {
-	//read the whole file
-	source_stream->seekg(0, std::ios::end);
-	size_t bufferLength = source_stream->tellg();
-	size_t extra_buffer = 0;
-	//reserving some buffer for a possible missing delimiter at the end
+	// The whole input is materialized, so frames are parsed by several
+	// threads, each with its own clone of the adaptor.
+	unsigned int num_threads = runtime_options::parse_threads();
+	if ( num_threads > 1 && workers.empty() && buffer == nullptr && can_split_frames() ) {
+		for (unsigned int i = 0; i < num_threads; ++i) {
+			std::shared_ptr<stream_adaptor> w = adaptor->clone();
+			if ( !w ) { workers.clear(); break; }
+			workers.push_back(w);
+		}
+		if ( !workers.empty() ) chunk_size = num_threads * DEFAULT_PARSE_CHUNK_SIZE;
+	}
+	while( read_next_source_events(eventList, eventQue) ) {}
+}
+
+bool dbt_file_source::read_next_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) {
+	if ( !source_stream || !source_stream->is_open() ) return false;
+
+	//reserving some buffer for the terminator and a possible missing
+	//delimiter at the end
+	size_t extra_buffer = 1;
 	if ( frame_info.type == delimited ) {
-		extra_buffer = frame_info.delimiter.size();
+		extra_buffer += frame_info.delimiter.size();
+	}
+	if ( buffer == nullptr ) {
+		buffer_capacity = chunk_size;
+		buffer = new char[buffer_capacity + extra_buffer];
+	} else if ( buffer_length == buffer_capacity ) {
+		//a single frame does not fit into the buffer
+		char* old_buffer = buffer;
+		buffer_capacity <<= 1;
+		buffer = new char[buffer_capacity + extra_buffer];
+		memcpy(buffer, old_buffer, buffer_length);
+		delete[] old_buffer;
 	}
-	char* buffer = new char[bufferLength+1+extra_buffer];
-	char* buffer_end = buffer + bufferLength;
+
+	source_stream->read(buffer + buffer_length, buffer_capacity - buffer_length);
+	buffer_length += source_stream->gcount();
+	bool last = !(*source_stream);
+
+	char* buffer_end = buffer + buffer_length;
 	*buffer_end = '\0';
-	source_stream->seekg(0, std::ios::beg);
-	source_stream->read(buffer,bufferLength);
-	source_stream->close();
+	char* rest = buffer;
+	if ( !workers.empty() ) rest = frame_events_parallel(buffer, buffer_end, eventList, eventQue);
+	rest = frame_events(*adaptor, rest, buffer_end, last, eventList, eventQue);
+
+	if ( last ) {
+		source_stream->close();
+		delete[] buffer;
+		buffer = nullptr;
+		buffer_length = 0;
+		return false;
+	}
+	buffer_length = buffer_end - rest;
+	memmove(buffer, rest, buffer_length);
+	return true;
+}
+
+// Frames and processes all complete events in [start, end). If 'last' is set,
+// a trailing incomplete frame is processed as well. Returns the beginning of
+// the unprocessed remainder.
+char* dbt_file_source::frame_events(stream_adaptor& a, char* start, char* end, bool last, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) {
+	if (start == end) return end;
 
-	char* start_event_pos = buffer;
-	char* end_event_pos = buffer;
 	if (frame_info.type == fixed_size) {
 		size_t frame_size = frame_info.size;
 		char tmp;
-		for(; start_event_pos != buffer_end; start_event_pos = end_event_pos) {
-			end_event_pos = start_event_pos+frame_size;
+		while ( (size_t)(end - start) >= frame_size ) {
+			char* end_event_pos = start + frame_size;
 			tmp = *end_event_pos;
 			*end_event_pos = '\0';
-			adaptor->read_adaptor_events(start_event_pos,eventList,eventQue);
+			a.read_adaptor_events(start,eventList,eventQue);
 			*end_event_pos = tmp;
+			start = end_event_pos;
+		}
+		if ( last && start != end ) {
+			a.read_adaptor_events(start,eventList,eventQue);
+			start = end;
 		}
 	}
 	else if ( frame_info.type == delimited ) {
@@ -66,36 +126,103 @@ void dbt_file_source::read_source_events(std::shared_ptr<std::list<event_t> > ev
 		size_t delim_size = frame_info.delimiter.size();
 
 		//add delimeter at the end, if it does not exist
-		for(size_t delim_idx = 0; delim_idx < delim_size; ++delim_idx) {
-			if(*(buffer_end-1-delim_idx) != *(delim+delim_size-1)) {
-				for(delim_idx = 0; delim_idx < delim_size; ++delim_idx) {
-					*buffer_end = *(delim+delim_idx);
-					buffer_end+=1;
-				}
-				*buffer_end = '\0';
-				break;
-			}
+		if ( last && ((size_t)(end - start) < delim_size ||
+		              memcmp(end - delim_size, delim, delim_size) != 0) ) {
+			memcpy(end, delim, delim_size);
+			end += delim_size;
+			*end = '\0';
 		}
 
-		while(start_event_pos) {
-			end_event_pos = strstr(start_event_pos, delim);
-			if(!end_event_pos || end_event_pos == buffer_end) break;
+		char* end_event_pos;
+		while( start < end && *(end_event_pos = parsers::find_delimiter(start, delim, delim_size)) != '\0' ) {
 			*end_event_pos = '\0';
-			adaptor->read_adaptor_events(start_event_pos,eventList,eventQue);
-			start_event_pos = end_event_pos + delim_size;
+			a.read_adaptor_events(start,eventList,eventQue);
+			start = end_event_pos + delim_size;
 		}
 	} else if ( frame_info.type == variable_size ) {
 		std::cerr << "variable size frames not supported" << std::endl;
+		start = end;
 	} else {
 		std::cerr << "invalid frame type" << std::endl;
+		start = end;
 	}
-	delete[] buffer;
+	return start;
+}
+
+// Splits [start, end) into ranges of complete frames, one per worker, and
+// processes them concurrently. The events of each range are appended in
+// input order. Returns the beginning of the unprocessed remainder, i.e.,
+// of a trailing incomplete frame.
+char* dbt_file_source::frame_events_parallel(char* start, char* end, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) {
+	size_t num_ranges = std::min(workers.size(), (size_t)(end - start) / MIN_PARSE_SPLIT_SIZE);
+	if (num_ranges <= 1) return start;
+
+	std::vector<char*> cuts(num_ranges + 1);
+	cuts[0] = start;
+	for (size_t i = 1; i < num_ranges; ++i) {
+		char* target = std::max(cuts[i - 1], start + (end - start) / num_ranges * i);
+		cuts[i] = next_frame_start(target, end);
+		// No frame starts after the target, e.g., behind a frame longer
+		// than a range: the unprocessed remainder is the tail of range i-1.
+		if (cuts[i] == end) { num_ranges = i; break; }
+	}
+	if (num_ranges <= 1) return start;
+	cuts[num_ranges] = end;
+
+	typedef std::shared_ptr<std::list<event_t> > event_list_ptr;
+	std::vector<event_list_ptr> lists(num_ranges), ques(num_ranges);
+	std::vector<char*> rests(num_ranges);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < num_ranges; ++i) {
+		lists[i] = event_list_ptr(new std::list<event_t>());
+		ques[i] = event_list_ptr(new std::list<event_t>());
+	}
+	for (size_t i = 1; i < num_ranges; ++i) {
+		threads.push_back(std::thread([this, i, &cuts, &lists, &ques, &rests]() {
+			rests[i] = frame_events(*workers[i], cuts[i], cuts[i + 1], false, lists[i], ques[i]);
+		}));
+	}
+	rests[0] = frame_events(*workers[0], cuts[0], cuts[1], false, lists[0], ques[0]);
+	for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+	for (size_t i = 0; i < num_ranges; ++i) {
+		eventList->splice(eventList->end(), *lists[i]);
+		eventQue->splice(eventQue->end(), *ques[i]);
+		adaptor->adopt_arena(*workers[i]);
+	}
+	return rests[num_ranges - 1];
 }
+
+// Returns the beginning of the first delimited frame starting after 'pos',
+// or 'end' if there is none.
+char* dbt_file_source::next_frame_start(char* pos, char* end) {
+	const char* delim = frame_info.delimiter.c_str();
+	size_t delim_size = frame_info.delimiter.size();
+	char* d = parsers::find_delimiter(pos, delim, delim_size);
+	return *d == '\0' ? end : std::min(d + delim_size, end);
+}
+
+// Delimited frames can be located from an arbitrary position if no proper
+// prefix of the delimiter is also a suffix of it, so that a match found
+// mid-stream is the one a sequential scan would find. (Fixed-size framing
+// temporarily terminates each frame in place, which would touch the first
+// byte of the neighbouring range.)
+bool dbt_file_source::can_split_frames() {
+	if (frame_info.type != delimited) return false;
+	const std::string& d = frame_info.delimiter;
+	if (d.empty()) return false;
+	for (size_t k = 1; k < d.size(); ++k) {
+		if (d.compare(0, k, d, d.size() - k, k) == 0) return false;
+	}
+	return true;
+}
+
 /******************************************************************************
 	source_multiplexer
 ******************************************************************************/
 source_multiplexer::source_multiplexer(int seed, int st)
-	: step(st), remaining(0), block(100)
+	: step(st), remaining(0), block(100), streaming(false)
+	, blocks(DEFAULT_EVENT_QUEUE_CAPACITY), reader_done(false), stop_reading(false), parked(0)
 {
 	srand(seed);
 	eventList = std::shared_ptr<std::list<event_t> >(new std::list<event_t>());
@@ -104,13 +231,23 @@ source_multiplexer::source_multiplexer(int seed, int st)
 
 source_multiplexer::source_multiplexer(int seed, int st, 
 										std::set<std::shared_ptr<source> >& s)
+	: source_multiplexer(seed, st)
 {
-	source_multiplexer(seed, st);
 	std::set<std::shared_ptr<source> >::iterator it = s.begin();
 	std::set<std::shared_ptr<source> >::iterator end = s.end();
 	for(; it != end; ++it) add_source(*it);
 }
 
+source_multiplexer::~source_multiplexer() {
+	if (reader.joinable()) {
+		stop_reading.store(true, std::memory_order_release);
+		wake_parked();
+		reader.join();
+	}
+	event_block_t* b;
+	while (blocks.try_pop(b)) delete b;
+}
+
 void source_multiplexer::add_source(std::shared_ptr<source> s) {
 	inputs.push_back(s);
 }
@@ -123,6 +260,14 @@ void source_multiplexer::remove_source(std::shared_ptr<source> s) {
 }
 
 void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is_table) {
+	if (can_stream(batch_size, is_table)) {
+		// Events are read, framed and parsed by a background thread while
+		// the program processes static tables and earlier stream events.
+		streaming = true;
+		reader = std::thread(&source_multiplexer::read_streams, this, parallel);
+		return;
+	}
+
 	std::vector<std::shared_ptr<source> >::iterator it = inputs.begin();
 	std::vector<std::shared_ptr<source> >::iterator end = inputs.end();
 	for (; it != end; ++it) {
@@ -130,12 +275,14 @@ void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is
 		if(s) {
 			s->init_source();
 			s->read_source_events(eventList, eventQue);
+			arenas.push_back(s->take_arena());
 		}
 	}
 	if(batch_size > 1) {
 		std::list<event_t> batchedEventList;
 		map<relation_id_t,std::vector<event_t*> > tuples_queued_in_relations;
-
+		std::vector<event_t*> batch_events;
+		batch_events.reserve(batch_size);
 
 		if(!eventList->empty()) {
 			std::list<event_t>::iterator eit = eventList->begin();
@@ -149,46 +296,27 @@ void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is
 			eventQue->sort(compare_event_timestamp_order);
 			std::list<event_t>::iterator eit = eventQue->begin();
 			std::list<event_t>::iterator eit_end = eventQue->end();
-			event_args_t batch;
 
 			for(;eit != eit_end;) {
-				event_t* evt = &(*eit);
-				event_args_t* evtData = new event_args_t(evt->data);
-				if(evt->type == insert_tuple) evtData->push_back(std::shared_ptr<long>(new long( 1L)));
-				else evtData->push_back(std::shared_ptr<long>(new long(-1L)));
-
-				// add relation to last element
-				evtData->push_back(std::shared_ptr<int>(new int(evt->id)));
-
-				batch.push_back(std::shared_ptr<event_args_t>(evtData));
+				batch_events.push_back(&(*eit));
 				// increment iterator
 				++eit;
-				if(batch.size() >= batch_size || eit == eit_end) {
-					event_t e(batch_update, evt->id, evt->event_order, batch);
-					batchedEventList.push_back(e);
-					batch.clear();
+				if(batch_events.size() >= batch_size || eit == eit_end) {
+					batchedEventList.push_back(make_batch(batch_events));
+					batch_events.clear();
 				}
 			}
 		}
 		if (!eventList->empty()) {
 			map<relation_id_t, std::vector<event_t*> >::iterator it = tuples_queued_in_relations.begin();
 			map<relation_id_t, std::vector<event_t*> >::iterator it_end = tuples_queued_in_relations.end();
-			event_args_t batch;
 			for(; it != it_end; ++it) {
 				while(!it->second.empty()) {
-					event_t* evt = it->second.back();
+					batch_events.push_back(it->second.back());
 					it->second.pop_back();
-					event_args_t* evtData = new event_args_t(evt->data);
-					if(evt->type == insert_tuple) evtData->push_back(std::shared_ptr<long>(new long( 1L)));
-					else evtData->push_back(std::shared_ptr<long>(new long(-1L)));
-
-					// add relation to last element
-					evtData->push_back(std::shared_ptr<int>(new int(evt->id)));
-					batch.push_back(std::shared_ptr<event_args_t>(evtData));
-					if(batch.size() >= batch_size || it->second.empty()) {
-						event_t e(batch_update, evt->id, evt->event_order, batch);
-						batchedEventList.push_back(e);
-						batch.clear();
+					if(batch_events.size() >= batch_size || it->second.empty()) {
+						batchedEventList.push_back(make_batch(batch_events));
+						batch_events.clear();
 					}
 				}
 			}
@@ -201,12 +329,14 @@ void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is
 			eventQue->clear();
 			eventQue->insert(eventQue->end(), batchedEventList.begin(), batchedEventList.end());
 		}
+		// The batches hold copies of all fields, so the parsed tuples can go.
+		arenas.clear();
 	}
 	size_t num_relations = inputs.size();
 	if(!is_table && !eventList->empty() && parallel == MIX_INPUT_TUPLES && num_relations > 1) { //we do not interleave table tuples as they are part of preprocessing and we do not even time their calculations
 		std::list<event_t>::reverse_iterator it = eventList->rbegin();
 		std::list<event_t>::reverse_iterator it_end = eventList->rend();
-		std::vector<event_t> events_by_relation[num_relations];
+		map<relation_id_t, std::vector<event_t> > events_by_relation;
 		for(;it != it_end; ++it) {
 			events_by_relation[it->id].push_back(*it);
 		}
@@ -214,11 +344,13 @@ void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is
 		bool thereAreMoreTuples = true;
 		while(thereAreMoreTuples) {
 			thereAreMoreTuples = false;
-			for(size_t i = 0; i < num_relations; ++i) {
-				if(events_by_relation[i].size() > 0) {
+			map<relation_id_t, std::vector<event_t> >::iterator rit = events_by_relation.begin();
+			map<relation_id_t, std::vector<event_t> >::iterator rit_end = events_by_relation.end();
+			for(; rit != rit_end; ++rit) {
+				if(rit->second.size() > 0) {
 					thereAreMoreTuples = true;
-					eventList->push_back(events_by_relation[i].back());
-					events_by_relation[i].pop_back();
+					eventList->push_back(rit->second.back());
+					rit->second.pop_back();
 				}
 			}
 		}
@@ -228,6 +360,209 @@ void source_multiplexer::init_source(size_t batch_size, size_t parallel, bool is
 	}
 }
 
+// Stores the tuples of 'evts' column by column, one column_batch_t per
+// relation, and returns the batch_update event carrying them.
+event_t source_multiplexer::make_batch(const std::vector<event_t*>& evts) {
+	std::vector<std::pair<relation_id_t, const tuple_layout*> > relations;
+	std::vector<size_t> counts;
+	std::vector<size_t> part(evts.size());
+	size_t last = 0;
+	for (size_t i = 0; i < evts.size(); ++i) {
+		const event_t* e = evts[i];
+		if (last >= relations.size() || relations[last].first != e->id) {
+			for (last = 0; last < relations.size() && relations[last].first != e->id; ++last) {}
+			if (last == relations.size()) {
+				relations.push_back(std::make_pair(e->id, e->layout));
+				counts.push_back(0);
+			}
+		}
+		part[i] = last;
+		++counts[last];
+	}
+
+	batches.push_back(event_batch_t());
+	event_batch_t& batch = batches.back();
+	for (size_t r = 0; r < relations.size(); ++r) {
+		if (relations[r].second == nullptr) {
+			std::cerr << "Skipping batched events of relation " << relations[r].first
+				<< ", no schema found." << std::endl;
+			batch.relations.push_back(std::unique_ptr<column_batch_t>(
+				new column_batch_t(relations[r].first, tuple_layout(), 0)));
+			continue;
+		}
+		batch.relations.push_back(std::unique_ptr<column_batch_t>(
+			new column_batch_t(relations[r].first, *relations[r].second, counts[r])));
+	}
+	for (size_t i = 0; i < evts.size(); ++i) {
+		if (relations[part[i]].second == nullptr) continue;
+		batch.relations[part[i]]->append(evts[i]->data, evts[i]->type == insert_tuple ? 1L : -1L);
+	}
+
+	const event_t* e = evts.back();
+	return event_t(batch_update, e->id, e->event_order, reinterpret_cast<event_args_t>(&batch));
+}
+
+// Streaming is possible when events do not have to be regrouped into batches
+// and their processing order follows the input order. Sources with an
+// explicit event order are sorted by it over all of their events, which
+// cannot be done incrementally, so they are materialized.
+bool source_multiplexer::can_stream(size_t batch_size, bool is_table) {
+	if (is_table || batch_size > 1 || inputs.empty()) return false;
+	std::vector<std::shared_ptr<source> >::iterator it = inputs.begin();
+	std::vector<std::shared_ptr<source> >::iterator end = inputs.end();
+	for (; it != end; ++it) {
+		if (!(*it) || (*it)->has_event_order()) return false;
+	}
+	return true;
+}
+
+// Spins for EVENT_QUEUE_SPIN_TRIES tries, then sleeps until ready() holds.
+// A waker publishes its change before it checks 'parked', and a sleeper
+// counts itself in 'parked' before it checks ready(): one of the two sees
+// the other.
+template<class Ready>
+void source_multiplexer::park_until(Ready ready) {
+	for (int i = 0; i < EVENT_QUEUE_SPIN_TRIES; ++i) {
+		if (ready()) return;
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(park_lock);
+	parked.fetch_add(1, std::memory_order_seq_cst);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (!ready()) park_cv.wait(lock);
+	parked.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void source_multiplexer::wake_parked() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (parked.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(park_lock);
+		park_cv.notify_all();
+	}
+}
+
+void source_multiplexer::finish_reading() {
+	reader_done.store(true, std::memory_order_release);
+	wake_parked();
+}
+
+bool source_multiplexer::push_block(event_block_t* b) {
+	while (!blocks.try_push(b)) {
+		if (stop_reading.load(std::memory_order_acquire)) {
+			delete b;
+			return false;
+		}
+		park_until([this]() {
+			return !blocks.full() || stop_reading.load(std::memory_order_acquire);
+		});
+	}
+	wake_parked();
+	return true;
+}
+
+event_block_t* source_multiplexer::next_block() {
+	event_block_t* b;
+	while (!blocks.try_pop(b)) {
+		if (reader_done.load(std::memory_order_acquire)) {
+			if (blocks.try_pop(b)) break;
+			if (reader.joinable()) reader.join();
+			return nullptr;
+		}
+		park_until([this]() {
+			return !blocks.empty() || reader_done.load(std::memory_order_acquire);
+		});
+	}
+	wake_parked();
+	return b;
+}
+
+// Body of the reader thread. Produces the same event order as the
+// materializing path of init_source: sources one after another, or
+// round-robin across relations for MIX_INPUT_TUPLES.
+void source_multiplexer::read_streams(size_t parallel) {
+	struct cursor {
+		std::shared_ptr<source> src;
+		std::shared_ptr<std::list<event_t> > pending;
+		std::shared_ptr<tuple_arena> arena;   // tuples of the pending events
+		bool more;
+
+		bool refill() {
+			while (pending->empty() && more) {
+				std::shared_ptr<std::list<event_t> > ordered(new std::list<event_t>());
+				more = src->read_next_source_events(pending, ordered);
+				arena = src->take_arena();
+				// sources without an event order only report order 0
+				pending->splice(pending->end(), *ordered);
+			}
+			return !pending->empty();
+		}
+
+		// Moves up to 'n' pending events to 'out'. The arena of the chunk
+		// travels with its last event, and is thus released only after all
+		// of the chunk's events have been processed.
+		void move_to(event_block_t* out, size_t n) {
+			if (n >= pending->size()) {
+				out->events.splice(out->events.end(), *pending);
+			}
+			else {
+				std::list<event_t>::iterator last = pending->begin();
+				std::advance(last, n);
+				out->events.splice(out->events.end(), *pending, pending->begin(), last);
+			}
+			if (pending->empty()) out->arenas.push_back(std::move(arena));
+		}
+	};
+
+	size_t num_sources = inputs.size();
+	std::vector<cursor> cursors(num_sources);
+	for (size_t i = 0; i < num_sources; ++i) {
+		cursors[i].src = inputs[i];
+		cursors[i].src->init_source();
+		cursors[i].pending = std::shared_ptr<std::list<event_t> >(new std::list<event_t>());
+		cursors[i].more = true;
+	}
+
+	bool mixed = parallel == MIX_INPUT_TUPLES && num_sources > 1;
+	event_block_t* out = new event_block_t();
+
+	if (!mixed) {
+		for (size_t i = 0; i < num_sources; ++i) {
+			while (cursors[i].refill()) {
+				cursors[i].move_to(out, DEFAULT_EVENT_BLOCK_SIZE - out->events.size());
+				if (out->events.size() >= DEFAULT_EVENT_BLOCK_SIZE) {
+					if (!push_block(out)) { finish_reading(); return; }
+					out = new event_block_t();
+				}
+			}
+		}
+	}
+	else {
+		// round-robin follows relation ids, as in the materializing path
+		for (size_t i = 0; i < num_sources; ++i) cursors[i].refill();
+		std::stable_sort(cursors.begin(), cursors.end(), [](const cursor& a, const cursor& b) {
+			return !b.pending->empty() && (a.pending->empty() || a.pending->front().id < b.pending->front().id);
+		});
+		bool more = true;
+		while (more && !stop_reading.load(std::memory_order_relaxed)) {
+			more = false;
+			for (size_t i = 0; i < num_sources; ++i) {
+				if (cursors[i].refill()) {
+					cursors[i].move_to(out, 1);
+					more = true;
+				}
+			}
+			if (out->events.size() >= DEFAULT_EVENT_BLOCK_SIZE) {
+				if (!push_block(out)) { finish_reading(); return; }
+				out = new event_block_t();
+			}
+		}
+	}
+
+	if (out->events.empty()) delete out;
+	else push_block(out);
+	finish_reading();
+}
+
 }
 
 }
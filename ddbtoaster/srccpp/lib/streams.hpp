@@ -13,11 +13,24 @@
 #include <sys/time.h>
 
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cassert>
 
 #include "runtime.hpp"
 #include "event.hpp"
+#include "tuple.hpp"
 
 
+#define DEFAULT_SOURCE_CHUNK_SIZE (1 << 20)   // bytes read from a file at once
+#define DEFAULT_EVENT_BLOCK_SIZE 1024         // events handed over at once
+#define DEFAULT_EVENT_QUEUE_CAPACITY 64       // blocks in flight, 2^N
+#define EVENT_QUEUE_SPIN_TRIES 64             // before a side of the queue parks
+#define DEFAULT_PARSE_CHUNK_SIZE (4 << 20)    // bytes per parsing thread
+#define MIN_PARSE_SPLIT_SIZE (64 * 1024)      // smallest range worth a thread
+
 namespace dbtoaster {
 namespace streams {
 
@@ -25,9 +38,36 @@ namespace streams {
 
 struct stream_adaptor
 {
-    stream_adaptor() {}
+    stream_adaptor() : arena(new tuple_arena()) {}
 
     virtual void read_adaptor_events(char* data, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) = 0;
+
+    // Whether the produced events carry an explicit event order (and are
+    // therefore appended to the ordered event queue).
+    virtual bool has_event_order() { return false; }
+
+    // Hands over the memory holding the tuples of all events produced since
+    // the previous call. Those events must not outlive the returned arena.
+    std::shared_ptr<tuple_arena> take_arena() {
+        std::shared_ptr<tuple_arena> a(new tuple_arena());
+        a.swap(arena);
+        return a;
+    }
+
+    // Takes over the tuples produced by another adaptor, e.g., a clone.
+    void adopt_arena(stream_adaptor& other) {
+        arena->adopt(*other.take_arena());
+    }
+
+    // Returns an adaptor that can interpret frames concurrently with this
+    // one, or an empty pointer if frames depend on each other (such as the
+    // messages of an order book).
+    virtual std::shared_ptr<stream_adaptor> clone() {
+        return std::shared_ptr<stream_adaptor>();
+    }
+
+  protected:
+    std::shared_ptr<tuple_arena> arena;
 };
 
 // Framing
@@ -58,6 +98,17 @@ struct source
     // stream events
     virtual void read_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) = 0;
 
+    // Incremental variant of read_source_events: processes a bounded
+    // portion of the input and returns 'false' once the source is exhausted.
+    virtual bool read_next_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue) {
+        read_source_events(eventList, eventQue);
+        return false;
+    }
+
+    bool has_event_order() { return adaptor->has_event_order(); }
+
+    std::shared_ptr<tuple_arena> take_arena() { return adaptor->take_arena(); }
+
     virtual void init_source() = 0;
 };
 
@@ -67,10 +118,74 @@ struct dbt_file_source : public source
     std::shared_ptr<file_stream> source_stream;
 
     dbt_file_source(const std::string& path, frame_descriptor& f, std::shared_ptr<stream_adaptor> a);
+    ~dbt_file_source();
 
     void read_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);
+    bool read_next_source_events(std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);
 
     void init_source() {}
+
+  private:
+    size_t chunk_size;
+    char* buffer;
+    size_t buffer_capacity;
+    size_t buffer_length;   // bytes of an incomplete frame carried over
+
+    // Adaptor clones used for parsing materialized input in parallel.
+    std::vector<std::shared_ptr<stream_adaptor> > workers;
+
+    char* frame_events(stream_adaptor& a, char* start, char* end, bool last, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);
+    char* frame_events_parallel(char* start, char* end, std::shared_ptr<std::list<event_t> > eventList, std::shared_ptr<std::list<event_t> > eventQue);
+    char* next_frame_start(char* pos, char* end);
+    bool can_split_frames();
+};
+
+// Bounded, lock-free single-producer/single-consumer queue.
+template<typename T>
+class spsc_queue
+{
+  public:
+    spsc_queue(size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {
+        assert((capacity & mask) == 0);
+    }
+
+    bool try_push(const T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size()) return false;
+        slots[t & mask] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        v = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) == slots.size();
+    }
+
+  private:
+    std::vector<T> slots;
+    size_t mask;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+// Events handed over by the reader thread, along with the arenas holding
+// the tuples of the sources' chunks that end within this block.
+struct event_block_t
+{
+    std::list<event_t> events;
+    std::vector<std::shared_ptr<tuple_arena> > arenas;
 };
 
 struct source_multiplexer
@@ -81,13 +196,47 @@ struct source_multiplexer
     std::shared_ptr<std::list<event_t> > eventList;
     std::shared_ptr<std::list<event_t> > eventQue;
 
+    // Set when events are read by a background thread and handed over
+    // through next_block() instead of being accumulated in eventList/eventQue.
+    bool streaming;
+
     source_multiplexer(int seed, int st);
     source_multiplexer(int seed, int st, std::set<std::shared_ptr<source> >& s);
+    ~source_multiplexer();
 
     void add_source(std::shared_ptr<source> s);
     void remove_source(std::shared_ptr<source> s);
 
     void init_source(size_t batch_size, size_t parallel, bool is_table);
+
+    // Returns the next block of events in processing order, or nullptr once
+    // all sources are exhausted. The caller owns (and deletes) the block.
+    event_block_t* next_block();
+
+  private:
+    // Memory of the events and batches in eventList and eventQue.
+    std::vector<std::shared_ptr<tuple_arena> > arenas;
+    std::list<event_batch_t> batches;
+
+    spsc_queue<event_block_t*> blocks;
+    std::thread reader;
+    std::atomic<bool> reader_done;
+    std::atomic<bool> stop_reading;
+
+    // A side of the queue that finds it full (empty) for
+    // EVENT_QUEUE_SPIN_TRIES tries parks until the other side pops (pushes)
+    // or the reader stops.
+    std::mutex park_lock;
+    std::condition_variable park_cv;
+    std::atomic<int> parked;
+
+    bool can_stream(size_t batch_size, bool is_table);
+    event_t make_batch(const std::vector<event_t*>& evts);
+    void read_streams(size_t parallel);
+    bool push_block(event_block_t* b);
+    void finish_reading();
+    template<class Ready> void park_until(Ready ready);
+    void wake_parked();
 };
 
 }
@@ -0,0 +1,146 @@
+#include "tuple.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+
+namespace dbtoaster {
+
+/******************************************************************************
+	tuple_layout
+******************************************************************************/
+namespace {
+	template<typename T>
+	void add_field(size_t& size, size_t& alignment) {
+		size = (size + alignof(T) - 1) & ~(alignof(T) - 1);
+		size += sizeof(T);
+		alignment = std::max(alignment, alignof(T));
+	}
+
+	template<typename T>
+	void print_field(std::ostream& o, tuple_reader& r) {
+		o << std::setprecision(15) << r.get<T>();
+	}
+
+	template<typename T>
+	char* new_column(size_t capacity) {
+		return static_cast<char*>(::operator new(capacity * sizeof(T)));
+	}
+
+	template<typename T>
+	void append_field(char* column, size_t i, tuple_reader& r) {
+		new (column + i * sizeof(T)) T(r.get<T>());
+	}
+}
+
+tuple_layout::tuple_layout(const std::string& field_types)
+		: size(0), alignment(1)
+{
+	std::string::const_iterator it = field_types.begin();
+	std::string::const_iterator end = field_types.end();
+	for (; it != end; ++it) {
+		switch (*it) {
+			case 'l': add_field<long>(size, alignment); break;
+			case 'f': add_field<DOUBLE_TYPE>(size, alignment); break;
+			case 'd': add_field<date>(size, alignment); break;
+			case 'h': add_field<int>(size, alignment); break;
+			case 's': add_field<STRING_TYPE>(size, alignment); break;
+			default: continue;   // event type and order are not stored
+		}
+		schema += *it;
+	}
+	// pad to the alignment, as for a struct, so that tuples can be packed
+	size = (size + alignment - 1) & ~(alignment - 1);
+}
+
+void tuple_layout::print(std::ostream& o, event_args_t t, const char* sep) const {
+	tuple_reader r(t);
+	for (size_t i = 0; i < schema.size(); ++i) {
+		if (i > 0) o << sep;
+		switch (schema[i]) {
+			case 'l': print_field<long>(o, r); break;
+			case 'f': print_field<DOUBLE_TYPE>(o, r); break;
+			case 'd': print_field<date>(o, r); break;
+			case 'h': print_field<int>(o, r); break;
+			case 's': print_field<STRING_TYPE>(o, r); break;
+		}
+	}
+}
+
+/******************************************************************************
+	tuple_arena
+******************************************************************************/
+tuple_arena::~tuple_arena() {
+	std::vector<std::pair<void*, void (*)(void*)> >::iterator it = owned.begin();
+	std::vector<std::pair<void*, void (*)(void*)> >::iterator end = owned.end();
+	for (; it != end; ++it) (it->second)(it->first);
+	for (size_t i = 0; i < blocks.size(); ++i) delete[] blocks[i];
+}
+
+void tuple_arena::adopt(tuple_arena& other) {
+	blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+	owned.insert(owned.end(), other.owned.begin(), other.owned.end());
+	other.blocks.clear();
+	other.owned.clear();
+	other.pos = other.end = nullptr;
+}
+
+char* tuple_arena::allocate_block(size_t size, size_t alignment) {
+	// new[] memory is aligned for any fundamental type; oversized tuples get
+	// a block of their own
+	size_t sz = std::max(block_size, size + alignment);
+	char* b = new char[sz];
+	blocks.push_back(b);
+	char* p = reinterpret_cast<char*>(
+		(reinterpret_cast<size_t>(b) + alignment - 1) & ~(alignment - 1));
+	pos = p + size;
+	end = b + sz;
+	return p;
+}
+
+/******************************************************************************
+	column_batch_t
+******************************************************************************/
+column_batch_t::column_batch_t(relation_id_t i, const tuple_layout& layout, size_t c)
+		: id(i), size(0), schema(layout.schema), capacity(c)
+{
+	columns.reserve(schema.size());
+	for (size_t f = 0; f < schema.size(); ++f) {
+		switch (schema[f]) {
+			case 'l': columns.push_back(new_column<long>(capacity)); break;
+			case 'f': columns.push_back(new_column<DOUBLE_TYPE>(capacity)); break;
+			case 'd': columns.push_back(new_column<date>(capacity)); break;
+			case 'h': columns.push_back(new_column<int>(capacity)); break;
+			case 's': columns.push_back(new_column<STRING_TYPE>(capacity)); break;
+		}
+	}
+	multiplicity = new long[capacity];
+}
+
+column_batch_t::~column_batch_t() {
+	for (size_t f = 0; f < schema.size(); ++f) {
+		if (schema[f] == 's') {
+			STRING_TYPE* strings = reinterpret_cast<STRING_TYPE*>(columns[f]);
+			for (size_t i = 0; i < size; ++i) strings[i].~STRING_TYPE();
+		}
+		::operator delete(columns[f]);
+	}
+	delete[] multiplicity;
+}
+
+void column_batch_t::append(event_args_t t, long m) {
+	assert(size < capacity);
+	tuple_reader r(t);
+	for (size_t f = 0; f < schema.size(); ++f) {
+		switch (schema[f]) {
+			case 'l': append_field<long>(columns[f], size, r); break;
+			case 'f': append_field<DOUBLE_TYPE>(columns[f], size, r); break;
+			case 'd': append_field<date>(columns[f], size, r); break;
+			case 'h': append_field<int>(columns[f], size, r); break;
+			case 's': append_field<STRING_TYPE>(columns[f], size, r); break;
+		}
+	}
+	multiplicity[size++] = m;
+}
+
+}
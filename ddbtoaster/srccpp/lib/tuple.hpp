@@ -0,0 +1,185 @@
+/*
+ * tuple.hpp
+ *
+ * Flat, typed tuple representation used by events.
+ *
+ * A tuple is a record whose fields are stored one after another in schema
+ * order, each aligned to its natural alignment, exactly like a struct with
+ * the same members. Tuples are allocated from a tuple_arena owned by the
+ * producer of the events (e.g., one arena per chunk of an input file) and
+ * are accessed through tuple_writer / tuple_reader.
+ */
+
+#ifndef DBTOASTER_TUPLE_H
+#define DBTOASTER_TUPLE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "event.hpp"
+#include "hpds/pstring.hpp"
+#include "hpds/KDouble.hpp"
+#include "hpds/macro.hpp"
+
+#define DEFAULT_ARENA_BLOCK_SIZE (64 * 1024)
+
+namespace dbtoaster {
+
+/**
+ * Sequential, typed write access to the fields of a flat tuple.
+ */
+struct tuple_writer {
+    char* base;
+    size_t offset;
+
+    explicit tuple_writer(char* t) : base(t), offset(0) {}
+
+    template<typename T, typename... Args>
+    FORCE_INLINE T* put(Args&&... args) {
+        offset = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+        T* f = new (base + offset) T(std::forward<Args>(args)...);
+        offset += sizeof(T);
+        return f;
+    }
+};
+
+/**
+ * Sequential, typed read access to the fields of a flat tuple. Field types
+ * must be read in schema order; offsets fold to constants once inlined.
+ */
+struct tuple_reader {
+    const char* base;
+    size_t offset;
+
+    explicit tuple_reader(event_args_t t) : base(t), offset(0) {}
+
+    template<typename T>
+    FORCE_INLINE const T& get() {
+        offset = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+        const T* f = reinterpret_cast<const T*>(base + offset);
+        offset += sizeof(T);
+        return *f;
+    }
+};
+
+/**
+ * Size, alignment and field types of the tuples of a relation.
+ * The schema uses the adaptor type codes: 'l' (long), 'f' (DOUBLE_TYPE),
+ * 'd' (date), 'h' (int hash) and 's' (STRING_TYPE).
+ */
+struct tuple_layout {
+    std::string schema;
+    size_t size;
+    size_t alignment;
+
+    tuple_layout() : size(0), alignment(1) {}
+    tuple_layout(const std::string& field_types);
+
+    // Prints the fields of 't' separated by 'sep'.
+    void print(std::ostream& o, event_args_t t, const char* sep) const;
+};
+
+/**
+ * Bump allocator for tuples. Memory is handed out from fixed-size blocks
+ * and released all at once when the arena is destroyed; fields that need
+ * a destructor are registered with own() and destroyed at that point.
+ */
+class tuple_arena {
+  public:
+    tuple_arena(size_t block_size = DEFAULT_ARENA_BLOCK_SIZE)
+      : block_size(block_size), pos(nullptr), end(nullptr) {}
+    ~tuple_arena();
+
+    FORCE_INLINE char* allocate(size_t size, size_t alignment) {
+        char* p = reinterpret_cast<char*>(
+            (reinterpret_cast<size_t>(pos) + alignment - 1) & ~(alignment - 1));
+        if (pos == nullptr || p + size > end) return allocate_block(size, alignment);
+        pos = p + size;
+        return p;
+    }
+
+    FORCE_INLINE char* allocate(const tuple_layout& layout) {
+        return allocate(layout.size, layout.alignment);
+    }
+
+    template<typename T>
+    FORCE_INLINE void own(T* f) {
+        if (!std::is_trivially_destructible<T>::value)
+            owned.push_back(std::make_pair(static_cast<void*>(f), &destroy<T>));
+    }
+
+    bool empty() const { return blocks.empty(); }
+
+    // Takes over the memory and owned fields of 'other', leaving it empty.
+    void adopt(tuple_arena& other);
+
+  private:
+    size_t block_size;
+    char* pos;
+    char* end;
+    std::vector<char*> blocks;
+    std::vector<std::pair<void*, void (*)(void*)> > owned;
+
+    char* allocate_block(size_t size, size_t alignment);
+
+    template<typename T>
+    static void destroy(void* f) { static_cast<T*>(f)->~T(); }
+
+    tuple_arena(const tuple_arena&) = delete;
+    tuple_arena& operator=(const tuple_arena&) = delete;
+};
+
+/**
+ * The tuples of one relation within a batch_update event, stored column by
+ * column: field i of the j-th tuple is column<T>(i)[j], where T is the type
+ * of the i-th field of the relation's layout. Multiplicities form a column
+ * of their own.
+ */
+class column_batch_t {
+  public:
+    const relation_id_t id;
+    size_t size;
+
+    column_batch_t(relation_id_t id, const tuple_layout& layout, size_t capacity);
+    ~column_batch_t();
+
+    // Appends the fields of the flat tuple 't'.
+    void append(event_args_t t, long multiplicity);
+
+    template<typename T>
+    FORCE_INLINE const T* column(size_t i) const {
+        return reinterpret_cast<const T*>(columns[i]);
+    }
+
+    FORCE_INLINE const long* multiplicities() const { return multiplicity; }
+
+  private:
+    std::string schema;
+    size_t capacity;
+    std::vector<char*> columns;
+    long* multiplicity;
+
+    column_batch_t(const column_batch_t&) = delete;
+    column_batch_t& operator=(const column_batch_t&) = delete;
+};
+
+/**
+ * The data of a batch_update event: its tuples grouped by relation, in the
+ * order in which the relations first occur in the batch.
+ */
+struct event_batch_t {
+    std::vector<std::unique_ptr<column_batch_t> > relations;
+
+    size_t size() const { return relations.size(); }
+    const column_batch_t& operator[](size_t i) const { return *relations[i]; }
+};
+
+}
+
+#endif /* DBTOASTER_TUPLE_H */
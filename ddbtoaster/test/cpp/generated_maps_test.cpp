@@ -0,0 +1,307 @@
+// Declarations in the shape CppGen emits for a map with one long key under
+// each map option (default, --swiss-index, --dense-index, --flat-map,
+// --tiny-map), driven the way generated triggers use them: updates through
+// addOrDelOnZero, lookups through getValueOrDefault, foreach loops through
+// first()/next() with the --batch-prefetch lookahead, and the change log read
+// by changes_since. Every map must agree with a std::map model. The dense
+// index is also checked when its keys are sparse or repeat, and the tiny map
+// when the tags of its keys collide.
+//
+// These declarations are written from the code templates in CppGen.scala, not
+// produced by the compiler; keep them in line with emitMapType and
+// emitEntryType.
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct RES_entry {
+  long A; DOUBLE_TYPE __av;
+
+  explicit RES_entry() { }
+  explicit RES_entry(const long c0, const DOUBLE_TYPE c1) { A = c0; __av = c1; }
+
+  FORCE_INLINE RES_entry& modify(const long c0) { A = c0;  return *this; }
+};
+
+struct RES_mapkey0_idxfn {
+  FORCE_INLINE static size_t hash(const RES_entry& e) {
+    size_t h = 0;
+    hash_combine(h, e.A);
+    return h;
+  }
+
+  FORCE_INLINE static bool equals(const RES_entry& x, const RES_entry& y) {
+    return x.A == y.A;
+  }
+
+  FORCE_INLINE static long key(const RES_entry& e) {
+    return e.A;
+  }
+};
+
+typedef MultiHashMap<RES_entry, DOUBLE_TYPE,
+  PrimaryHashIndex<RES_entry, RES_mapkey0_idxfn>
+> RES_map;
+
+typedef MultiHashMap<RES_entry, DOUBLE_TYPE,
+  SwissPrimaryHashIndex<RES_entry, RES_mapkey0_idxfn>
+> RES_swiss_map;
+
+typedef MultiHashMap<RES_entry, DOUBLE_TYPE,
+  DenseArrayIndex<RES_entry, RES_mapkey0_idxfn>
+> RES_dense_map;
+
+typedef FlatHashMap<RES_entry, DOUBLE_TYPE, RES_mapkey0_idxfn> RES_flat_map;
+
+typedef MultiHashMap<RES_entry, DOUBLE_TYPE,
+  PrimaryHashIndex<RES_entry, RES_mapkey0_idxfn>
+> RES_tiny_map_large;
+typedef TinyMap<RES_entry, DOUBLE_TYPE, RES_mapkey0_idxfn, RES_tiny_map_large> RES_tiny_map;
+
+typedef map<long, DOUBLE_TYPE> model_t;
+
+int failures = 0;
+
+void check(bool ok, const string& map_name, const string& what) {
+  if (!ok) {
+    cout << map_name << ": " << what << endl;
+    ++failures;
+  }
+}
+
+template <class MAP>
+bool same_entries(const MAP& m, const model_t& model) {
+  if (m.count() != model.size()) return false;
+  for (RES_entry* e = m.first(); e; e = m.next(e)) {
+    model_t::const_iterator it = model.find(e->A);
+    if (it == model.end() || it->second != e->__av) return false;
+  }
+  return true;
+}
+
+// Sum over DELTA of DELTA[A] * M[A], as the foreach of a batch trigger over a
+// delta map computes it with --batch-prefetch.
+template <class MAP>
+DOUBLE_TYPE prefetching_foreach(const RES_map& DELTA, const MAP& M) {
+  DOUBLE_TYPE agg = 0.0;
+  RES_entry se1;
+  { //foreach, prefetching the lookups of the entry BATCH_PREFETCH_DISTANCE ahead
+    RES_entry* e1 = DELTA.first();
+    RES_entry* e1_ahead = e1;
+    for (size_t i1 = 0; e1_ahead && i1 < BATCH_PREFETCH_DISTANCE; i1++) {
+      M.prefetch(se1.modify(e1_ahead->A));
+      e1_ahead = DELTA.next(e1_ahead);
+    }
+    while (e1) {
+      if (e1_ahead) {
+        M.prefetch(se1.modify(e1_ahead->A));
+        e1_ahead = DELTA.next(e1_ahead);
+      }
+      long A = e1->A;
+      DOUBLE_TYPE v1 = e1->__av;
+      agg += (v1 * M.getValueOrDefault(se1.modify(A)));
+      e1 = DELTA.next(e1);
+    }
+  }
+  return agg;
+}
+
+// Random updates to M and the model; returns the keys written.
+template <class MAP>
+map<long, bool> update(MAP& M, model_t& model, long key_range) {
+  RES_entry se1;
+  map<long, bool> changed;
+  for (int i = 0; i < 20000; ++i) {
+    long A = rand() % key_range;
+    DOUBLE_TYPE v = (rand() % 3 == 0 ? -model[A] : (DOUBLE_TYPE) (rand() % 7 + 1));
+    M.addOrDelOnZero(se1.modify(A), v);
+    model[A] += v;
+    if (model[A] == 0.0) model.erase(A);
+    changed[A] = true;
+  }
+  return changed;
+}
+
+template <class MAP>
+void test_map(const string& map_name, long key_range) {
+  MAP M;
+  model_t model;
+  RES_entry se1;
+  srand(42);
+
+  for (int round = 0; round < 4; ++round) {
+    update(M, model, key_range);
+    check(same_entries(M, model), map_name, "entries differ from the model");
+
+    RES_map DELTA;
+    DOUBLE_TYPE expected = 0.0;
+    for (long A = 0; A < key_range; A += 3) {
+      DELTA.addOrDelOnZero(se1.modify(A), 1.0);
+      model_t::const_iterator it = model.find(A);
+      expected += (it == model.end() ? 0.0 : it->second);
+    }
+    check(prefetching_foreach(DELTA, M) == expected, map_name, "prefetching foreach differs");
+  }
+
+  M.clear();
+  check(M.count() == 0 && M.first() == nullptr, map_name, "not empty after clear()");
+}
+
+// The change log of a query result, read as changes_since reads it. Flat 
+// maps are never query results and have no change log.
+template <class MAP>
+void test_changes(const string& map_name, long key_range) {
+  MAP M;
+  model_t model;
+  RES_entry se1;
+  srand(43);
+
+  for (unsigned long epoch = 1; epoch <= 4; ++epoch) {
+    M.log_changes(epoch);
+    map<long, bool> changed = update(M, model, key_range);
+    M.log_changes(epoch + 1);
+    if (epoch == 1) continue;
+
+    MAP changes;
+    bool tracked = M.has_changes_since(epoch);
+    M.get_changes_since(epoch, changes);
+    for (RES_entry* e = changes.first(); e; e = changes.next(e)) {
+      model_t::const_iterator it = model.find(e->A);
+      check(e->__av == (it == model.end() ? 0.0 : it->second), map_name, "change has a stale value");
+      check(!tracked || changed.count(e->A), map_name, "unchanged key in the changes");
+    }
+    for (map<long, bool>::iterator it = changed.begin(); it != changed.end(); ++it) {
+      bool reported = changes.get(se1.modify(it->first)) != nullptr;
+      check(reported || !model.count(it->first), map_name, "changed key missing from the changes");
+    }
+  }
+}
+
+// A dense index moves to a PrimaryHashIndex when its keys are sparse or 
+// repeat; hashes are the keys themselves only while the array is in use.
+void test_dense_fallback() {
+  const string map_name = "--dense-index";
+  const long n = 1 << 14;
+  RES_entry se1;
+
+  // consecutive keys stay in the array
+  {
+    vector<RES_entry> entries;
+    for (long i = 0; i < n; ++i) entries.push_back(RES_entry(i - n / 2, 1.0));
+    DenseArrayIndex<RES_entry, RES_mapkey0_idxfn> idx;
+    for (long i = 0; i < n; ++i) idx.insert(&entries[i]);
+    check(idx.computeHash(se1.modify(3)) == 3, map_name, "dense keys left the array");
+    for (long i = 0; i < n; ++i) check(idx.get(entries[i]) == &entries[i], map_name, "dense get");
+  }
+
+  // keys over 2^18 slots, 1 in 16 of them used
+  {
+    vector<RES_entry> entries;
+    for (long i = 0; i < n; ++i) entries.push_back(RES_entry(i * 16, 1.0));
+    DenseArrayIndex<RES_entry, RES_mapkey0_idxfn> idx;
+    for (long i = 0; i < n; ++i) idx.insert(&entries[i]);
+    check(idx.computeHash(se1.modify(16)) != 16, map_name, "sparse keys kept in the array");
+    check(idx.count() == (size_t) n, map_name, "sparse count");
+    for (long i = 0; i < n; ++i) check(idx.get(entries[i]) == &entries[i], map_name, "sparse get");
+    check(idx.get(se1.modify(8)) == nullptr, map_name, "sparse get of a missing key");
+
+    RES_dense_map M;
+    model_t model;
+    for (long i = 0; i < n; ++i) {
+      M.addOrDelOnZero(se1.modify(i * 16), (DOUBLE_TYPE) i + 1);
+      model[i * 16] = (DOUBLE_TYPE) i + 1;
+    }
+    for (long i = 0; i < n; i += 3) {
+      M.addOrDelOnZero(se1.modify(i * 16), -((DOUBLE_TYPE) i + 1));
+      model.erase(i * 16);
+    }
+    check(same_entries(M, model), map_name, "sparse entries differ from the model");
+    for (long i = 0; i < n; ++i) {
+      model_t::const_iterator it = model.find(i * 16);
+      check(M.getValueOrDefault(se1.modify(i * 16)) == (it == model.end() ? 0.0 : it->second), 
+            map_name, "sparse getValueOrDefault");
+    }
+  }
+
+  // a second element with the same key
+  {
+    RES_entry a(7, 1.0), b(7, 2.0);
+    DenseArrayIndex<RES_entry, RES_mapkey0_idxfn> idx;
+    idx.insert(&a);
+    idx.insert(&b);
+    check(idx.computeHash(se1.modify(7)) != 7, map_name, "repeated key kept in the array");
+    check(idx.count() == 2, map_name, "repeated key count");
+    RES_entry* first = idx.get(a);
+    check(first == &a || first == &b, map_name, "repeated key get");
+    idx.del(first);
+    check(idx.get(a) == (first == &a ? &b : &a), map_name, "repeated key get after del");
+
+    RES_dense_map M;
+    for (long k = 0; k < 100; ++k) M.addOrDelOnZero(se1.modify(k), 1.0);
+    M.insert(RES_entry(7, 2.0));
+    check(M.count() == 101, map_name, "repeated key in the map");
+    // deleting moves the last entries into freed slots, through the hash index
+    for (long k = 0; k < 100; k += 2) M.del(se1.modify(k));
+    check(M.count() == 51 && M.get(se1.modify(7)) != nullptr, map_name, "repeated key after deletes");
+    M.del(se1.modify(7));
+    check(M.count() == 50 && M.get(se1.modify(7)) != nullptr, map_name, "second entry of a repeated key");
+    M.del(se1.modify(7));
+    check(M.get(se1.modify(7)) == nullptr, map_name, "repeated key after deleting both");
+    for (long k = 1; k < 100; k += 2) {
+      check(k == 7 || M.getValueOrDefault(se1.modify(k)) == 1.0, map_name, "entries after relocation");
+    }
+  }
+}
+
+// Keys that differ only above the bits the tags of a TinyMap are taken from
+// share one tag, and are told apart by IDX_FN::equals.
+void test_tiny_tag_collisions() {
+  const string map_name = "--tiny-map, same tags";
+  RES_tiny_map M;
+  model_t model;
+  RES_entry se1;
+  for (long i = 0; i < TINY_MAP_CAPACITY; ++i) {
+    M.addOrDelOnZero(se1.modify(i << 24), (DOUBLE_TYPE) i + 1);
+    model[i << 24] = (DOUBLE_TYPE) i + 1;
+  }
+  check(same_entries(M, model), map_name, "entries differ from the model");
+  check(M.getValueOrDefault(se1.modify(TINY_MAP_CAPACITY << 24)) == 0.0, map_name, "missing key found");
+  for (long i = 0; i < TINY_MAP_CAPACITY; i += 2) {
+    M.addOrDelOnZero(se1.modify(i << 24), -((DOUBLE_TYPE) i + 1));
+    model.erase(i << 24);
+  }
+  for (long i = 0; i < TINY_MAP_CAPACITY; ++i) {
+    model_t::const_iterator it = model.find(i << 24);
+    check(M.getValueOrDefault(se1.modify(i << 24)) == (it == model.end() ? 0.0 : it->second),
+          map_name, "getValueOrDefault after deletes");
+  }
+  RES_tiny_map copy(M);
+  check(same_entries(copy, model), map_name, "copy differs from the model");
+}
+
+int main() {
+  test_map<RES_map>("default", 5000);
+  test_map<RES_swiss_map>("--swiss-index", 5000);
+  test_map<RES_dense_map>("--dense-index", 5000);
+  test_map<RES_flat_map>("--flat-map", 5000);
+  test_map<RES_tiny_map>("--tiny-map", 5000);
+  test_map<RES_tiny_map>("--tiny-map, inline", 4);
+
+  test_changes<RES_map>("default", 5000);
+  test_changes<RES_swiss_map>("--swiss-index", 5000);
+  test_changes<RES_dense_map>("--dense-index", 5000);
+  test_changes<RES_tiny_map>("--tiny-map", 5000);
+  test_changes<RES_tiny_map>("--tiny-map, inline", 4);
+
+  test_dense_fallback();
+  test_tiny_tag_collisions();
+
+  cout << (failures ? "FAILED" : "OK") << endl;
+  return failures ? 1 : 0;
+}
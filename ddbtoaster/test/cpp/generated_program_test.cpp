@@ -0,0 +1,476 @@
+// A program in the shape CppGen emits in batch mode with --batch-prefetch for
+//
+//   CREATE STREAM R(A int, B float) FROM FILE '/tmp/dbtoaster_program_test_R.csv' LINE DELIMITED CSV (delimiter := '|');
+//   CREATE TABLE S(C int) FROM FILE '/tmp/dbtoaster_program_test_S.csv' LINE DELIMITED CSV (delimiter := '|');
+//   SELECT R.A, SUM(R.B) AS RES FROM R, S WHERE R.A = S.C GROUP BY R.A;
+//   SELECT COUNT(*) AS CNT FROM R;
+//
+// run with and without batches, on one and on several parsing threads, and
+// asynchronously while its changes are read through get_changes_since. It
+// covers the generated event unwrapping (tuple_reader, column batches), the
+// trigger registration, snapshots (also taken while running) and
+// changes_since.
+//
+// The program is written from the code templates in CppGen.scala, not
+// produced by the compiler; keep it in line with emitIVMStructure,
+// emitUnwrapFunction, emitTableTriggers and emitMainClass.
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include "program_base.hpp"
+#include "hpds/KDouble.hpp"
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+#include "hpds/pstring.hpp"
+#include "hpds/pstringops.hpp"
+
+namespace dbtoaster {
+
+  /* Definitions of maps used for storing materialized views. */
+  struct DELTA_R_entry {
+    long R_A; DOUBLE_TYPE R_B; long __av;
+
+    explicit DELTA_R_entry() { }
+    explicit DELTA_R_entry(const long c0, const DOUBLE_TYPE c1, const long c2) { R_A = c0; R_B = c1; __av = c2; }
+
+    FORCE_INLINE DELTA_R_entry& modify(const long c0, const DOUBLE_TYPE c1) { R_A = c0; R_B = c1;  return *this; }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, R_A);
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, R_B);
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, __av);
+    }
+  };
+
+  struct DELTA_R_mapkey01_idxfn {
+    FORCE_INLINE static size_t hash(const DELTA_R_entry& e) {
+      size_t h = 0;
+      hash_combine(h, e.R_A);
+      hash_combine(h, e.R_B);
+      return h;
+    }
+
+    FORCE_INLINE static bool equals(const DELTA_R_entry& x, const DELTA_R_entry& y) {
+      return x.R_A == y.R_A && x.R_B == y.R_B;
+    }
+  };
+
+  typedef MultiHashMap<DELTA_R_entry, long,
+    PrimaryHashIndex<DELTA_R_entry, DELTA_R_mapkey01_idxfn>
+  > DELTA_R_map;
+
+  struct S_entry {
+    long S_C; long __av;
+
+    explicit S_entry() { }
+    explicit S_entry(const long c0, const long c1) { S_C = c0; __av = c1; }
+
+    FORCE_INLINE S_entry& modify(const long c0) { S_C = c0;  return *this; }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, S_C);
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, __av);
+    }
+  };
+
+  struct S_mapkey0_idxfn {
+    FORCE_INLINE static size_t hash(const S_entry& e) {
+      size_t h = 0;
+      hash_combine(h, e.S_C);
+      return h;
+    }
+
+    FORCE_INLINE static bool equals(const S_entry& x, const S_entry& y) {
+      return x.S_C == y.S_C;
+    }
+  };
+
+  typedef MultiHashMap<S_entry, long,
+    PrimaryHashIndex<S_entry, S_mapkey0_idxfn>
+  > S_map;
+
+  struct RES_entry {
+    long R_A; DOUBLE_TYPE __av;
+
+    explicit RES_entry() { }
+    explicit RES_entry(const long c0, const DOUBLE_TYPE c1) { R_A = c0; __av = c1; }
+
+    FORCE_INLINE RES_entry& modify(const long c0) { R_A = c0;  return *this; }
+
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, R_A);
+      ar << ELEM_SEPARATOR;
+      DBT_SERIALIZATION_NVP(ar, __av);
+    }
+  };
+
+  struct RES_mapkey0_idxfn {
+    FORCE_INLINE static size_t hash(const RES_entry& e) {
+      size_t h = 0;
+      hash_combine(h, e.R_A);
+      return h;
+    }
+
+    FORCE_INLINE static bool equals(const RES_entry& x, const RES_entry& y) {
+      return x.R_A == y.R_A;
+    }
+  };
+
+  typedef MultiHashMap<RES_entry, DOUBLE_TYPE,
+    PrimaryHashIndex<RES_entry, RES_mapkey0_idxfn>
+  > RES_map;
+
+  /* Defines top-level materialized views */
+  struct tlq_t {
+    struct timeval t0, t; long tT, tN, tS;
+    tlq_t(): tN(0), tS(0) , CNT(0L) {
+      gettimeofday(&t0, NULL);
+    }
+
+    /* Serialization code */
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) const {
+      ar << "\n";
+      const RES_map& _RES = get_RES();
+      dbtoaster::serialize_nvp_tabbed(ar, STRING(RES), _RES, "\t");
+
+      ar << "\n";
+      const long _CNT = get_CNT();
+      dbtoaster::serialize_nvp_tabbed(ar, STRING(CNT), _CNT, "\t");
+    }
+
+    /* Functions returning / computing the results of top level queries */
+    const RES_map& get_RES() const {
+      return RES;
+    }
+
+    const long get_CNT() const {
+      return CNT;
+    }
+
+    /* Copies into 'd' the entries of the top-level views that changed after
+       epoch 'since' and closes epoch 'epoch'. Returns false if these changes
+       are not tracked, in which case 'd' receives all entries. */
+    bool changes_since(tlq_t& d, unsigned long since, unsigned long epoch) {
+      RES.log_changes(epoch);
+      bool tracked = RES.has_changes_since(since);
+      RES.get_changes_since(tracked ? since : 0, d.RES);
+      d.CNT = CNT;
+      return tracked;
+    }
+
+  protected:
+    /* Data structures used for storing / computing top-level queries */
+    RES_map RES;
+    long CNT;
+  };
+
+  /* Contains materialized views and processing (IVM) logic */
+  struct data_t : tlq_t {
+
+    data_t(): tlq_t() {
+    }
+
+    /* Registering relations and trigger functions */
+    ProgramBase* program_base;
+    void register_data(ProgramBase& pb) {
+      program_base = &pb;
+
+      // Register maps
+      pb.add_map<RES_map>("RES", RES);
+      pb.add_map<long>("CNT", CNT);
+      pb.add_map<DELTA_R_map>("DELTA_R", DELTA_R);
+      pb.add_map<S_map>("S", S);
+
+      // Register streams and tables
+      pb.add_relation("R", false);
+      pb.add_relation("S", true);
+
+      // Register stream triggers
+      pb.add_trigger("R", batch_update, &ProgramBase::call_member<data_t, &data_t::unwrap_batch_update_R>, this);
+      pb.add_trigger("R", insert_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_insert_R>, this);
+      pb.add_trigger("R", delete_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_delete_R>, this);
+
+      // Register table triggers
+      pb.add_trigger("S", batch_update, &ProgramBase::call_member<data_t, &data_t::unwrap_batch_update_S>, this);
+      pb.add_trigger("S", insert_tuple, &ProgramBase::call_member<data_t, &data_t::unwrap_insert_S>, this);
+    }
+
+    /* Trigger functions for table relations */
+    void on_insert_S(const long S_C) {
+      S_entry e(S_C, 1L);
+      S.addOrDelOnZero(e, 1L);
+    }
+    void unwrap_insert_S(const event_args_t& ea) {
+      tuple_reader reader(ea);
+      const long& ea_0 = reader.get<long>();
+      on_insert_S(ea_0);
+    }
+    void unwrap_batch_update_S(const event_args_t& eaList) {
+      const event_batch_t& batch = *reinterpret_cast<const event_batch_t*>(eaList);
+      relation_id_t id = program_base->get_relation_id("S");
+      for (size_t r = 0; r < batch.size(); r++) {
+        const column_batch_t& rb = batch[r];
+        if (rb.id != id) continue;
+        const long* col_0 = rb.column<long>(0);
+        for (size_t i = 0; i < rb.size; i++) {
+          S_entry e(col_0[i], 1L);
+          S.addOrDelOnZero(e, 1L);
+        }
+      }
+    }
+
+    /* Trigger functions for stream relations */
+    void on_batch_update_R(DELTA_R_map &DELTA_R) {
+      long batchSize = DELTA_R.count();
+      tN += batchSize;
+      { //foreach, prefetching the lookups of the entry BATCH_PREFETCH_DISTANCE ahead
+        DELTA_R_entry* e1 = DELTA_R.first();
+        DELTA_R_entry* e1_ahead = e1;
+        for (size_t i1 = 0; e1_ahead && i1 < BATCH_PREFETCH_DISTANCE; i1++) {
+          S.prefetch(se2.modify(e1_ahead->R_A));
+          e1_ahead = DELTA_R.next(e1_ahead);
+        }
+        while (e1) {
+          if (e1_ahead) {
+            S.prefetch(se2.modify(e1_ahead->R_A));
+            e1_ahead = DELTA_R.next(e1_ahead);
+          }
+          long r_a = e1->R_A;
+          DOUBLE_TYPE r_b = e1->R_B;
+          long v1 = e1->__av;
+          RES.addOrDelOnZero(se1.modify(r_a), (v1 * (S.getValueOrDefault(se2.modify(r_a)) * r_b)));
+          e1 = DELTA_R.next(e1);
+        }
+      }
+
+      long agg1 = 0L;
+      { //foreach
+        DELTA_R_entry* e2 = DELTA_R.first();
+        while (e2) {
+          long v2 = e2->__av;
+          agg1 += v2;
+          e2 = DELTA_R.next(e2);
+        }
+      }
+      CNT += agg1;
+    }
+
+    void unwrap_batch_update_R(const event_args_t& eaList) {
+      const event_batch_t& batch = *reinterpret_cast<const event_batch_t*>(eaList);
+      DELTA_R.clear();
+      for (size_t r = 0; r < batch.size(); r++) {
+        const column_batch_t& rb = batch[r];
+        const long* mult = rb.multiplicities();
+        if (rb.id == program_base->get_relation_id("R")) {
+          const long* col_0 = rb.column<long>(0);
+          const DOUBLE_TYPE* col_1 = rb.column<DOUBLE_TYPE>(1);
+          for (size_t i = 0; i < rb.size; i++) {
+            DELTA_R_entry e(col_0[i], col_1[i], mult[i]);
+            DELTA_R.addOrDelOnZero(e, mult[i]);
+          }
+        }
+      }
+      on_batch_update_R(DELTA_R);
+    }
+
+    void unwrap_insert_R(const event_args_t& ea) {
+      tuple_reader reader(ea);
+      const long& ea_0 = reader.get<long>();
+      const DOUBLE_TYPE& ea_1 = reader.get<DOUBLE_TYPE>();
+      DELTA_R.clear();
+      DELTA_R_entry e(ea_0, ea_1, 1L);
+      DELTA_R.insert(e);
+      on_batch_update_R(DELTA_R);
+    }
+
+    void unwrap_delete_R(const event_args_t& ea) {
+      tuple_reader reader(ea);
+      const long& ea_0 = reader.get<long>();
+      const DOUBLE_TYPE& ea_1 = reader.get<DOUBLE_TYPE>();
+      DELTA_R.clear();
+      DELTA_R_entry e(ea_0, ea_1, -1L);
+      DELTA_R.insert(e);
+      on_batch_update_R(DELTA_R);
+    }
+
+    void on_system_ready_event() {
+    }
+
+  private:
+
+    /* Preallocated map entries (to avoid recreation of temporary objects) */
+    RES_entry se1;
+    S_entry se2;
+
+    /* Data structures used for storing materialized views */
+    DELTA_R_map DELTA_R;
+    S_map S;
+  };
+
+  /* Type definition providing a way to execute the sql program */
+  class Program : public ProgramBase {
+    public:
+      Program(int argc = 0, char* argv[] = 0) : ProgramBase(argc,argv) {
+        data.register_data(*this);
+
+        /* Specifying data sources */
+        pair<string,string> source1_adaptor_params[] = { make_pair("delimiter", "|"), make_pair("schema", "long"), make_pair("deletions", "false") };
+        std::shared_ptr<csv_adaptor> source1_adaptor(new csv_adaptor(get_relation_id("S"), 3, source1_adaptor_params));
+        frame_descriptor source1_fd("\n");
+        std::shared_ptr<dbt_file_source> source1_file(new dbt_file_source("/tmp/dbtoaster_program_test_S.csv",source1_fd,source1_adaptor));
+        add_source(source1_file, true);
+
+        pair<string,string> source2_adaptor_params[] = { make_pair("delimiter", "|"), make_pair("schema", "long,double"), make_pair("deletions", "false") };
+        std::shared_ptr<csv_adaptor> source2_adaptor(new csv_adaptor(get_relation_id("R"), 3, source2_adaptor_params));
+        frame_descriptor source2_fd("\n");
+        std::shared_ptr<dbt_file_source> source2_file(new dbt_file_source("/tmp/dbtoaster_program_test_R.csv",source2_fd,source2_adaptor));
+        add_source(source2_file, false);
+      }
+
+      /* Imports data for static tables and performs view initialization based on it. */
+      void init() {
+          table_multiplexer.init_source(run_opts->batch_size, run_opts->parallel, true);
+          stream_multiplexer.init_source(run_opts->batch_size, run_opts->parallel, false);
+
+          process_tables();
+
+          data.on_system_ready_event();
+
+          gettimeofday(&data.t0, NULL);
+      }
+
+      /* Saves a snapshot of the data required to obtain the results of top level queries. */
+      snapshot_t take_snapshot() {
+          tlq_t* d = new tlq_t((tlq_t&) data);
+          return snapshot_t( d );
+      }
+
+      /* Collects the entries of the top-level views that changed after epoch 'since'. */
+      snapshot_t take_changes(unsigned long since, unsigned long epoch, bool& full) {
+          tlq_t* d = new tlq_t();
+          full = !data.changes_since(*d, since, epoch);
+          return snapshot_t( d );
+      }
+    protected:
+      data_t data;
+  };
+}
+
+using namespace std;
+using namespace dbtoaster;
+
+typedef map<long, DOUBLE_TYPE> result_t;
+
+result_t to_result(const RES_map& m) {
+  result_t res;
+  for (RES_entry* e = m.first(); e; e = m.next(e)) res[e->R_A] = e->__av;
+  return res;
+}
+
+int failures = 0;
+
+void check(bool ok, const string& run, const string& what) {
+  if (!ok) {
+    cout << run << ": " << what << endl;
+    ++failures;
+  }
+}
+
+void run_program(const string& run, vector<string> args, bool async,
+                 const result_t& expected, long expected_count) {
+  vector<char*> argv;
+  argv.push_back(const_cast<char*>("generated_program_test"));
+  for (size_t i = 0; i < args.size(); ++i) argv.push_back(&args[i][0]);
+  argv.push_back(nullptr);
+
+  Program p(argv.size() - 1, &argv[0]);
+  p.init();
+  p.run(async);
+
+  // changes read while the program runs, applied to a copy of the results,
+  // and snapshots, whose counts of the insert-only R never decrease
+  result_t seen;
+  unsigned long epoch = 0;
+  long last_count = 0;
+  while (async && !p.is_finished()) {
+    Program::snapshot_t running_snap = p.get_snapshot();
+    check(running_snap->get_CNT() >= last_count && running_snap->get_CNT() <= expected_count,
+          run, "CNT of a snapshot taken while running");
+    last_count = running_snap->get_CNT();
+
+    Program::changes_t changes = p.get_changes_since(epoch);
+    if (changes.full) seen.clear();
+    if (changes.data != nullptr) {
+      result_t changed = to_result(changes.data->get_RES());
+      for (result_t::iterator it = changed.begin(); it != changed.end(); ++it) {
+        if (it->second == 0.0) seen.erase(it->first); else seen[it->first] = it->second;
+      }
+    }
+    epoch = changes.epoch;
+  }
+  p.wait();
+
+  Program::snapshot_t snap = p.get_snapshot();
+  check(to_result(snap->get_RES()) == expected, run, "RES differs");
+  check(snap->get_CNT() == expected_count, run, "CNT differs");
+  if (async && epoch > 0) {
+    Program::changes_t changes = p.get_changes_since(epoch);
+    if (changes.full) seen.clear();
+    result_t changed = to_result(changes.data->get_RES());
+    for (result_t::iterator it = changed.begin(); it != changed.end(); ++it) {
+      if (it->second == 0.0) seen.erase(it->first); else seen[it->first] = it->second;
+    }
+    check(seen == expected, run, "RES from get_changes_since differs");
+  }
+}
+
+int main() {
+  const long rows = 200000, keys = 500;
+  map<long, long> s_count;
+  {
+    ofstream S("/tmp/dbtoaster_program_test_S.csv");
+    for (long c = 0; c < keys; c += 2) {
+      for (long k = 0; k <= c % 3; ++k) { S << c << "\n"; ++s_count[c]; }
+    }
+  }
+
+  result_t expected;
+  {
+    ofstream R("/tmp/dbtoaster_program_test_R.csv");
+    srand(42);
+    for (long i = 0; i < rows; ++i) {
+      long a = rand() % keys, b = rand() % 10 + 1;
+      R << a << "|" << b << "\n";
+      if (s_count.count(a)) expected[a] += b * s_count[a];
+    }
+  }
+
+  const char* parse_threads[] = { "--parse-threads=1", "--parse-threads=3" };
+  for (int t = 0; t < 2; ++t) {
+    vector<string> args(1, parse_threads[t]);
+    run_program(string(parse_threads[t]) + ", tuples", args, false, expected, rows);
+    run_program(string(parse_threads[t]) + ", tuples, async", args, true, expected, rows);
+
+    args.push_back("-b");
+    args.push_back("1000");
+    run_program(string(parse_threads[t]) + ", batches", args, false, expected, rows);
+    run_program(string(parse_threads[t]) + ", batches, async", args, true, expected, rows);
+  }
+
+  remove("/tmp/dbtoaster_program_test_S.csv");
+  remove("/tmp/dbtoaster_program_test_R.csv");
+
+  cout << (failures ? "FAILED" : "OK") << endl;
+  return failures ? 1 : 0;
+}
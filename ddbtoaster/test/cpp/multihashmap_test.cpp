@@ -0,0 +1,208 @@
+// Randomized check of MultiHashMap against a std::map model: adds, sets,
+// deletes (also during scans) and clears on a map with a primary and a
+// secondary hash index, checked through get, slice and first()/next(). Index
+// tables start small and resize incrementally from 64 buckets on, so lookups
+// and relocations of moved entries run while buckets migrate. Snapshots, and
+// snapshots of snapshots, are taken along the way and compared with the model
+// of their time after the map has changed.
+#define INCREMENTAL_RESIZE_MIN_SIZE 64
+
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+#include "hash.hpp"
+#include "mmap/mmap.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+
+struct E_entry {
+  long A; long B; long __av;
+
+  explicit E_entry() { }
+  explicit E_entry(const long c0, const long c1, const long c2) { A = c0; B = c1; __av = c2; }
+
+  FORCE_INLINE E_entry& modify(const long c0) { A = c0;  return *this; }
+  FORCE_INLINE E_entry& modify1(const long c1) { B = c1;  return *this; }
+};
+
+struct E_mapkey0_idxfn {
+  FORCE_INLINE static size_t hash(const E_entry& e) {
+    size_t h = 0;
+    hash_combine(h, e.A);
+    return h;
+  }
+
+  FORCE_INLINE static bool equals(const E_entry& x, const E_entry& y) {
+    return x.A == y.A;
+  }
+};
+
+struct E_mapkey1_idxfn {
+  FORCE_INLINE static size_t hash(const E_entry& e) {
+    size_t h = 0;
+    hash_combine(h, e.B);
+    return h;
+  }
+
+  FORCE_INLINE static bool equals(const E_entry& x, const E_entry& y) {
+    return x.B == y.B;
+  }
+};
+
+typedef MultiHashMap<E_entry, long,
+  PrimaryHashIndex<E_entry, E_mapkey0_idxfn>,
+  SecondaryHashIndex<E_entry, E_mapkey1_idxfn>
+> E_map;
+
+// A -> (B, value)
+typedef map<long, pair<long, long> > model_t;
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+  if (!ok && failures++ < 20) cout << what << endl;
+}
+
+long group(long A) { return A % 97; }
+
+// Compares all of 'm' with 'model': count, scan, get and the slices of
+// 'groups' groups.
+void compare(E_map& m, const model_t& model, const string& what, long groups = 97) {
+  check(m.count() == model.size(), what + ": count");
+
+  model_t scanned;
+  for (E_entry* e = m.first(); e; e = m.next(e)) {
+    check(scanned.count(e->A) == 0, what + ": entry visited twice");
+    scanned[e->A] = make_pair(e->B, e->__av);
+  }
+  check(scanned == model, what + ": scan differs from the model");
+
+  E_entry se;
+  for (model_t::const_iterator it = model.begin(); it != model.end(); ++it) {
+    const E_entry* e = m.get(se.modify(it->first));
+    check(e != nullptr && e->B == it->second.first && e->__av == it->second.second, what + ": get");
+  }
+
+  for (long b = 0; b < groups; ++b) {
+    set<long> expected, sliced;
+    for (model_t::const_iterator it = model.begin(); it != model.end(); ++it) {
+      if (it->second.first == b) expected.insert(it->first);
+    }
+    const SecondaryIdxNode<E_entry>* n_head = m.slice(se.modify1(b), 0);
+    const SecondaryIdxNode<E_entry>* n = n_head;
+    while (n) {
+      check(n->obj->B == b && sliced.insert(n->obj->A).second, what + ": slice entry");
+      n = (n != n_head ? n->nxt : n->child);
+    }
+    check(sliced == expected, what + ": slice differs from the model");
+  }
+}
+
+struct snapshot {
+  E_map* map;
+  model_t model;
+  int id;
+};
+
+int main() {
+  E_map M;
+  model_t model;
+  vector<snapshot> snapshots;
+  E_entry se;
+  srand(42);
+
+  const int steps = 400000;
+  int taken = 0;
+  for (int step = 1; step <= steps; ++step) {
+    // the key range grows and shrinks, so the tables resize both ways often
+    long range = 1 + 60000 * (1 + (step / 50000) % 3) / 3;
+    long A = rand() % range;
+    int op = rand() % 10;
+
+    if (op < 5) {                       // add, deleting on zero
+      long v = (rand() % 4 == 0 && model.count(A) ? -model[A].second : rand() % 5 + 1);
+      E_entry e(A, group(A), v);
+      M.addOrDelOnZero(e, v);
+      if (model.count(A)) {
+        model[A].second += v;
+        if (model[A].second == 0) model.erase(A);
+      }
+      else if (v != 0) { model[A] = make_pair(group(A), v); }
+    }
+    else if (op < 7) {                  // set, deleting on zero
+      long v = rand() % 3;
+      E_entry e(A, group(A), v);
+      M.setOrDelOnZero(e, v);
+      if (v == 0) model.erase(A); else model[A] = make_pair(group(A), v);
+    }
+    else {                              // delete
+      M.del(se.modify(A));
+      model.erase(A);
+    }
+
+    if (step % 20000 == 0) {            // delete every fifth key during a scan
+      for (E_entry* e = M.first(); e; ) {
+        E_entry* next = M.next(e);
+        if (e->A % 5 == 0) {
+          long key = e->A;
+          M.del(se.modify(key));
+          model.erase(key);
+        }
+        e = next;
+      }
+      compare(M, model, "after deletes during a scan");
+    }
+
+    if (step % 130000 == 0) {
+      M.clear();
+      model.clear();
+    }
+
+    if (step % 5000 == 0) {
+      compare(M, model, "map", step % 25000 == 0 ? 97 : 5);
+
+      snapshot s;
+      s.map = new E_map(M);
+      s.model = model;
+      s.id = ++taken;
+      check(s.map->count() == model.size(), "snapshot count before use");
+      snapshots.push_back(s);
+
+      // a snapshot of a snapshot, before and after the first one is used
+      if (taken % 3 == 0) {
+        snapshot t = snapshots[snapshots.size() - 2];
+        if (taken % 2 == 0) compare(*t.map, t.model, "snapshot before copying");
+        t.map = new E_map(*t.map);
+        t.id = ++taken;
+        snapshots.push_back(t);
+      }
+    }
+
+    // compare the older snapshots, then modify them as maps of their own
+    if (snapshots.size() > 6) {
+      snapshot s = snapshots.front();
+      snapshots.erase(snapshots.begin());
+      compare(*s.map, s.model, "snapshot");
+      for (long a = 0; a < 1000; ++a) {
+        E_entry e(a, group(a), 1);
+        s.map->addOrDelOnZero(e, 1);
+        if (s.model.count(a)) s.model[a].second += 1; else s.model[a] = make_pair(group(a), 1L);
+      }
+      compare(*s.map, s.model, "modified snapshot", 5);
+      delete s.map;
+    }
+  }
+
+  compare(M, model, "map at the end");
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    compare(*snapshots[i].map, snapshots[i].model, "snapshot at the end");
+    delete snapshots[i].map;
+  }
+  cout << taken << " snapshots" << endl;
+
+  cout << (failures ? "FAILED" : "OK") << endl;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+
+cd ../..
+
+rm -f target/generated_maps_test
+
+mkdir -p target
+make -s -C srccpp/lib
+
+g++ test/cpp/generated_maps_test.cpp -o target/generated_maps_test -std=c++11 -O3 -Isrccpp/lib -Lsrccpp/lib -ldbtoaster -lpthread
+
+target/generated_maps_test
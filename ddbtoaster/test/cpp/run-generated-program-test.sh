@@ -0,0 +1,12 @@
+#!/bin/sh
+
+cd ../..
+
+rm -f target/generated_program_test
+
+mkdir -p target
+make -s -C srccpp/lib
+
+g++ test/cpp/generated_program_test.cpp -o target/generated_program_test -std=c++11 -O3 -Isrccpp/lib -Lsrccpp/lib -ldbtoaster -lpthread
+
+target/generated_program_test
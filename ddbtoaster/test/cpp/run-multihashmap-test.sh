@@ -0,0 +1,12 @@
+#!/bin/sh
+
+cd ../..
+
+rm -f target/multihashmap_test
+
+mkdir -p target
+make -s -C srccpp/lib
+
+g++ test/cpp/multihashmap_test.cpp -o target/multihashmap_test -std=c++11 -O3 -Isrccpp/lib -Lsrccpp/lib -ldbtoaster -lpthread
+
+target/multihashmap_test
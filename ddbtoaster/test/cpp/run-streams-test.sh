@@ -0,0 +1,12 @@
+#!/bin/sh
+
+cd ../..
+
+rm -f target/streams_test
+
+mkdir -p target
+make -s -C srccpp/lib
+
+g++ test/cpp/streams_test.cpp -o target/streams_test -std=c++11 -O3 -Isrccpp/lib -Lsrccpp/lib -ldbtoaster -lpthread
+
+target/streams_test
@@ -0,0 +1,85 @@
+// Reads delimited files with frames longer than a parsing range (64 KB) and
+// than the read buffer, with and without a trailing newline, on one and on
+// several parsing threads, and checks that every frame comes out once and in
+// input order. Dates without zero padding take the slower path of the
+// adaptor, which must also be safe on several threads.
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include "standard_adaptors.hpp"
+
+using namespace std;
+using namespace dbtoaster;
+using namespace dbtoaster::adaptors;
+using namespace dbtoaster::streams;
+
+string read_events(const char* path, unsigned int threads, const string& schema)
+{
+  runtime::runtime_options::_parse_threads = threads;
+  pair<string, string> params[] = { make_pair("delimiter", "|"), make_pair("schema", schema) };
+  shared_ptr<csv_adaptor> a(new csv_adaptor(0, 2, params));
+  frame_descriptor fd("\n");
+  dbt_file_source src(path, fd, a);
+  shared_ptr<list<event_t> > events(new list<event_t>()), ordered(new list<event_t>());
+  src.read_source_events(events, ordered);
+  shared_ptr<tuple_arena> arena = src.take_arena();
+
+  ostringstream out;
+  for (list<event_t>::iterator e = events->begin(); e != events->end(); ++e) {
+    e->layout->print(out, e->data, ",");
+    out << "\n";
+  }
+  return out.str();
+}
+
+int main()
+{
+  const char* path = "/tmp/dbtoaster_streams_test.csv";
+  string long_frame(200000, 'x'), huge_frame(9 << 20, 'y');
+  ostringstream many;
+  for (int i = 0; i < 30000; ++i) many << i << "|abc\n";
+  ostringstream dates, printed_dates;
+  for (int i = 0; i < 200000; ++i) {
+    int y = 1990 + i % 10, m = 1 + i % 12, d = 1 + i % 28;
+    dates << i << "|" << y << "-" << m << "-" << (i % 2 ? "0" : "") << d << "\n";
+    printed_dates << i << "," << y * 10000 + m * 100 + d << "\n";
+  }
+
+  string inputs[] = {
+    "1|a\n2|" + long_frame + "\n3|c",
+    "1|" + long_frame + "\n2|b\n",
+    many.str() + "9|" + long_frame,
+    "1|a\n2|" + huge_frame + "\n3|c\n4|" + huge_frame,
+    dates.str()
+  };
+  string schemas[] = { "long,string", "long,string", "long,string", "long,string", "long,date" };
+  size_t expected[] = { 3, 2, 30001, 4, 200000 };
+
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+    ofstream(path, ios::binary) << inputs[i];
+    string sequential = read_events(path, 1, schemas[i]);
+    size_t frames = 0;
+    for (size_t p = 0; p < sequential.size(); ++p) frames += sequential[p] == '\n';
+    if (frames != expected[i]) {
+      cout << "input " << i << ": " << frames << " frames, expected " << expected[i] << endl;
+      ++failures;
+    }
+    if (schemas[i] == "long,date" && sequential != printed_dates.str()) {
+      cout << "input " << i << ": dates differ" << endl;
+      ++failures;
+    }
+    for (unsigned int threads = 2; threads <= 7; ++threads) {
+      if (read_events(path, threads, schemas[i]) != sequential) {
+        cout << "input " << i << ": " << threads << " threads differ from one" << endl;
+        ++failures;
+      }
+    }
+  }
+  remove(path);
+
+  cout << (failures ? "FAILED" : "OK") << endl;
+  return failures ? 1 : 0;
+}